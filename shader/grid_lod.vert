@@ -0,0 +1,84 @@
+//glsl version 4.5
+#version 450
+
+//Chunk of the CDLOD quadtree, see TerrainLod. The index is the node in the chunk, the instance the chunk.
+//Towards the end of its range a chunk morphs onto the nodes and heights of the next level
+
+layout( location = 0 ) in vec4 vNode; //Origin in nodes of level 0, level, range
+
+layout( location = 0 ) out vec3 fragNorm;
+
+layout( set = 0, binding = 0 ) uniform CameraBuffer {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+} cam_data;
+
+//Level table of offset, width and height, then the heights of every level
+layout( set = 0, binding = 1 ) readonly buffer HeightBuffer {
+	uvec4 levels[16];
+	float heights[];
+} grid;
+
+//data: camera position, height scale
+layout( push_constant ) uniform constants
+{
+	vec4 data;
+	mat4 model;
+} PushConstants;
+
+const int CHUNK = 32;
+const float MORPH_START = 0.7;
+
+float node_height( uint level, ivec2 p )
+{
+	const uvec4 l = grid.levels[level];
+	p = clamp( p, ivec2( 0 ), ivec2( l.yz ) - 1 );
+	return grid.heights[l.x + p.x + p.y * l.y];
+}
+
+//Bilinear between the nodes of level around p, p in nodes of level 0
+float level_height( uint level, vec2 p )
+{
+	p /= float( 1 << level );
+	const ivec2 i = ivec2( floor( p ));
+	const vec2 f = p - i;
+
+	return mix( mix( node_height( level, i ), node_height( level, i + ivec2( 1, 0 )), f.x ),
+	            mix( node_height( level, i + ivec2( 0, 1 )), node_height( level, i + ivec2( 1, 1 )), f.x ), f.y );
+}
+
+float morph_height( uint level, vec2 p, float morph )
+{
+	return mix( level_height( level, p ), level_height( level + 1, p ), morph );
+}
+
+void main()
+{
+	const vec3 camera = PushConstants.data.xyz;
+	const float yscale = PushConstants.data.w;
+
+	const uint level = uint( vNode.z );
+	const float spacing = float( 1 << level );
+	const vec2 last = vec2( grid.levels[0].yz - 1 );
+	const vec2 scale = 2.0f / vec2( grid.levels[0].yz );
+
+	const vec2 local = vec2( gl_VertexIndex % ( CHUNK + 1 ), gl_VertexIndex / ( CHUNK + 1 ));
+
+	//Morph by the distance of the unmorphed node, chunks sharing an edge agree on it
+	vec2 p = min( vNode.xy + local * spacing, last );
+	const vec3 unmorphed = vec3( p.x * scale.x - 1, level_height( level, p ) * yscale, p.y * scale.y - 1 );
+	const float morph = clamp(( distance( unmorphed, camera ) - MORPH_START * vNode.w ) / (( 1 - MORPH_START ) * vNode.w ), 0, 1 );
+
+	//Odd nodes slide onto the even ones, the nodes of the next level
+	p = min( vNode.xy + ( local - fract( local * 0.5f ) * 2.0f * morph ) * spacing, last );
+
+	const float dx = ( morph_height( level, p + vec2( spacing, 0 ), morph ) - morph_height( level, p - vec2( spacing, 0 ), morph )) / ( 2 * spacing );
+	const float dy = ( morph_height( level, p + vec2( 0, spacing ), morph ) - morph_height( level, p - vec2( 0, spacing ), morph )) / ( 2 * spacing );
+	const vec3 vNorm = -normalize( vec3( dx / yscale, -1, dy / yscale ));
+
+	const vec3 vPos = vec3( p.x * scale.x - 1, morph_height( level, p, morph ) * yscale, p.y * scale.y - 1 );
+
+	gl_Position = cam_data.view_proj * PushConstants.model * vec4( vPos, 1.0f );
+	fragNorm = normalize(( transpose( inverse ( cam_data.view * PushConstants.model )) * vec4( vNorm, 0.0f )).xyz);
+}
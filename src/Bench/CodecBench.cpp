@@ -0,0 +1,232 @@
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/SnapshotCodec.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace WaveSimulation;
+
+// Compression ratio and throughput of the snapshot codecs. A few pulses are stepped on a Riemann2Grid and a
+// snapshot of the whole grid is taken every interval steps, then every codec encodes and decodes the series
+// in order like the writer and a reader would. Throughput is in GB of raw payload per second, the error is the
+// largest absolute difference of a decoded value to the snapshot, lossless has to be 0 and lossy stay within
+// its tolerance
+
+struct BenchConfig {
+	size_t size{ 512 };
+	size_t frames{ 16 };
+	size_t interval{ 4 };
+	size_t threads{ 0 };   //Encoding and decoding threads, 0 uses all
+	const char* precision{ Fp32::name };
+	std::vector<double> tolerances{ 1e-2, 1e-3, 1e-4, 1e-5 };
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --size N                Grid edge in cells (default 512)\n"
+		<< "  --frames N              Snapshots in the series (default 16)\n"
+		<< "  --interval K            Steps between snapshots (default 4)\n"
+		<< "  --precision P           Storage precision fp64|fp32|fp16|bf16 (default fp32)\n"
+		<< "  --tolerance T           Tolerance of the lossy codec, repeat for several (default 1e-2 to 1e-5)\n"
+		<< "  --codec-threads N       Threads encoding and decoding a frame, 0 uses all (default 0)\n"
+		<< "  --threads N             Worker threads stepping the grid, 0 uses all (default 0)" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, BenchConfig& conf ){
+	bool tolerances = false;
+
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( !val )
+			return false;
+
+		if( !strcmp( arg, "--size" )){
+			conf.size = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--frames" )){
+			conf.frames = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--interval" )){
+			conf.interval = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--precision" )){
+			conf.precision = val;
+		} else if( !strcmp( arg, "--tolerance" )){
+			if( !tolerances )
+				conf.tolerances.clear();
+			tolerances = true;
+			conf.tolerances.push_back( std::strtod( val, nullptr ));
+			if( !( conf.tolerances.back() > 0 ))
+				return false;
+		} else if( !strcmp( arg, "--codec-threads" )){
+			conf.threads = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--threads" )){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+		} else {
+			return false;
+		}
+		++i;
+	}
+
+	return conf.size >= 4 && conf.frames && conf.interval;
+}
+
+// Pulses of different width, the quiet parts of the grid fill up with waves as the series goes on
+template<typename Grid>
+static void init_grid( Grid& grid, size_t size ){
+	const float centers[3][3] = {{ 0.3f, 0.3f, 300.0f }, { 0.7f, 0.4f, 80.0f }, { 0.45f, 0.75f, 1200.0f }};
+
+	using Vec = decltype( Grid::Cell::p );
+
+	grid.resize( size, size );
+	grid.integrator = TimeIntegrator::SSPRK3;
+
+	for( size_t y = 0; y < size; ++y ){
+		for( size_t x = 0; x < size; ++x ){
+			float p = 0;
+			for( const auto& c : centers ){
+				float dx = ( x + 0.5f ) / size - c[0];
+				float dy = ( y + 0.5f ) / size - c[1];
+				p += std::exp( -( dx * dx + dy * dy ) * c[2] );
+			}
+			grid.set( x, y, typename Grid::Cell{ .p = Vec( p ), .ux = Vec(), .uy = Vec() });
+		}
+	}
+}
+
+//16 bit storage types convert through float
+template<typename S>
+static double value( S s ){
+	if constexpr( std::is_same_v<S, double> )
+		return s;
+	else
+		return static_cast<float>( s );
+}
+
+struct CodecResult {
+	double ratio;
+	double encode;  //GB/s
+	double decode;  //GB/s
+	double error;
+	bool decoded;
+};
+
+template<typename S>
+static CodecResult measure( const SnapshotHeader& header, const std::vector<std::vector<char>>& frames, SnapshotCodec codec, double tolerance, size_t threads ){
+	const size_t raw_size = frames[0].size();
+
+	SnapshotEncoder encoder( header, codec, tolerance, 32, threads );
+	SnapshotDecoder decoder( header, threads );
+
+	std::vector<std::vector<char>> encoded( frames.size(), std::vector<char>( encoder.bound() ));
+	std::vector<SnapshotFrame> headers( frames.size() );
+	std::vector<char> decoded( raw_size );
+	CodecResult res{ 0, 0, 0, 0, true };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t payload = 0;
+	for( size_t f = 0; f < frames.size(); ++f )
+		payload += encoder.encode( headers[f], frames[f].data(), encoded[f].data() );
+	auto end = std::chrono::high_resolution_clock::now();
+	res.encode = raw_size * frames.size() / std::chrono::duration<double>( end - start ).count() * 1e-9;
+	res.ratio = static_cast<double>( raw_size * frames.size() ) / payload;
+
+	double decoding = 0;
+	for( size_t f = 0; f < frames.size(); ++f ){
+		start = std::chrono::high_resolution_clock::now();
+		res.decoded = decoder.decode( headers[f], encoded[f].data(), decoded.data() ) && res.decoded;
+		end = std::chrono::high_resolution_clock::now();
+		decoding += std::chrono::duration<double>( end - start ).count();
+
+		const S* a = reinterpret_cast<const S*>( frames[f].data() );
+		const S* b = reinterpret_cast<const S*>( decoded.data() );
+		for( size_t i = 0; i < raw_size / sizeof( S ); ++i ){
+			double error = std::fabs( value( a[i] ) - value( b[i] ));
+			res.error = std::max( res.error, error == error ? error : INFINITY );
+		}
+	}
+	res.decode = raw_size * frames.size() / decoding * 1e-9;
+
+	return res;
+}
+
+template<typename Precision>
+static void bench( const BenchConfig& conf ){
+	using Grid = Riemann2Grid<Precision>;
+	using S = typename Grid::S;
+
+	Grid grid;
+	init_grid( grid, conf.size );
+	const double dt = grid.stable_dt();
+
+	SnapshotConfig snapshot;
+	const SnapshotHeader header = snapshot_header( grid, snapshot );
+	const size_t raw_size = header.planes * header.width * header.height * header.storage_size;
+
+	std::vector<std::vector<char>> frames;
+	for( size_t f = 0; f < conf.frames; ++f ){
+		for( size_t i = 0; i < conf.interval; ++i )
+			grid.step( dt );
+		frames.emplace_back( raw_size );
+		capture_snapshot( grid, header, frames.back().data() );
+	}
+
+	std::cout << "grid:       " << conf.size << "^2, " << Precision::name << "\n"
+		<< "series:     " << conf.frames << " frames of " << raw_size * 1e-6 << " MB, " << conf.interval << " steps apart\n"
+		<< "threads:    " << ( conf.threads ? conf.threads : std::max( std::thread::hardware_concurrency(), 1u )) << " per codec\n\n"
+		<< "codec     tolerance     ratio  encode GB/s  decode GB/s   max error" << std::endl;
+
+	auto row = [&]( SnapshotCodec codec, double tolerance ){
+		CodecResult res = measure<S>( header, frames, codec, tolerance, conf.threads );
+
+		std::cout << std::left << std::setw( 10 ) << snapshot_codec_name( codec ) << std::right;
+		if( tolerance > 0 )
+			std::cout << std::scientific << std::setprecision( 1 ) << std::setw( 9 ) << tolerance;
+		else
+			std::cout << std::setw( 9 ) << "-";
+		std::cout << std::fixed << std::setprecision( 2 )
+			<< std::setw( 10 ) << res.ratio
+			<< std::setw( 13 ) << res.encode
+			<< std::setw( 13 ) << res.decode
+			<< std::scientific << std::setprecision( 2 ) << std::setw( 12 ) << res.error;
+		if( !res.decoded || res.error > tolerance )
+			std::cout << "  FAILED";
+		std::cout << std::endl;
+	};
+
+	row( SnapshotCodec::Raw, 0 );
+	row( SnapshotCodec::Lossless, 0 );
+	for( double tolerance : conf.tolerances )
+		row( SnapshotCodec::Lossy, tolerance );
+}
+
+int main( int argc, char** argv ){
+	BenchConfig conf;
+	if( !parse_args( argc, argv, conf )){
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	if( !strcmp( conf.precision, Fp64::name ))
+		bench<Fp64>( conf );
+	else if( !strcmp( conf.precision, Fp32::name ))
+		bench<Fp32>( conf );
+	else if( !strcmp( conf.precision, Fp16::name ))
+		bench<Fp16>( conf );
+	else if( !strcmp( conf.precision, Bf16::name ))
+		bench<Bf16>( conf );
+	else {
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
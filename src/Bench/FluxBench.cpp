@@ -0,0 +1,84 @@
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/RiemannSolver.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace WaveSimulation;
+
+// Face flux evaluations per second: the generic matrix solver against the
+// direction specialized RiemannSolver, with the normal known at runtime and at compile time
+
+template<typename Func>
+static void measure( const char* name, size_t evaluations, Func&& func ){
+	auto start = std::chrono::high_resolution_clock::now();
+	glm::vec3 sum = func();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>( end - start ).count();
+
+	//The checksum keeps the compiler from dropping the loop
+	std::cout << std::left << std::setw( 28 ) << name
+		<< std::right << std::fixed << std::setprecision( 2 ) << std::setw( 10 ) << evaluations / seconds * 1e-6 << " Mflux/s"
+		<< "   (checksum " << sum.x + sum.y + sum.z << ")" << std::endl;
+}
+
+int main( int argc, char** argv ){
+	size_t states = 4096;
+	size_t rounds = argc > 1 ? std::strtoull( argv[1], nullptr, 10 ) : 2000;
+
+	std::mt19937 rng( 42 );
+	std::uniform_real_distribution<float> dist( -1.0f, 1.0f );
+
+	std::vector<glm::vec3> left( states ), right( states );
+	for( size_t i = 0; i < states; ++i ){
+		left[i] = glm::vec3( dist( rng ), dist( rng ), dist( rng ));
+		right[i] = glm::vec3( dist( rng ), dist( rng ), dist( rng ));
+	}
+
+	const glm::vec2 normals[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+	Riemann2Grid<> grid;
+	RiemannSolver<> solver;
+	solver.update( grid.K0, grid.onebyrho0 );
+
+	size_t evaluations = states * rounds * 4;
+
+	std::cout << "faces per run: " << evaluations << "\n" << std::endl;
+
+	measure( "solveRiemann (mat3)", evaluations, [&]{
+		glm::vec3 sum( 0 );
+		for( size_t r = 0; r < rounds; ++r )
+			for( size_t i = 0; i < states; ++i )
+				for( const glm::vec2& n: normals )
+					sum += grid.solveRiemann( left[i], right[i], 0.003, n );
+		return sum;
+	});
+
+	measure( "RiemannSolver runtime normal", evaluations, [&]{
+		glm::vec3 sum( 0 );
+		for( size_t r = 0; r < rounds; ++r )
+			for( size_t i = 0; i < states; ++i )
+				for( const glm::vec2& n: normals )
+					sum += solver.flux( left[i], right[i], n );
+		return sum;
+	});
+
+	measure( "RiemannSolver<Direction>", evaluations, [&]{
+		glm::vec3 sum( 0 );
+		for( size_t r = 0; r < rounds; ++r )
+			for( size_t i = 0; i < states; ++i ){
+				sum += solver.flux<Direction::XNeg>( left[i], right[i] );
+				sum += solver.flux<Direction::XPos>( left[i], right[i] );
+				sum += solver.flux<Direction::YNeg>( left[i], right[i] );
+				sum += solver.flux<Direction::YPos>( left[i], right[i] );
+			}
+		return sum;
+	});
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+#include "WaveSimulation/DistributedGrid.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+using namespace WaveSimulation;
+
+// Strong and weak scaling of DistributedGrid. Started with mpirun -np N it measures every power of two
+// ranks below N and N itself, the ranks not taking part wait. Strong scaling steps a size * size domain
+// on all of them, weak scaling weak_size * weak_size cells per rank. The time of a run is that of its
+// slowest rank, the exchange wait is the share of it the slowest rank spent waiting for halos.
+// With --verify rank 0 also steps the undecomposed grid and compares it bitwise to the gathered strong run
+
+struct BenchConfig {
+	size_t size{ 2048 };
+	size_t weak_size{ 1024 };
+	size_t steps{ 20 };
+	TimeIntegrator integrator{ TimeIntegrator::SSPRK3 };
+	BoundaryPolicy boundary{ BoundaryPolicy::Reflective };
+	bool simple{ true };
+	bool riemann{ true };
+	bool verify{ false };
+};
+
+struct RunResult {
+	double seconds;
+	double wait;  //Share of seconds spent waiting for halos
+	int dims[2];
+	bool equal;
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: mpirun -np N " << name << " [options]\n"
+		<< "  --size N                Domain edge of the strong scaling runs (default 2048)\n"
+		<< "  --weak-size N           Block edge per rank of the weak scaling runs (default 1024)\n"
+		<< "  --steps N               Steps per run (default 20)\n"
+		<< "  --grid simple|riemann   Only benchmark one grid type\n"
+		<< "  --integrator I          ssprk2|ssprk3 of the riemann grid (default ssprk3)\n"
+		<< "  --periodic              Periodic domain instead of reflective walls\n"
+		<< "  --threads N             Worker threads per rank including the main thread (default 1)\n"
+		<< "  --verify                Compare the strong runs to the undecomposed grid on rank 0" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, BenchConfig& conf ){
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( !strcmp( arg, "--periodic" )){
+			conf.boundary = BoundaryPolicy::Periodic;
+			continue;
+		} else if( !strcmp( arg, "--verify" )){
+			conf.verify = true;
+			continue;
+		}
+
+		if( !val )
+			return false;
+
+		if( !strcmp( arg, "--size" )){
+			conf.size = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--weak-size" )){
+			conf.weak_size = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--steps" )){
+			conf.steps = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--grid" )){
+			conf.simple = !strcmp( val, "simple" );
+			conf.riemann = !strcmp( val, "riemann" );
+			if( !conf.simple && !conf.riemann )
+				return false;
+		} else if( !strcmp( arg, "--integrator" )){
+			TimeIntegrator integrator = TimeIntegrator::Euler;
+			while( strcmp( val, time_integrator_name( integrator ))){
+				if( integrator == TimeIntegrator::SSPRK3 )
+					return false;
+				integrator = static_cast<TimeIntegrator>( static_cast<int>( integrator ) + 1 );
+			}
+			//Steps with stable_dt(), which forward euler does not have
+			if( integrator == TimeIntegrator::Euler )
+				return false;
+			conf.integrator = integrator;
+		} else if( !strcmp( arg, "--threads" )){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+		} else {
+			return false;
+		}
+		++i;
+	}
+
+	return conf.size >= 4 && conf.weak_size >= 4 && conf.steps;
+}
+
+// Gaussian pulse over a x_size * y_size domain
+template<typename Grid>
+static auto pulse( size_t x, size_t y, size_t x_size, size_t y_size ){
+	float dx = ( x + 0.5f ) / x_size - 0.4f;
+	float dy = ( y + 0.5f ) / y_size - 0.5f;
+	float p = std::exp( -( dx * dx + dy * dy ) * 150.0f );
+
+	if constexpr( StagedGrid<Grid> )
+		return typename Grid::Cell{ .p = glm::vec4( p ), .ux = glm::vec4(), .uy = glm::vec4() };
+	else
+		return glm::vec3( p, 0, 0 );
+}
+
+template<typename Grid>
+static void setup( Grid& grid, const BenchConfig& conf ){
+	grid.K0 = 1;
+	grid.onebyrho0 = 1;
+	if constexpr( StagedGrid<Grid> ){
+		grid.integrator = conf.integrator;
+		grid.skip_quiet = false;
+	}
+}
+
+//Grid itself or its DistributedGrid
+template<typename Grid, typename Stepper>
+static void step( Stepper& grid, double dt ){
+	if constexpr( StagedGrid<Grid> )
+		grid.step( dt );
+	else
+		grid.step_finite_volume( dt );
+}
+
+template<typename Grid, typename Stepper>
+static double time_step( const Stepper& grid ){
+	if constexpr( StagedGrid<Grid> )
+		return grid.stable_dt();
+	else
+		return 0.001;
+}
+
+template<typename Grid>
+static bool equal_values( const Grid& a, const Grid& b ){
+	using S = typename Grid::S;
+
+	for( size_t n = 0; n < Grid::Field::plane_amount; ++n )
+		for( size_t y = 0; y < a.y_s; ++y )
+			if( memcmp( a.values.plane( n ) + a.values.index( 0, y ), b.values.plane( n ) + b.values.index( 0, y ), a.x_s * sizeof( S )))
+				return false;
+	return true;
+}
+
+// Steps x_size * y_size on the ranks of comm, reference is the undecomposed result on rank 0 or nullptr
+template<typename Grid>
+static RunResult run( MPI_Comm comm, size_t x_size, size_t y_size, const BenchConfig& conf, const Grid* reference ){
+	DistributedGrid<Grid> dist;
+	RunResult res{ 0, 0, { 0, 0 }, true };
+
+	setup( dist.grid, conf );
+	if( !dist.create( comm, x_size, y_size, conf.boundary ))
+		MPI_Abort( MPI_COMM_WORLD, EXIT_FAILURE );
+
+	dist.fill( [&]( size_t x, size_t y ){ return pulse<Grid>( x, y, x_size, y_size ); });
+
+	double dt = time_step<Grid>( dist );
+	step<Grid>( dist, dt ); //Warm up, touches every field and buffer
+	dist.exchange_wait = 0;
+
+	MPI_Barrier( comm );
+	double start = MPI_Wtime();
+	for( size_t i = 0; i < conf.steps; ++i )
+		step<Grid>( dist, dt );
+	double local[2] = { MPI_Wtime() - start, dist.exchange_wait }, slowest[2];
+
+	MPI_Reduce( local, slowest, 2, MPI_DOUBLE, MPI_MAX, 0, comm );
+
+	res.seconds = slowest[0];
+	res.wait = slowest[1] / slowest[0];
+	res.dims[0] = dist.decomposition.dims[0];
+	res.dims[1] = dist.decomposition.dims[1];
+
+	if( reference ){
+		Grid whole;
+		dist.gather( whole );
+		if( dist.decomposition.rank == 0 )
+			res.equal = equal_values( whole, *reference );
+	}
+
+	return res;
+}
+
+// The undecomposed grid stepped like run() does
+template<typename Grid>
+static void reference_run( Grid& grid, const BenchConfig& conf ){
+	setup( grid, conf );
+	grid.boundary = conf.boundary;
+	grid.resize( conf.size, conf.size );
+	for( size_t y = 0; y < conf.size; ++y )
+		for( size_t x = 0; x < conf.size; ++x )
+			grid.set( x, y, pulse<Grid>( x, y, conf.size, conf.size ));
+
+	double dt = time_step<Grid>( grid );
+	for( size_t i = 0; i <= conf.steps; ++i )
+		step<Grid>( grid, dt );
+}
+
+template<typename Grid>
+static void bench( const char* name, const BenchConfig& conf ){
+	int rank, ranks;
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &ranks );
+
+	Grid reference;
+	if( conf.verify && rank == 0 )
+		reference_run( reference, conf );
+
+	double strong_1 = 0, weak_1 = 0;
+
+	for( int n = 1; n <= ranks; n = n * 2 > ranks && n != ranks ? ranks : n * 2 ){
+		MPI_Comm comm;
+		MPI_Comm_split( MPI_COMM_WORLD, rank < n ? 0 : MPI_UNDEFINED, rank, &comm );
+
+		if( comm != MPI_COMM_NULL ){
+			int dims[2] = { 0, 0 };
+			MPI_Dims_create( n, 2, dims );
+
+			RunResult strong = run<Grid>( comm, conf.size, conf.size, conf, conf.verify ? &reference : nullptr );
+			RunResult weak = run<Grid>( comm, conf.weak_size * dims[1], conf.weak_size * dims[0], conf, nullptr );
+
+			if( rank == 0 ){
+				if( n == 1 ){
+					strong_1 = strong.seconds;
+					weak_1 = weak.seconds;
+				}
+
+				double cells = static_cast<double>( conf.size * conf.size ) * conf.steps;
+				double weak_cells = static_cast<double>( conf.weak_size * conf.weak_size ) * n * conf.steps;
+
+				std::cout << std::left << std::setw( 10 ) << name
+					<< std::right << std::setw( 6 ) << n
+					<< std::setw( 5 ) << strong.dims[0] << "x" << std::left << std::setw( 4 ) << strong.dims[1] << std::right
+					<< std::fixed << std::setprecision( 2 )
+					<< std::setw( 10 ) << cells / strong.seconds * 1e-6
+					<< std::setw( 7 ) << strong_1 / ( n * strong.seconds )
+					<< std::setw( 7 ) << strong.wait
+					<< std::setw( 10 ) << weak_cells / weak.seconds * 1e-6
+					<< std::setw( 7 ) << weak_1 / weak.seconds
+					<< std::setw( 7 ) << weak.wait;
+				if( conf.verify )
+					std::cout << ( strong.equal ? "  equal" : "  DIFFERS" );
+				std::cout << std::endl;
+			}
+
+			MPI_Comm_free( &comm );
+		}
+
+		MPI_Barrier( MPI_COMM_WORLD );
+	}
+}
+
+int main( int argc, char** argv ){
+	int provided;
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &provided );
+
+	int rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+	//Ranks share the machine, one thread each unless asked for more
+	set_thread_amount( 1 );
+
+	BenchConfig conf;
+	if( !parse_args( argc, argv, conf )){
+		if( rank == 0 )
+			print_usage( argv[0] );
+		MPI_Finalize();
+		return EXIT_FAILURE;
+	}
+
+	if( rank == 0 ){
+		std::cout << "threads:    " << thread_pool().thread_amount() << " per rank\n"
+			<< "integrator: " << time_integrator_name( conf.integrator ) << " (riemann)\n"
+			<< "strong:     " << conf.size << "^2\n"
+			<< "weak:       " << conf.weak_size << "^2 per rank\n\n"
+			<< "                                   strong                   weak\n"
+			<< "grid       ranks  split      Mcell/s    eff   wait   Mcell/s    eff   wait" << std::endl;
+	}
+
+	if( conf.simple )
+		bench<SimpleGrid<>>( "simple", conf );
+	if( conf.riemann )
+		bench<Riemann2Grid<>>( "riemann", conf );
+
+	MPI_Finalize();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/Simd.hpp"
+#include "WaveSimulation/SumFactorization.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+using namespace WaveSimulation;
+
+// Degrees of freedom updated per second by Riemann2Grid<Fp32, Order>::step() for orders 1 to 7, on grids of about
+// the same amount of nodes, every node holds the three degrees of freedom p, ux and uy. Next to it the derivative
+// along x of the element, applied sum factorized with apply_x() and as the dense n^2 x n^2 matrix it replaces
+
+struct BenchConfig {
+	size_t nodes{ size_t( 1 ) << 18 };      //Nodes per grid
+	size_t min_updates{ size_t( 1 ) << 24 }; //Node updates per measurement, at least 2 steps are run
+	TimeIntegrator integrator{ TimeIntegrator::SSPRK3 };
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --nodes N               Nodes per grid, the grid edge follows from the order (default 2^18)\n"
+		<< "  --updates N             Node updates per measurement (default 2^24)\n"
+		<< "  --integrator I          ssprk2|ssprk3 (default ssprk3)\n"
+		<< "  --threads N             Worker threads including the main thread, 0 uses all (default 0)\n"
+		<< "  --simd LEVEL            Limit the order 1 kernels to scalar|sse4.2|avx2|avx512 (default detected)" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, BenchConfig& conf ){
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( !val )
+			return false;
+
+		if( !strcmp( arg, "--nodes" )){
+			conf.nodes = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--updates" )){
+			conf.min_updates = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--integrator" )){
+			TimeIntegrator integrator = TimeIntegrator::Euler;
+			while( strcmp( val, time_integrator_name( integrator ))){
+				if( integrator == TimeIntegrator::SSPRK3 )
+					return false;
+				integrator = static_cast<TimeIntegrator>( static_cast<int>( integrator ) + 1 );
+			}
+			//Steps with stable_dt(), which forward euler does not have
+			if( integrator == TimeIntegrator::Euler )
+				return false;
+			conf.integrator = integrator;
+		} else if( !strcmp( arg, "--threads" )){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+		} else if( !strcmp( arg, "--simd" )){
+			SimdLevel level = SimdLevel::Scalar;
+			while( strcmp( val, simd_level_name( level ))){
+				if( level == SimdLevel::AVX512 )
+					return false;
+				level = static_cast<SimdLevel>( static_cast<int>( level ) + 1 );
+			}
+			set_simd_level( level );
+		} else {
+			return false;
+		}
+		++i;
+	}
+
+	return conf.nodes >= 64;
+}
+
+// Gaussian pulse sampled at the nodes, so every order starts from the same wave
+template<typename Grid>
+static void init_grid( Grid& grid, size_t size ){
+	using Element = typename Grid::Element;
+
+	grid.resize( size, size );
+	for( size_t y = 0; y < size; ++y ){
+		for( size_t x = 0; x < size; ++x ){
+			typename Grid::Cell cell{};
+			for( size_t j = 0; j < Element::nodes; ++j ){
+				for( size_t i = 0; i < Element::nodes; ++i ){
+					float dx = ( x + Element::node[i] ) / size - 0.4f;
+					float dy = ( y + Element::node[j] ) / size - 0.5f;
+					cell.p[i + Element::nodes * j] = std::exp( -( dx * dx + dy * dy ) * 150.0f );
+				}
+			}
+			grid.set( x, y, cell );
+		}
+	}
+}
+
+template<typename Func>
+static double seconds_of( Func&& func ){
+	auto start = std::chrono::high_resolution_clock::now();
+	func();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double>( end - start ).count();
+}
+
+// Node updates per second of the derivative along x, sum factorized and dense
+template<size_t n>
+static std::pair<double, double> operator_throughput( size_t updates ){
+	using T = float;
+	using E = GaussLegendre<n - 1, T>;
+
+	const size_t elements = 256;
+	const size_t rounds = std::max( updates / ( elements * n * n ), size_t( 1 ));
+
+	std::mt19937 rng( 42 );
+	std::uniform_real_distribution<T> dist( -1, 1 );
+
+	std::vector<NodeValues<n, T>> in( elements ), out( elements );
+	for( auto& values: in )
+		for( T& v: values )
+			v = dist( rng );
+
+	//Kronecker product of the 1D derivative with the identity along y
+	std::vector<T> dense( n * n * n * n, T( 0 ));
+	for( size_t j = 0; j < n; ++j )
+		for( size_t i = 0; i < n; ++i )
+			for( size_t q = 0; q < n; ++q )
+				dense[( i + n * j ) * n * n + q + n * j] = E::derivative[i][q];
+
+	T checksum = 0;
+
+	double factorized = seconds_of( [&]{
+		for( size_t r = 0; r < rounds; ++r ){
+			for( size_t e = 0; e < elements; ++e )
+				apply_x<n>( E::derivative, in[e], out[e] );
+			checksum += out[r % elements][0];
+		}
+	});
+
+	double full = seconds_of( [&]{
+		for( size_t r = 0; r < rounds; ++r ){
+			for( size_t e = 0; e < elements; ++e ){
+				for( size_t row = 0; row < n * n; ++row ){
+					T sum( 0 );
+					for( size_t col = 0; col < n * n; ++col )
+						sum += dense[row * n * n + col] * in[e][col];
+					out[e][row] = sum;
+				}
+			}
+			checksum += out[r % elements][0];
+		}
+	});
+
+	//The checksum keeps the compiler from dropping the loops
+	if( checksum == 12345.0f )
+		std::cout << checksum;
+
+	double nodes = static_cast<double>( rounds ) * elements * n * n;
+	return { nodes / factorized, nodes / full };
+}
+
+template<size_t Order>
+static void bench( const BenchConfig& conf ){
+	using Grid = Riemann2Grid<Fp32, Order>;
+
+	const size_t size = std::max( static_cast<size_t>( std::sqrt( double( conf.nodes ) / Grid::nodes )), size_t( 4 ));
+	const size_t nodes = size * size * Grid::nodes;
+	const size_t steps = std::max( conf.min_updates / nodes, size_t( 2 ));
+
+	Grid grid;
+	init_grid( grid, size );
+	grid.boundary = BoundaryPolicy::Periodic;
+	grid.integrator = conf.integrator;
+	grid.skip_quiet = false;
+
+	const double dt = grid.stable_dt();
+	grid.step( dt ); //Warm up, touches every field
+
+	double seconds = seconds_of( [&]{
+		for( size_t i = 0; i < steps; ++i )
+			grid.step( dt );
+	});
+
+	auto [factorized, dense] = operator_throughput<Order + 1>( conf.min_updates );
+
+	std::cout << std::setw( 5 ) << Order
+		<< std::setw( 8 ) << Grid::nodes
+		<< std::setw( 7 ) << size << "^2"
+		<< std::setw( 8 ) << steps
+		<< std::fixed << std::setprecision( 2 )
+		<< std::setw( 10 ) << 3.0 * nodes * steps / seconds * 1e-6
+		<< std::setw( 10 ) << static_cast<double>( size * size ) * steps / seconds * 1e-6
+		<< std::setw( 12 ) << factorized * 1e-6
+		<< std::setw( 10 ) << dense * 1e-6 << std::endl;
+}
+
+template<size_t... Orders>
+static void bench_orders( const BenchConfig& conf, std::index_sequence<Orders...> ){
+	( bench<Orders + 1>( conf ), ... );
+}
+
+int main( int argc, char** argv ){
+	BenchConfig conf;
+
+	if( !parse_args( argc, argv, conf )){
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "simd:       " << simd_level_name( active_simd_level() ) << " (order 1 only)\n"
+		<< "threads:    " << thread_pool().thread_amount() << "\n"
+		<< "integrator: " << time_integrator_name( conf.integrator ) << "\n\n"
+		<< "                                  step() M/s      d/dx Mnode/s\n"
+		<< "order   nodes   grid    steps      dofs  elements  factorized     dense" << std::endl;
+
+	bench_orders( conf, std::make_index_sequence<7>() );
+
+	return EXIT_SUCCESS;
+}
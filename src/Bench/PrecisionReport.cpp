@@ -0,0 +1,189 @@
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/Simd.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+using namespace WaveSimulation;
+
+// Accuracy against throughput of the precision policies. Every scenario is stepped with Fp64 as the
+// reference and then with Fp32, Fp16 and Bf16. The errors are over all state variables after the
+// last step, relative to the largest magnitude of the reference state.
+// The bundled scenarios are 64x64 grids that fit in cache, --scale enlarges them so the bandwidth saved
+// by the 16 bit storage shows up: wavesim_precision_report --scale 16 assets/riemann*.bmp
+
+struct ReportConfig {
+	std::vector<const char*> scenarios;
+	size_t steps{ 500 };
+	double dt{ 0.003 };
+	size_t scale{ 1 };
+	bool simple{ false };
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: " << name << " <scenario.bmp>... [options]\n"
+		<< "  --grid simple|riemann   Grid type (default riemann)\n"
+		<< "  --steps N               Finite volume steps per run (default 500)\n"
+		<< "  --dt DT                 Timestep (default 0.003)\n"
+		<< "  --scale N               Enlarge the start condition N times per axis (default 1)\n"
+		<< "  --threads N             Worker threads including the main thread, 0 uses all (default 0)\n"
+		<< "  --simd LEVEL            Limit the kernels to scalar|sse4.2|avx2|avx512 (default detected)" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, ReportConfig& conf ){
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( arg[0] != '-' ){
+			conf.scenarios.push_back( arg );
+			continue;
+		}
+
+		if( !val )
+			return false;
+
+		if( !strcmp( arg, "--grid" )){
+			conf.simple = !strcmp( val, "simple" );
+			if( !conf.simple && strcmp( val, "riemann" ))
+				return false;
+		} else if( !strcmp( arg, "--steps" )){
+			conf.steps = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--dt" )){
+			conf.dt = std::strtod( val, nullptr );
+		} else if( !strcmp( arg, "--scale" )){
+			conf.scale = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--threads" )){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+		} else if( !strcmp( arg, "--simd" )){
+			SimdLevel level = SimdLevel::Scalar;
+			while( strcmp( val, simd_level_name( level ))){
+				if( level == SimdLevel::AVX512 )
+					return false;
+				level = static_cast<SimdLevel>( static_cast<int>( level ) + 1 );
+			}
+			set_simd_level( level );
+		} else {
+			return false;
+		}
+		++i;
+	}
+
+	return !conf.scenarios.empty() && conf.scale;
+}
+
+// Interior state of a grid as doubles, plane after plane
+template<typename Grid>
+static std::vector<double> state( const Grid& grid ){
+	using T = typename Grid::T;
+
+	std::vector<double> res;
+	res.reserve( Grid::Field::plane_amount * grid.x_s * grid.y_s );
+
+	for( size_t p = 0; p < Grid::Field::plane_amount; ++p )
+		for( size_t y = 0; y < grid.y_s; ++y )
+			for( size_t x = 0; x < grid.x_s; ++x )
+				res.push_back( T( grid.values.plane( p )[grid.values.index( x, y )] ));
+
+	return res;
+}
+
+struct Run {
+	std::vector<double> state;
+	double seconds;
+	size_t cell_updates;
+};
+
+// Nearest neighbour enlarged copy of the start condition src, stepped steps times
+template<typename Grid, typename Source>
+static Run run( const Source& src, const ReportConfig& conf ){
+	using T = typename Grid::T;
+	using S = typename Grid::S;
+
+	Grid grid;
+	grid.resize( src.x_s * conf.scale, src.y_s * conf.scale );
+
+	for( size_t p = 0; p < Grid::Field::plane_amount; ++p )
+		for( size_t y = 0; y < grid.y_s; ++y )
+			for( size_t x = 0; x < grid.x_s; ++x )
+				grid.values.plane( p )[grid.values.index( x, y )] = S( T( src.values.plane( p )[src.values.index( x / conf.scale, y / conf.scale )] ));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for( size_t i = 0; i < conf.steps; ++i )
+		grid.step_finite_volume( conf.dt );
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return Run{ state( grid ), std::chrono::duration<double>( end - start ).count(), grid.x_s * grid.y_s * conf.steps };
+}
+
+template<typename Grid>
+static void report_row( const char* precision, const Run& run, const Run& reference ){
+	double max_ref = 0, max_err = 0, sum_sq = 0;
+
+	for( size_t i = 0; i < run.state.size(); ++i ){
+		double err = std::abs( run.state[i] - reference.state[i] );
+
+		max_ref = std::max( max_ref, std::abs( reference.state[i] ));
+		max_err = std::max( max_err, err );
+		sum_sq += err * err;
+	}
+
+	double rms = std::sqrt( sum_sq / run.state.size() );
+	max_ref = max_ref ? max_ref : 1;
+
+	std::cout << "  " << std::left << std::setw( 6 ) << precision
+		<< std::right << std::setw( 8 ) << Grid::Field::plane_amount * sizeof( typename Grid::S )
+		<< std::fixed << std::setprecision( 2 ) << std::setw( 10 ) << run.cell_updates * 1e-6 / run.seconds
+		<< std::scientific << std::setprecision( 3 )
+		<< std::setw( 12 ) << max_err / max_ref
+		<< std::setw( 12 ) << rms / max_ref << std::endl;
+}
+
+template<template<typename> typename Grid>
+static bool report( const char* scenario, const ReportConfig& conf ){
+	Grid<Fp64> src;
+	if( !src.init( scenario ))
+		return false;
+
+	std::cout << scenario << ", " << src.x_s * conf.scale << "x" << src.y_s * conf.scale << " cells, " << conf.steps << " steps\n"
+		<< "  prec  B/cell   Mcell/s   max error   rms error" << std::endl;
+
+	Run reference = run<Grid<Fp64>>( src, conf );
+
+	report_row<Grid<Fp64>>( Fp64::name, reference, reference );
+	report_row<Grid<Fp32>>( Fp32::name, run<Grid<Fp32>>( src, conf ), reference );
+	report_row<Grid<Fp16>>( Fp16::name, run<Grid<Fp16>>( src, conf ), reference );
+	report_row<Grid<Bf16>>( Bf16::name, run<Grid<Bf16>>( src, conf ), reference );
+
+	std::cout << std::endl;
+	return true;
+}
+
+int main( int argc, char** argv ){
+	ReportConfig conf;
+
+	if( !parse_args( argc, argv, conf )){
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "grid:    " << ( conf.simple ? "simple" : "riemann" ) << "\n"
+		<< "simd:    " << simd_level_name( active_simd_level() ) << "\n"
+		<< "threads: " << thread_pool().thread_amount() << "\n"
+		<< "errors relative to the largest fp64 magnitude\n" << std::endl;
+
+	for( const char* scenario: conf.scenarios ){
+		bool ok = conf.simple ? report<SimpleGrid>( scenario, conf ) : report<Riemann2Grid>( scenario, conf );
+		if( !ok )
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/Simd.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+
+using namespace WaveSimulation;
+
+// Throughput of the grid steppers over growing grid sizes: plain row-major traversal (full width
+// tiles of one row), tiled and temporally blocked. Grids are initialised with a gaussian pulse
+
+struct BenchConfig {
+	size_t min_size{ 64 };
+	size_t max_size{ 8192 };
+	size_t min_updates{ size_t( 1 ) << 24 }; //Cell updates per measurement, at least 2 steps are run
+	TileConfig tiles;
+	size_t depth{ 8 }; //Steps per temporal block
+	bool simple{ true };
+	bool riemann{ true };
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: " << name << " [options]\n"
+		<< "  --min-size N            Smallest grid edge (default 64)\n"
+		<< "  --max-size N            Largest grid edge, the riemann grid needs 96 bytes per cell (default 8192)\n"
+		<< "  --updates N             Cell updates per measurement (default 2^24)\n"
+		<< "  --grid simple|riemann   Only benchmark one grid type\n"
+		<< "  --tile WxH              Tile size of the tiled and blocked runs (default 1024x64)\n"
+		<< "  --depth N               Steps per temporal block (default 8)\n"
+		<< "  --threads N             Worker threads including the main thread, 0 uses all (default 0)\n"
+		<< "  --simd LEVEL            Limit the kernels to scalar|sse4.2|avx2|avx512 (default detected)" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, BenchConfig& conf ){
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( !val )
+			return false;
+
+		if( !strcmp( arg, "--min-size" )){
+			conf.min_size = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--max-size" )){
+			conf.max_size = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--updates" )){
+			conf.min_updates = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--grid" )){
+			conf.simple = !strcmp( val, "simple" );
+			conf.riemann = !strcmp( val, "riemann" );
+			if( !conf.simple && !conf.riemann )
+				return false;
+		} else if( !strcmp( arg, "--tile" )){
+			char* end;
+			conf.tiles.x = std::strtoull( val, &end, 10 );
+			if( *end != 'x' )
+				return false;
+			conf.tiles.y = std::strtoull( end + 1, nullptr, 10 );
+		} else if( !strcmp( arg, "--depth" )){
+			conf.depth = std::strtoull( val, nullptr, 10 );
+		} else if( !strcmp( arg, "--threads" )){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+		} else if( !strcmp( arg, "--simd" )){
+			SimdLevel level = SimdLevel::Scalar;
+			while( strcmp( val, simd_level_name( level ))){
+				if( level == SimdLevel::AVX512 )
+					return false;
+				level = static_cast<SimdLevel>( static_cast<int>( level ) + 1 );
+			}
+			set_simd_level( level );
+		} else {
+			return false;
+		}
+		++i;
+	}
+
+	return conf.min_size >= 4 && conf.min_size <= conf.max_size;
+}
+
+static float pulse( size_t x, size_t y, size_t size ){
+	float dx = ( x + 0.5f ) / size - 0.4f;
+	float dy = ( y + 0.5f ) / size - 0.5f;
+	return std::exp( -( dx * dx + dy * dy ) * 150.0f );
+}
+
+static void init_grid( SimpleGrid<>& grid, size_t size ){
+	grid.resize( size, size );
+	for( size_t y = 0; y < size; ++y )
+		for( size_t x = 0; x < size; ++x )
+			grid.set( x, y, glm::vec3( pulse( x, y, size ), 0, 0 ));
+}
+
+static void init_grid( Riemann2Grid<>& grid, size_t size ){
+	grid.resize( size, size );
+	for( size_t y = 0; y < size; ++y )
+		for( size_t x = 0; x < size; ++x )
+			grid.set( x, y, Riemann2Cell<>{ .p = glm::vec4( pulse( x, y, size )), .ux = glm::vec4(), .uy = glm::vec4() });
+}
+
+// Cell updates per second, single steps for depth 0
+template<typename Grid>
+static double measure( Grid& grid, size_t steps, size_t depth = 0 ){
+	constexpr double dt = 0.001;
+
+	grid.step_finite_volume( dt ); //Warm up, touches both buffers
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if( depth ){
+		grid.step_finite_volume_blocked( dt, steps, depth );
+	} else {
+		for( size_t i = 0; i < steps; ++i )
+			grid.step_finite_volume( dt );
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>( end - start ).count();
+	return static_cast<double>( grid.x_s * grid.y_s ) * steps / seconds;
+}
+
+template<typename Grid>
+static void bench( const char* name, const BenchConfig& conf ){
+	for( size_t size = conf.min_size; size <= conf.max_size; size *= 2 ){
+		size_t cells = size * size;
+		size_t steps = std::max( { conf.min_updates / cells, conf.depth, size_t( 2 ) });
+
+		Grid grid;
+		init_grid( grid, size );
+
+		grid.tiles = TileConfig{ 0, 1 };
+		double rows = measure( grid, steps );
+
+		grid.tiles = conf.tiles;
+		double tiled = measure( grid, steps );
+		double blocked = measure( grid, steps, conf.depth );
+
+		std::cout << std::left << std::setw( 10 ) << name
+			<< std::right << std::setw( 6 ) << size << "^2"
+			<< std::setw( 8 ) << steps
+			<< std::fixed << std::setprecision( 2 )
+			<< std::setw( 9 ) << rows * 1e-6
+			<< std::setw( 9 ) << tiled * 1e-6
+			<< std::setw( 9 ) << blocked * 1e-6 << std::endl;
+	}
+}
+
+int main( int argc, char** argv ){
+	BenchConfig conf;
+
+	if( !parse_args( argc, argv, conf )){
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "simd:    " << simd_level_name( active_simd_level() ) << "\n"
+		<< "threads: " << thread_pool().thread_amount() << "\n"
+		<< "tiles:   " << conf.tiles.x << "x" << conf.tiles.y << "\n"
+		<< "depth:   " << conf.depth << "\n\n"
+		<< "                          Mcell/s\n"
+		<< "grid        size   steps     rows    tiled  blocked" << std::endl;
+
+	if( conf.simple )
+		bench<SimpleGrid<>>( "simple", conf );
+	if( conf.riemann )
+		bench<Riemann2Grid<>>( "riemann", conf );
+
+	return EXIT_SUCCESS;
+}
@@ -29,15 +29,19 @@ void StrategyCamera::set_proj( glm::mat4 projection ){
 }
 
 const glm::mat4 StrategyCamera::get_view() const {
+	return glm::lookAt( get_position(), origin, { 0.0f, 1.0f, 0.0f });
+}
+
+const glm::mat4 StrategyCamera::get_proj() const {
+	return proj;
+}
+
+glm::vec3 StrategyCamera::get_position() const {
 	glm::vec3 pos{
 		distance * std::cos( rotation ),
 		height,
 		distance * std::sin( rotation ),
 	};
 
-	return glm::lookAt( pos + origin, origin, { 0.0f, 1.0f, 0.0f });
-}
-
-const glm::mat4 StrategyCamera::get_proj() const {
-	return proj;
+	return pos + origin;
 }
@@ -13,6 +13,7 @@ struct StrategyCamera {
 
 		const glm::mat4 get_view() const;
 		const glm::mat4 get_proj() const;
+		glm::vec3 get_position() const;
 
 		float min_height{ .2 };
 
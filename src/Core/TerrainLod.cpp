@@ -0,0 +1,212 @@
+#include "TerrainLod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+void TerrainLod::resize( size_t x_size, size_t y_size ){
+	x_s = std::max<size_t>( x_size, 2 );
+	y_s = std::max<size_t>( y_size, 2 );
+
+	//The root covers the grid, the level above it is only sampled by its morph
+	top = 0;
+	while( top + 2 < MAX_LEVELS && ( CHUNK << top ) < std::max( x_s, y_s ) - 1 )
+		++top;
+
+	levels.clear();
+	row_start.clear();
+	first_row.clear();
+
+	size_t width = x_s, height = y_s, offset = 0;
+	for( size_t l = 0; l <= top + 1; ++l ){
+		levels.push_back( LodLevel{ uint32_t( offset ), uint32_t( width ), uint32_t( height ), 0 });
+		first_row.push_back( row_start.size() );
+
+		for( size_t y = 0; y < height; ++y )
+			row_start.push_back( offset + y * width );
+
+		offset += width * height;
+		width = width / 2 + 1;
+		height = height / 2 + 1;
+	}
+	row_start.push_back( offset );
+
+	heights.assign( offset, 0.0f );
+	changes.resize( row_start.size() - 1 );
+
+	bounds.resize( top + 1 );
+	bounds_x.resize( top + 1 );
+	for( size_t l = 0; l <= top; ++l ){
+		const size_t size = CHUNK << l;
+		bounds_x[l] = ( x_s - 2 ) / size + 1;
+		bounds[l].assign( bounds_x[l] * (( y_s - 2 ) / size + 1 ), Bounds{ 0.0f, 0.0f });
+	}
+}
+
+void TerrainLod::update( size_t y0, size_t y1 ){
+	y1 = std::min( y1, y_s );
+	if( y0 >= y1 )
+		return;
+
+	changes.mark( y0, y1 );
+
+	//Row k of level l + 1 is filtered from rows 2k - 1 to 2k + 1 of level l
+	constexpr float tent[3] = { 0.25f, 0.5f, 0.25f };
+
+	size_t a = y0, b = y1;
+	for( size_t l = 0; l + 1 < levels.size(); ++l ){
+		const LodLevel& src = levels[l];
+		const LodLevel& dst = levels[l + 1];
+
+		a = a / 2;
+		b = std::min<size_t>( b / 2 + 1, dst.height );
+
+		const float* in = heights.data() + src.offset;
+		for( size_t k = a; k < b; ++k ){
+			float* out = heights.data() + dst.offset + k * dst.width;
+
+			for( size_t j = 0; j < dst.width; ++j ){
+				float sum = 0;
+				for( ptrdiff_t dy = -1; dy <= 1; ++dy ){
+					const size_t sy = std::clamp<ptrdiff_t>( 2 * k + dy, 0, src.height - 1 );
+					for( ptrdiff_t dx = -1; dx <= 1; ++dx ){
+						const size_t sx = std::clamp<ptrdiff_t>( 2 * j + dx, 0, src.width - 1 );
+						sum += tent[dy + 1] * tent[dx + 1] * in[sx + sy * src.width];
+					}
+				}
+				out[j] = sum;
+			}
+		}
+
+		changes.mark( first_row[l + 1] + a, first_row[l + 1] + b );
+	}
+
+	//Chunk cy of level 0 spans rows cy * CHUNK to cy * CHUNK + CHUNK
+	const size_t chunks_y = bounds[0].size() / bounds_x[0];
+	const size_t cy0 = y0 ? ( y0 - 1 ) / CHUNK : 0;
+	const size_t cy1 = std::min(( y1 - 1 ) / CHUNK + 1, chunks_y );
+
+	for( size_t cy = cy0; cy < cy1; ++cy ){
+		for( size_t cx = 0; cx < bounds_x[0]; ++cx ){
+			Bounds b{ heights[cx * CHUNK + cy * CHUNK * x_s], heights[cx * CHUNK + cy * CHUNK * x_s] };
+
+			for( size_t y = cy * CHUNK; y <= std::min( cy * CHUNK + CHUNK, y_s - 1 ); ++y ){
+				for( size_t x = cx * CHUNK; x <= std::min( cx * CHUNK + CHUNK, x_s - 1 ); ++x ){
+					b.lo = std::min( b.lo, heights[x + y * x_s] );
+					b.hi = std::max( b.hi, heights[x + y * x_s] );
+				}
+			}
+			bounds[0][cx + cy * bounds_x[0]] = b;
+		}
+	}
+
+	//The levels above are a few thousand chunks at most, rebuilt whole
+	for( size_t l = 1; l <= top; ++l ){
+		const size_t below_y = bounds[l - 1].size() / bounds_x[l - 1];
+
+		for( size_t i = 0; i < bounds[l].size(); ++i ){
+			const size_t cx = i % bounds_x[l], cy = i / bounds_x[l];
+			Bounds b{ INFINITY, -INFINITY };
+
+			for( size_t y = 2 * cy; y < std::min( 2 * cy + 2, below_y ); ++y ){
+				for( size_t x = 2 * cx; x < std::min( 2 * cx + 2, bounds_x[l - 1] ); ++x ){
+					b.lo = std::min( b.lo, bounds[l - 1][x + y * bounds_x[l - 1]].lo );
+					b.hi = std::max( b.hi, bounds[l - 1][x + y * bounds_x[l - 1]].hi );
+				}
+			}
+			bounds[l][i] = b;
+		}
+	}
+}
+
+float TerrainLod::range( size_t level ) const {
+	return level < top ? RANGE * chunk_world * float( size_t( 1 ) << level ) : 1e30f;
+}
+
+//Filtered and morphed heights of a chunk reach into its neighbours, their bounds count too
+TerrainLod::Bounds TerrainLod::node_bounds( size_t x, size_t y, size_t level ) const {
+	const std::vector<Bounds>& level_bounds = bounds[level];
+	const size_t size = CHUNK << level;
+	const size_t cx = x / size, cy = y / size;
+	const size_t chunks_y = level_bounds.size() / bounds_x[level];
+
+	Bounds b{ INFINITY, -INFINITY };
+	for( size_t ny = cy ? cy - 1 : 0; ny <= std::min( cy + 1, chunks_y - 1 ); ++ny ){
+		for( size_t nx = cx ? cx - 1 : 0; nx <= std::min( cx + 1, bounds_x[level] - 1 ); ++nx ){
+			b.lo = std::min( b.lo, level_bounds[nx + ny * bounds_x[level]].lo );
+			b.hi = std::max( b.hi, level_bounds[nx + ny * bounds_x[level]].hi );
+		}
+	}
+	return b;
+}
+
+void TerrainLod::select( const glm::mat4& view_proj, const glm::vec3& camera, const glm::vec3& scale ){
+	//Rows of view_proj, inside where dot( plane, ( p, 1 )) >= 0. The near plane of -w <= z also holds for 0 <= z
+	const glm::mat4 rows = glm::transpose( view_proj );
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	eye = camera;
+	world = scale;
+	chunk_world = CHUNK * std::max( scale.x, scale.z );
+
+	for( std::vector<LodNode>& part : selected )
+		part.clear();
+
+	select_node( 0, 0, top, selected );
+
+	nodes.clear();
+	for( size_t i = 0; i < 5; ++i ){
+		parts[i] = selected[i].size();
+		nodes.insert( nodes.end(), selected[i].begin(), selected[i].end() );
+	}
+}
+
+//False when the chunk is out of its range and its parent has to draw the area
+bool TerrainLod::select_node( size_t x, size_t y, size_t level, std::vector<LodNode> ( &out )[5] ){
+	const size_t size = CHUNK << level;
+	if( x >= x_s - 1 || y >= y_s - 1 )
+		return true;
+
+	const Bounds b = node_bounds( x, y, level );
+	const glm::vec3 lo{ x * world.x - 1, b.lo * world.y, y * world.z - 1 };
+	const glm::vec3 hi{ std::min( x + size, x_s - 1 ) * world.x - 1, b.hi * world.y, std::min( y + size, y_s - 1 ) * world.z - 1 };
+
+	//Culled when the corner furthest along a plane is behind it
+	for( const glm::vec4& plane : planes ){
+		const glm::vec3 corner{ plane.x > 0 ? hi.x : lo.x, plane.y > 0 ? hi.y : lo.y, plane.z > 0 ? hi.z : lo.z };
+		if( glm::dot( glm::vec3( plane ), corner ) + plane.w < 0 )
+			return true;
+	}
+
+	const float distance = glm::length( eye - glm::clamp( eye, lo, hi ));
+	if( distance > range( level ))
+		return false;
+
+	const LodNode node{ float( x ), float( y ), float( level ), range( level ) };
+	if( level == 0 || distance > range( level - 1 )){
+		out[0].push_back( node );
+		return true;
+	}
+
+	const size_t half = size / 2;
+	bool children[4];
+	for( size_t q = 0; q < 4; ++q )
+		children[q] = select_node( x + ( q & 1 ) * half, y + ( q >> 1 ) * half, level - 1, out );
+
+	if( !children[0] && !children[1] && !children[2] && !children[3] ){
+		out[0].push_back( node );
+		return true;
+	}
+
+	for( size_t q = 0; q < 4; ++q )
+		if( !children[q] )
+			out[q + 1].push_back( node );
+
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "WaveSimulation/RowChanges.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Level of detail for the heights of the grid after CDLOD (Strugar, Continuous Distance-Dependent Level of Detail).
+// The heights are kept as a pyramid, level l + 1 has a node on every other node of level l filtered with a 3x3 tent.
+// A quadtree of chunks of CHUNK x CHUNK quads covers the grid, a chunk of level l spaces its nodes 2^l nodes of level 0
+// apart. Chunks of level l are drawn within range( l ) of the camera, the rest by their parent. Towards the end of its
+// range a chunk morphs its odd nodes onto the even ones and its heights to those of level l + 1, so at the border to
+// a chunk of level l + 1 both have the same nodes and heights and no cracks open between them
+
+// Entry of the level table at the start of the height buffer, see grid_lod.vert
+struct LodLevel {
+	uint32_t offset; //First height of the level
+	uint32_t width;
+	uint32_t height;
+	uint32_t pad;
+};
+
+// Per instance input of grid_lod.vert
+struct LodNode {
+	float x, y;  //Origin in nodes of level 0
+	float level;
+	float range; //Distance the morph to the next level ends at
+};
+
+struct TerrainLod {
+	public:
+		constexpr static size_t CHUNK = 32;        //Quads per chunk side, even so the quarters have whole quads
+		constexpr static size_t MAX_LEVELS = 16;   //Entries of the level table
+		constexpr static float MORPH_START = 0.7f; //Fraction of the range the morph starts at, as in grid_lod.vert
+		constexpr static float RANGE = 4.0f;       //range( 0 ) in chunks of level 0, each level doubles it
+
+		//Pyramid for a x_size * y_size grid of heights, everything counts as changed
+		void resize( size_t x_size, size_t y_size );
+
+		//Level 0, rows are x_size heights. Call update() for the rows written
+		float* base(){ return heights.data(); }
+		//Refilters the levels above and the bounds of the chunks over rows [y0, y1) of level 0
+		void update( size_t y0, size_t y1 );
+
+		//Chunks in the frustum of view_proj, full chunks and the quarters their parents draw for the children out of
+		//range, by quarter. scale maps nodes of level 0 and heights to world space like fill_buffer
+		void select( const glm::mat4& view_proj, const glm::vec3& camera, const glm::vec3& scale );
+
+		//Morph end of chunks of level, the top level is drawn at any distance
+		float range( size_t level ) const;
+
+		//Bytes of the height buffer, the level table with MAX_LEVELS entries then the heights of every level
+		size_t buffer_size() const { return sizeof( LodLevel ) * MAX_LEVELS + heights.size() * sizeof( float ); }
+		//Byte offset in the height buffer of row, counted over the rows of all levels one after another
+		size_t row_offset( size_t row ) const { return sizeof( LodLevel ) * MAX_LEVELS + row_start[row] * sizeof( float ); }
+
+		std::vector<LodLevel> levels;
+		std::vector<float> heights;
+		WaveSimulation::RowChanges changes; //Over the rows of all levels
+
+		std::vector<LodNode> nodes; //After select(), full chunks first then every quarter
+		size_t parts[5]{};          //Nodes of the full chunks and of the quarters
+
+	private:
+		struct Bounds {
+			float lo, hi;
+		};
+
+		bool select_node( size_t x, size_t y, size_t level, std::vector<LodNode> ( &out )[5] );
+		Bounds node_bounds( size_t x, size_t y, size_t level ) const;
+
+		size_t x_s{ 0 };
+		size_t y_s{ 0 };
+		size_t top{ 0 }; //Level of the root chunk
+
+		std::vector<size_t> row_start;            //First height of every row of every level, and the end
+		std::vector<size_t> first_row;            //Of every level in row_start
+		std::vector<std::vector<Bounds>> bounds;  //Per level, heights of level 0 below every chunk
+		std::vector<size_t> bounds_x;             //Chunks per row of every level
+
+		//select() state
+		glm::vec4 planes[6];
+		glm::vec3 eye;
+		glm::vec3 world;
+		float chunk_world{ 0 };
+		std::vector<LodNode> selected[5];
+};
@@ -0,0 +1,99 @@
+#include "UploadArena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void UploadArena::init( VmaAllocator vma_alloc, size_t size, VkBufferUsageFlags buffer_usage, VkDeviceSize align ){
+	allocator = vma_alloc;
+	usage = buffer_usage;
+	alignment = std::max<VkDeviceSize>( align, 16 );
+
+	block = create_block( size );
+	peak = 0;
+}
+
+void UploadArena::destroy(){
+	for( Block& b : spilled )
+		destroy_block( b );
+	spilled.clear();
+
+	destroy_block( block );
+}
+
+bool UploadArena::reset(){
+	const bool overflowed = !spilled.empty();
+
+	for( Block& b : spilled )
+		destroy_block( b );
+	spilled.clear();
+
+	//Half again of what the frame took, so a slowly growing frame does not replace the block every time
+	if( overflowed ){
+		destroy_block( block );
+		block = create_block( peak + peak / 2 );
+	}
+
+	block.used = 0;
+	peak = 0;
+	return overflowed;
+}
+
+UploadArena::Allocation UploadArena::allocate( size_t size ){
+	Block& current = spilled.empty() ? block : spilled.back();
+
+	size_t offset = ( current.used + alignment - 1 ) / alignment * alignment;
+	peak += offset - current.used + size;
+
+	if( offset + size > current.size ){
+		spilled.push_back( create_block( std::max( size, block.size )));
+		offset = 0;
+	}
+
+	Block& target = spilled.empty() ? block : spilled.back();
+	target.used = offset + size;
+
+	return Allocation{ target.buf.buffer, offset, target.data + offset };
+}
+
+UploadArena::Allocation UploadArena::upload( const void* src, size_t size ){
+	Allocation alloc = allocate( size );
+	memcpy( alloc.data, src, size );
+	return alloc;
+}
+
+//No-op on host coherent memory
+void UploadArena::flush(){
+	if( block.used )
+		vmaFlushAllocation( allocator, block.buf.allocation, 0, block.used );
+
+	for( Block& b : spilled )
+		vmaFlushAllocation( allocator, b.buf.allocation, 0, b.used );
+}
+
+UploadArena::Block UploadArena::create_block( size_t size ){
+	VkBufferCreateInfo buf_inf{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.size = std::max<size_t>( size, alignment ),
+		.usage = usage,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_inf{
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+	};
+
+	Block b;
+	VmaAllocationInfo info;
+	VK_CHECK( vmaCreateBuffer( allocator, &buf_inf, &vma_alloc_inf, &b.buf.buffer, &b.buf.allocation, &info ));
+
+	b.data = static_cast<char*>( info.pMappedData );
+	b.size = buf_inf.size;
+	return b;
+}
+
+void UploadArena::destroy_block( Block& b ){
+	if( b.buf.buffer )
+		vmaDestroyBuffer( allocator, b.buf.buffer, b.buf.allocation );
+	b = Block{};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "VkTypes.hpp"
+
+#include <stddef.h>
+#include <vector>
+
+// Linear allocator over a persistently mapped buffer for the data written anew every frame, one per frame in flight.
+// Allocations stay valid until reset(), which is called once the fence of the frame signalled. A frame needing more
+// than the block spills into extra blocks, the next reset() frees them and replaces the block by one with headroom,
+// so the blocks only change at the frame boundary when no command references them anymore
+struct UploadArena {
+	public:
+		struct Allocation {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			void* data;
+		};
+
+		//alignment has to cover the offset alignments of usage, minUniformBufferOffsetAlignment for uniforms
+		void init( VmaAllocator allocator, size_t size, VkBufferUsageFlags usage, VkDeviceSize alignment );
+		void destroy();
+
+		//Frame boundary, true when the blocks changed and descriptors pointing into them have to be written again
+		bool reset();
+
+		Allocation allocate( size_t size );
+		Allocation upload( const void* src, size_t size );
+
+		//Makes the writes of the frame visible to the device, before the submit
+		void flush();
+
+		size_t capacity() const { return block.size; }
+
+	private:
+		struct Block {
+			AllocatedBuffer buf{};
+			char* data{ nullptr };
+			size_t size{ 0 };
+			size_t used{ 0 };
+		};
+
+		Block create_block( size_t size );
+		void destroy_block( Block& block );
+
+		VmaAllocator allocator{};
+		VkBufferUsageFlags usage{ 0 };
+		VkDeviceSize alignment{ 1 };
+
+		Block block;
+		std::vector<Block> spilled; //Of this frame, the last one is allocated from
+		size_t peak{ 0 };           //Bytes this frame allocated, with alignment
+};
@@ -0,0 +1,269 @@
+#include "UploadManager.hpp"
+#include "VkInit.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void UploadManager::init( VkDevice dev, VmaAllocator vma_alloc, VkQueue graphics_queue, uint32_t graphics_family, VkQueue transfer_queue, uint32_t transfer_family ){
+	device = dev;
+	allocator = vma_alloc;
+
+	dedicated = transfer_queue != VK_NULL_HANDLE && transfer_family != graphics_family;
+	queue = dedicated ? transfer_queue : graphics_queue;
+	families[0] = graphics_family;
+	families[1] = dedicated ? transfer_family : graphics_family;
+
+	auto cmd_pool_cr_inf = vkinit::command_pool_create_info( families[1] );
+	VK_CHECK( vkCreateCommandPool( device, &cmd_pool_cr_inf, nullptr, &cmd_pool ));
+
+	VkSemaphoreTypeCreateInfo type_cr_inf{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.pNext = nullptr,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0,
+	};
+
+	auto sem_cr_inf = vkinit::semaphore_create_info();
+	sem_cr_inf.pNext = &type_cr_inf;
+	VK_CHECK( vkCreateSemaphore( device, &sem_cr_inf, nullptr, &timeline ));
+
+	submitted = 0;
+	frame_wait = 0;
+}
+
+void UploadManager::destroy(){
+	wait( submitted + ( recording.cmd ? 1 : 0 ));
+	collect();
+
+	vkDestroyCommandPool( device, cmd_pool, nullptr );
+	vkDestroySemaphore( device, timeline, nullptr );
+}
+
+void UploadManager::share( VkBufferCreateInfo& info ) const {
+	if( !dedicated )
+		return;
+
+	info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	info.queueFamilyIndexCount = 2;
+	info.pQueueFamilyIndices = families;
+}
+
+void UploadManager::share( VkImageCreateInfo& info ) const {
+	if( !dedicated )
+		return;
+
+	info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	info.queueFamilyIndexCount = 2;
+	info.pQueueFamilyIndices = families;
+}
+
+VkCommandBuffer UploadManager::recording_cmd(){
+	if( !recording.cmd ){
+		auto cmd_alloc = vkinit::command_buffer_allocate_info( cmd_pool );
+		VK_CHECK( vkAllocateCommandBuffers( device, &cmd_alloc, &recording.cmd ));
+
+		auto cmd_beg = vkinit::command_buffer_begin_info( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT );
+		VK_CHECK( vkBeginCommandBuffer( recording.cmd, &cmd_beg ));
+
+		recording.ticket = submitted + 1;
+	}
+
+	return recording.cmd;
+}
+
+//Staging buffer of the recording batch holding a copy of src
+VkBuffer UploadManager::stage( const void* src, size_t size ){
+	VkBufferCreateInfo buf_inf{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.size = size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	};
+
+	VmaAllocationCreateInfo vma_alloc_inf{
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_ONLY,
+	};
+
+	AllocatedBuffer staging;
+	VmaAllocationInfo info;
+	VK_CHECK( vmaCreateBuffer( allocator, &buf_inf, &vma_alloc_inf, &staging.buffer, &staging.allocation, &info ));
+
+	memcpy( info.pMappedData, src, size );
+	vmaFlushAllocation( allocator, staging.allocation, 0, size );
+
+	recording.staging.push_back( staging );
+	return staging.buffer;
+}
+
+UploadManager::Ticket UploadManager::copy_buffer( VkBuffer dst, VkDeviceSize offset, const void* src, size_t size ){
+	VkCommandBuffer cmd = recording_cmd();
+
+	VkBuffer staging = stage( src, size );
+
+	VkBufferCopy copy{
+		.srcOffset = 0,
+		.dstOffset = offset,
+		.size = size,
+	};
+
+	vkCmdCopyBuffer( cmd, staging, dst, 1, &copy );
+	return recording.ticket;
+}
+
+//The frame waiting on the timeline makes the copy visible, the barriers only cover the transfer stage the queue has
+UploadManager::Ticket UploadManager::copy_image( VkImage dst, VkExtent3D extent, const void* src, size_t size ){
+	VkCommandBuffer cmd = recording_cmd();
+
+	VkBuffer staging = stage( src, size );
+
+	VkImageSubresourceRange range {
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = 0,
+		.levelCount = 1,
+		.baseArrayLayer = 0,
+		.layerCount = 1,
+	};
+
+	VkImageMemoryBarrier to_transfer {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = dst,
+		.subresourceRange = range,
+	};
+
+	vkCmdPipelineBarrier(
+			cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &to_transfer );
+
+	VkBufferImageCopy img_cpy {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = VkImageSubresourceLayers{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageExtent = extent,
+	};
+
+	vkCmdCopyBufferToImage( cmd, staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &img_cpy );
+
+	VkImageMemoryBarrier to_shader {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = 0,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = dst,
+		.subresourceRange = range,
+	};
+
+	vkCmdPipelineBarrier(
+			cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &to_shader );
+
+	return recording.ticket;
+}
+
+UploadManager::Ticket UploadManager::flush(){
+	if( !recording.cmd )
+		return submitted;
+
+	VK_CHECK( vkEndCommandBuffer( recording.cmd ));
+
+	VkTimelineSemaphoreSubmitInfo timeline_inf{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &recording.ticket,
+	};
+
+	VkSubmitInfo sub_inf{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timeline_inf,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = nullptr,
+		.pWaitDstStageMask = nullptr,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &recording.cmd,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &timeline,
+	};
+
+	VK_CHECK( vkQueueSubmit( queue, 1, &sub_inf, VK_NULL_HANDLE ));
+
+	submitted = recording.ticket;
+	in_flight.push_back( std::move( recording ));
+	recording = Batch{};
+
+	return submitted;
+}
+
+bool UploadManager::done( Ticket ticket ){
+	uint64_t value = 0;
+	VK_CHECK( vkGetSemaphoreCounterValue( device, timeline, &value ));
+	return value >= ticket;
+}
+
+void UploadManager::wait( Ticket ticket ){
+	if( ticket > submitted )
+		flush();
+
+	if( !ticket )
+		return;
+
+	VkSemaphoreWaitInfo wait_inf{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.semaphoreCount = 1,
+		.pSemaphores = &timeline,
+		.pValues = &ticket,
+	};
+
+	VK_CHECK( vkWaitSemaphores( device, &wait_inf, UINT64_MAX ));
+}
+
+void UploadManager::use( Ticket ticket ){
+	if( ticket > submitted )
+		flush();
+
+	frame_wait = std::max( frame_wait, ticket );
+}
+
+uint64_t UploadManager::take_frame_wait(){
+	const uint64_t value = done( frame_wait ) ? 0 : frame_wait;
+	frame_wait = 0;
+	return value;
+}
+
+void UploadManager::collect(){
+	uint64_t value = 0;
+	VK_CHECK( vkGetSemaphoreCounterValue( device, timeline, &value ));
+
+	while( !in_flight.empty() && in_flight.front().ticket <= value ){
+		Batch& batch = in_flight.front();
+
+		for( AllocatedBuffer& staging : batch.staging )
+			vmaDestroyBuffer( allocator, staging.buffer, staging.allocation );
+		vkFreeCommandBuffers( device, cmd_pool, 1, &batch.cmd );
+
+		in_flight.pop_front();
+	}
+}
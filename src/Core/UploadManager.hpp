@@ -0,0 +1,67 @@
+#pragma once
+
+#include "VkTypes.hpp"
+
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Uploads through staging buffers, recorded into one command buffer per batch and submitted on the transfer queue.
+// Every submitted batch signals the next value of a timeline semaphore, the ticket a copy returns. Nothing blocks
+// until a resource is needed: use() has the next frame wait for the ticket on the GPU, wait() blocks the CPU.
+// With a transfer queue family apart from graphics the resources are shared concurrently, see share()
+struct UploadManager {
+	public:
+		using Ticket = uint64_t;
+
+		void init( VkDevice device, VmaAllocator allocator, VkQueue graphics_queue, uint32_t graphics_family, VkQueue transfer_queue, uint32_t transfer_family );
+		void destroy();
+
+		//Sharing over the queue families of the uploads and of the frames, for resources created to be uploaded to
+		void share( VkBufferCreateInfo& info ) const;
+		void share( VkImageCreateInfo& info ) const;
+
+		//Copies size bytes of src, the data can be freed once the call returns
+		Ticket copy_buffer( VkBuffer dst, VkDeviceSize offset, const void* src, size_t size );
+		//Whole mip 0 of a color image, left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		Ticket copy_image( VkImage dst, VkExtent3D extent, const void* src, size_t size );
+
+		//Submits the copies recorded so far, called by use() and wait() when their ticket is still recording
+		Ticket flush();
+
+		bool done( Ticket ticket );
+		void wait( Ticket ticket );
+
+		//The next frame submitted waits for ticket before its vertex input
+		void use( Ticket ticket );
+		//Value of the timeline to wait for in the frame submit, 0 for none. Resets the wait
+		uint64_t take_frame_wait();
+
+		//Frees the staging buffers and command buffers of finished batches, once per frame
+		void collect();
+
+		VkSemaphore timeline{ VK_NULL_HANDLE };
+		bool dedicated{ false }; //Transfer queue family apart from graphics
+
+	private:
+		struct Batch {
+			VkCommandBuffer cmd{ VK_NULL_HANDLE };
+			std::vector<AllocatedBuffer> staging;
+			Ticket ticket{ 0 };
+		};
+
+		VkCommandBuffer recording_cmd();
+		VkBuffer stage( const void* src, size_t size );
+
+		VkDevice device{ VK_NULL_HANDLE };
+		VmaAllocator allocator{};
+		VkQueue queue{ VK_NULL_HANDLE };
+		VkCommandPool cmd_pool{ VK_NULL_HANDLE };
+		uint32_t families[2]{};
+
+		Batch recording;
+		std::deque<Batch> in_flight;
+		Ticket submitted{ 0 };  //Last ticket flushed, the recording batch signals submitted + 1
+		uint64_t frame_wait{ 0 };
+};
@@ -35,16 +35,6 @@
 
 #include "VkBootstrap.h"
 
-#define VK_CHECK( x ) 											\
-	do { 														\
-		VkResult err = x; 										\
-		if( err ){ 												\
-			std::cout << "Vulkan error: " << err << std::endl; 	\
-			throw std::runtime_error( "Vulkan error" ); 		\
-		} 														\
-	}while( 0 )
-
-
 #ifdef NO_FILE_PREFIX
 	#define FILE_PREFIX
 #else
@@ -86,6 +76,9 @@ void VkEngine::init(){
 
 	init_scene();
 
+	//What loading queued starts copying while the first frame is prepared
+	uploads.flush();
+
 	initialized = true;
 }
 
@@ -132,6 +125,8 @@ void VkEngine::draw(){
 	VK_CHECK( vkWaitForFences( vk_device, 1, &get_curr_frame().render_fence, VK_TRUE, 1000000000 ));
 	VK_CHECK( vkResetFences( vk_device, 1, &get_curr_frame().render_fence ));
 
+	begin_frame( get_curr_frame() );
+
 	uint32_t render_img;
 	VK_CHECK( vkAcquireNextImageKHR( vk_device, vk_swapchain, 1000000000, get_curr_frame().present_sema, VK_NULL_HANDLE, &render_img ));
 
@@ -171,14 +166,30 @@ void VkEngine::draw(){
 	vkCmdEndRenderPass( get_curr_frame().main_buf );
 	VK_CHECK( vkEndCommandBuffer( get_curr_frame().main_buf ));
 
-	VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	get_curr_frame().arena.flush();
+
+	//Copies recorded during the frame go out as one batch. The frame waits for the uploads it uses on the GPU,
+	//not at all once they are done
+	uploads.flush();
+	const uint64_t upload_wait = uploads.take_frame_wait();
+
+	VkSemaphore waitSemas[2] = { get_curr_frame().present_sema, uploads.timeline };
+	VkPipelineStageFlags waitStages[2] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+	uint64_t waitValues[2] = { 0, upload_wait };
+
+	VkTimelineSemaphoreSubmitInfo timeline_inf{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreValueCount = 2,
+		.pWaitSemaphoreValues = waitValues,
+	};
 
 	VkSubmitInfo sub_inf {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = nullptr,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &get_curr_frame().present_sema,
-		.pWaitDstStageMask = &waitStages,
+		.pNext = upload_wait ? &timeline_inf : nullptr,
+		.waitSemaphoreCount = upload_wait ? 2u : 1u,
+		.pWaitSemaphores = waitSemas,
+		.pWaitDstStageMask = waitStages,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &get_curr_frame().main_buf,
 		.signalSemaphoreCount = 1,
@@ -237,12 +248,30 @@ void VkEngine::run(){
 						drawU = !drawU;
 					} else if (e.key.keysym.scancode == SDL_SCANCODE_F2) {
 						doUpdate = !doUpdate;
+					} else if( e.key.keysym.scancode == SDL_SCANCODE_F3 ){
+						//Stays on the triangle list when the lod shader failed to load
+						drawHeights = !drawHeights && get_material( "grid_lod" );
+					} else if( replaying ){
+						//Space pauses, left and right seek a second of playback, up and down change the speed
+						const double second = replay.speed * replay.frames_per_second;
+						const size_t frame = replay_frame == SIZE_MAX ? 0 : replay_frame;
+
+						switch( e.key.keysym.scancode ){
+							case SDL_SCANCODE_SPACE: replay.paused = !replay.paused; break;
+							case SDL_SCANCODE_LEFT: replay.seek_frame( frame - std::min<size_t>( frame, second )); break;
+							case SDL_SCANCODE_RIGHT: replay.seek_frame( frame + second ); break;
+							case SDL_SCANCODE_UP: replay.speed = std::min( replay.speed * 2, 64.0 ); break;
+							case SDL_SCANCODE_DOWN: replay.speed = std::max( replay.speed * 0.5, 1.0 / 64 ); break;
+							case SDL_SCANCODE_HOME: replay.seek( replay.start_time()); break;
+							default: break;
+						}
 					}
 				}
 			}
 		}
 
 		// Keys
+		bool scrubbing = false;
 		{
 			const Uint8* state = SDL_GetKeyboardState( nullptr );
 
@@ -270,9 +299,17 @@ void VkEngine::run(){
 
 			cam.rotate_around_origin( rotate );
 			cam.move_anchor( move );
+
+			//Holding left or right steps through the history a frame at a time instead of simulating
+			if( !replaying && state[SDL_SCANCODE_LEFT] != state[SDL_SCANCODE_RIGHT] ){
+				scrub( state[SDL_SCANCODE_LEFT] ? -1 : 1 );
+				scrubbing = true;
+			}
 		}
 
-		if(doUpdate)
+		if( replaying )
+			update_replay( dT );
+		else if(doUpdate && !scrubbing)
 			update( dT );
 
 		draw();
@@ -299,15 +336,23 @@ void VkEngine::init_vk(){
 	SDL_Vulkan_CreateSurface( sdl_window, vk_instance, &vk_surface );
 
 	//Physical Device
+	//Timeline semaphores for the uploads
+	VkPhysicalDeviceVulkan12Features features_12{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.timelineSemaphore = VK_TRUE,
+	};
+
 	vkb::PhysicalDeviceSelector phys_sel{ vkb_inst };
 	vkb::PhysicalDevice vkb_phys_dev = phys_sel
 		.set_minimum_version( 1, 2 )
+		.set_required_features_12( features_12 )
 		.set_surface( vk_surface )
 		.prefer_gpu_device_type()
 		.select()
 		.value();
 
 	vk_phys_dev = vkb_phys_dev.physical_device;
+	vk_phys_props = vkb_phys_dev.properties;
 
 	//Logical Device
 	vkb::DeviceBuilder device_builder{ vkb_phys_dev };
@@ -327,6 +372,16 @@ void VkEngine::init_vk(){
 	};
 
 	vmaCreateAllocator( &alloc_inf, &vma_alloc );
+
+	//Uploads go on a transfer queue family apart from graphics when the device has one
+	auto transfer_queue = vkb_device.get_queue( vkb::QueueType::transfer );
+	auto transfer_family = vkb_device.get_queue_index( vkb::QueueType::transfer );
+
+	uploads.init( vk_device, vma_alloc, vk_graphics_queue, vk_graphics_queue_family,
+		transfer_queue ? transfer_queue.value() : VK_NULL_HANDLE,
+		transfer_family ? transfer_family.value() : vk_graphics_queue_family );
+
+	deletion_queue.emplace_function( [this](){ uploads.destroy(); });
 }
 
 void VkEngine::init_vk_swapchain(){
@@ -399,13 +454,6 @@ void VkEngine::init_vk_cmd(){
 
 		VK_CHECK( vkAllocateCommandBuffers( vk_device, &cmd_alloc_inf, &frames[i].main_buf ));
 	}
-
-	auto up_cmd_pl_inf = vkinit::command_pool_create_info( vk_graphics_queue_family );
-	VK_CHECK( vkCreateCommandPool( vk_device, &up_cmd_pl_inf, nullptr, &upload_context.cmd_pool ));
-
-	deletion_queue.emplace_function( [this](){
-			vkDestroyCommandPool( vk_device, upload_context.cmd_pool, nullptr );
-		});
 }
 
 void VkEngine::init_vk_default_renderpass(){
@@ -494,11 +542,6 @@ void VkEngine::init_vk_sync(){
 	auto fence_cr_inf = vkinit::fence_create_info( 0 );
 	auto sem_cr_inf = vkinit::semaphore_create_info();
 
-	VK_CHECK( vkCreateFence( vk_device, &fence_cr_inf, nullptr, &upload_context.fence ));
-	deletion_queue.emplace_function( [this](){
-			vkDestroyFence( vk_device, upload_context.fence, nullptr );
-		});
-
 	fence_cr_inf.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
 	for( size_t i = 0; i < FRAME_OVERLAP; ++i ){
@@ -580,7 +623,7 @@ void VkEngine::init_vk_pipelines(){
 	PipelineBuilder pipe_builder;
 
 
-	VertexInputDescription vertex_desc{ WaveSimulation::SimpleGrid::get_vk_description() };
+	VertexInputDescription vertex_desc{ GridVertex::get_vk_description() };
 
 	pipe_builder.vertex_in_info = vkinit::vertex_input_state_create_info();
 	pipe_builder.vertex_in_info.vertexAttributeDescriptionCount = vertex_desc.attributes.size();
@@ -620,11 +663,44 @@ void VkEngine::init_vk_pipelines(){
 	triangle_pipeline = pipe_builder.build_pipeline( vk_device, vk_render_pass );
 
 	vkDestroyShaderModule( vk_device, triVert, nullptr );
-	vkDestroyShaderModule( vk_device, triFrag, nullptr );
 
 	deletion_queue.emplace_function( [this, triangle_pipeline](){ vkDestroyPipeline( vk_device, triangle_pipeline, nullptr); });
 
 	create_material( triangle_pipeline, triangle_layout, "default" );
+
+	//Chunks of the level of detail, one LodNode per instance, the shader reads the heights from binding 1
+	VkShaderModule lodVert{};
+
+	if( !vk_load_shader( FILE_PREFIX "shader/grid_lod.vert.spv", &lodVert )){
+		std::cout << "Failed to load grid lod vert shader, drawing the triangle list" << std::endl;
+		drawHeights = false;
+		vkDestroyShaderModule( vk_device, triFrag, nullptr );
+		return;
+	}
+
+	VertexInputDescription lod_desc{ LodVertex::get_vk_description() };
+
+	pipe_builder.vertex_in_info = vkinit::vertex_input_state_create_info();
+	pipe_builder.vertex_in_info.vertexAttributeDescriptionCount = lod_desc.attributes.size();
+	pipe_builder.vertex_in_info.pVertexAttributeDescriptions = lod_desc.attributes.data();
+
+	pipe_builder.vertex_in_info.vertexBindingDescriptionCount = lod_desc.bindings.size();
+	pipe_builder.vertex_in_info.pVertexBindingDescriptions = lod_desc.bindings.data();
+
+	pipe_builder.shader_stages.clear();
+	pipe_builder.shader_stages.push_back(
+			vkinit::shader_stage_create_info( VK_SHADER_STAGE_VERTEX_BIT, lodVert ));
+	pipe_builder.shader_stages.push_back(
+			vkinit::shader_stage_create_info( VK_SHADER_STAGE_FRAGMENT_BIT, triFrag ));
+
+	VkPipeline lod_pipeline = pipe_builder.build_pipeline( vk_device, vk_render_pass );
+
+	vkDestroyShaderModule( vk_device, lodVert, nullptr );
+	vkDestroyShaderModule( vk_device, triFrag, nullptr );
+
+	deletion_queue.emplace_function( [this, lod_pipeline](){ vkDestroyPipeline( vk_device, lod_pipeline, nullptr); });
+
+	create_material( lod_pipeline, triangle_layout, "grid_lod" );
 }
 
 VkPipeline PipelineBuilder::build_pipeline( VkDevice dev, VkRenderPass pass ){
@@ -765,6 +841,32 @@ Mesh* VkEngine::get_mesh( const std::string& name ){
 		return &it->second;
 }
 
+//Frame boundary, the fence of frame signalled so its buffers are free to grow and its arena starts over
+void VkEngine::begin_frame( FrameData& frame ){
+	uploads.collect();
+
+	if( frame.arena.reset() )
+		frame.camera_block = VK_NULL_HANDLE;
+
+	if( drawHeights ){
+		if( !chunk_index_buf.buffer )
+			upload_chunk_indices();
+
+		update_lod();
+
+		if( lod.buffer_size() > frame.height_buf.allocation->GetSize()){
+			vmaDestroyBuffer( vma_alloc, frame.height_buf.buffer, frame.height_buf.allocation );
+			frame.height_buf = create_buffer( lod.buffer_size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT );
+			frame.height_seen = 0;
+			write_height_desc( frame );
+		}
+	} else if( grid.get_buffer_float_amount() * sizeof( float ) > frame.grid_buf.allocation->GetSize()){
+		vmaDestroyBuffer( vma_alloc, frame.grid_buf.buffer, frame.grid_buf.allocation );
+		frame.grid_buf = create_buffer( grid.get_buffer_float_amount() * sizeof( float ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT );
+		frame.grid_seen = 0;
+	}
+}
+
 void VkEngine::draw_objects( VkCommandBuffer cmd, RenderableObject* first, int count ){
 
 	//cam.rotate_around_origin( 0.02 );
@@ -778,10 +880,12 @@ void VkEngine::draw_objects( VkCommandBuffer cmd, RenderableObject* first, int c
 		.view_proj = proj * view,
 	};
 
-	void* data;
-	vmaMapMemory( vma_alloc, get_curr_frame().camera_buf.allocation, &data );
-	memcpy( data, &cam_data, sizeof( GpuCamData ));
-	vmaUnmapMemory( vma_alloc, get_curr_frame().camera_buf.allocation );
+	FrameData& frame = get_curr_frame();
+
+	UploadArena::Allocation cam_alloc = frame.arena.upload( &cam_data, sizeof( GpuCamData ));
+	if( cam_alloc.buffer != frame.camera_block )
+		write_camera_desc( frame, cam_alloc.buffer );
+	frame.camera_offset = cam_alloc.offset;
 
 	/*
 
@@ -795,7 +899,7 @@ void VkEngine::draw_objects( VkCommandBuffer cmd, RenderableObject* first, int c
 			vkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, curr.mat->pipeline );
 			last_mat = curr.mat;
 
-			vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, curr.mat->layout, 0, 1, &get_curr_frame().global_desc, 0, nullptr );
+			vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, curr.mat->layout, 0, 1, &frame.global_desc, 1, &frame.camera_offset );
 
 			if( curr.mat->tex_set ){
 				vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, curr.mat->layout, 1, 1, &curr.mat->tex_set, 0, nullptr );
@@ -820,16 +924,14 @@ void VkEngine::draw_objects( VkCommandBuffer cmd, RenderableObject* first, int c
 	*/
 
 
-	if( grid.get_buffer_float_amount() * sizeof( float ) > get_curr_frame().grid_buf.allocation->GetSize()){
-		std::cout << grid.get_buffer_float_amount() * sizeof( float ) << " mismatches " << get_curr_frame().grid_buf.allocation->GetSize() << std::endl;
-
-		vmaDestroyBuffer( vma_alloc, get_curr_frame().grid_buf.buffer, get_curr_frame().grid_buf.allocation );
-		get_curr_frame().grid_buf = create_buffer( grid.get_buffer_float_amount() * sizeof( float ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU );
+	if( drawHeights ){
+		draw_grid_lod( cmd );
+		return;
 	}
 
 	vkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, get_material( "default" )->pipeline );
 
-	vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, get_material( "default" )->layout, 0, 1, &get_curr_frame().global_desc, 0, nullptr );
+	vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, get_material( "default" )->layout, 0, 1, &frame.global_desc, 1, &frame.camera_offset );
 
 	PushConstants consts{
 		.camera = glm::identity<glm::mat4>(),
@@ -837,16 +939,193 @@ void VkEngine::draw_objects( VkCommandBuffer cmd, RenderableObject* first, int c
 
 	vkCmdPushConstants( cmd, get_material( "default" )->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( PushConstants ), &consts );
 
-	vmaMapMemory( vma_alloc, get_curr_frame().grid_buf.allocation, &data );
-	grid.fill_buffer( reinterpret_cast<float*>( data ), drawU );
-	vmaUnmapMemory( vma_alloc, get_curr_frame().grid_buf.allocation );
+	fill_grid_rows( frame.grid_buf, frame.grid_seen, frame.grid_drawU, grid.y_s - 1, ( grid.x_s - 1 ) * 36,
+		[this]( float* buffer, size_t y0, size_t y1 ){ grid.fill_buffer( buffer, drawU, y0, y1 ); });
 
 	VkDeviceSize off = 0;
-	vkCmdBindVertexBuffers( cmd, 0, 1, &get_curr_frame().grid_buf.buffer, &off );
+	vkCmdBindVertexBuffers( cmd, 0, 1, &frame.grid_buf.buffer, &off );
 
 	vkCmdDraw( cmd, grid.get_buffer_float_amount() / 6, 1, 0, 0 );
 }
 
+//Only the chunks in the frustum are drawn, coarser with distance. Heights are uploaded by row as the pyramid changes
+void VkEngine::draw_grid_lod( VkCommandBuffer cmd ){
+	FrameData& frame = get_curr_frame();
+
+	upload_height_rows( frame );
+	uploads.use( chunk_index_ticket );
+
+	//Same mapping to world space as fill_buffer
+	const glm::vec3 eye = cam.get_position();
+	lod.select( cam.get_proj() * cam.get_view(), eye, glm::vec3( 2.0f / grid.x_s, 0.3f, 2.0f / grid.y_s ));
+
+	if( lod.nodes.empty() )
+		return;
+
+	UploadArena::Allocation nodes = frame.arena.upload( lod.nodes.data(), lod.nodes.size() * sizeof( LodNode ));
+
+	Material* mat = get_material( "grid_lod" );
+
+	vkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mat->pipeline );
+
+	vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mat->layout, 0, 1, &frame.global_desc, 1, &frame.camera_offset );
+
+	//Camera position for the morph and the height scale of fill_buffer
+	PushConstants consts{
+		.data = glm::vec4( eye, 0.3f ),
+		.camera = glm::identity<glm::mat4>(),
+	};
+
+	vkCmdPushConstants( cmd, mat->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( PushConstants ), &consts );
+
+	vkCmdBindVertexBuffers( cmd, 0, 1, &nodes.buffer, &nodes.offset );
+	vkCmdBindIndexBuffer( cmd, chunk_index_buf.buffer, 0, VK_INDEX_TYPE_UINT32 );
+
+	//Full chunks take all indices, the quarters a parent draws for its children one quarter of them
+	constexpr uint32_t quarter = ( TerrainLod::CHUNK / 2 ) * ( TerrainLod::CHUNK / 2 ) * 6;
+
+	uint32_t first = 0;
+	for( uint32_t part = 0; part < 5; ++part ){
+		if( lod.parts[part] )
+			vkCmdDrawIndexed( cmd, part ? quarter : 4 * quarter, lod.parts[part], part ? ( part - 1 ) * quarter : 0, 0, first );
+		first += lod.parts[part];
+	}
+}
+
+//Refilters the pyramid over the rows the grid wrote since the last frame, nothing while it stands still
+void VkEngine::update_lod(){
+	if( lod.levels.empty() || lod.levels[0].width != grid.x_s || lod.levels[0].height != grid.y_s ){
+		lod.resize( grid.x_s, grid.y_s );
+		lod_seen = 0;
+	}
+
+	if( lod_drawU != drawU )
+		lod_seen = 0;
+
+	if( lod_seen == grid.changes.generation )
+		return;
+
+	grid.changes.for_each_range( lod_seen, [this]( size_t y0, size_t y1 ){
+		grid.fill_heights( lod.base(), drawU, y0, y1 );
+		lod.update( y0, y1 );
+	});
+
+	lod_seen = grid.changes.generation;
+	lod_drawU = drawU;
+}
+
+//Rewrites the rows of the pyramid changed since frame last drew, each frame in flight has its own height buffer
+void VkEngine::upload_height_rows( FrameData& frame ){
+	if( frame.height_seen == lod.changes.generation )
+		return;
+
+	char* dst = static_cast<char*>( frame.height_buf.mapped );
+
+	//The level table is small enough to write along every time
+	constexpr size_t table = sizeof( LodLevel ) * TerrainLod::MAX_LEVELS;
+	memset( dst, 0, table );
+	memcpy( dst, lod.levels.data(), lod.levels.size() * sizeof( LodLevel ));
+	vmaFlushAllocation( vma_alloc, frame.height_buf.allocation, 0, table );
+
+	const char* heights = reinterpret_cast<const char*>( lod.heights.data() );
+	lod.changes.for_each_range( frame.height_seen, [&]( size_t r0, size_t r1 ){
+		const size_t begin = lod.row_offset( r0 ), end = lod.row_offset( r1 );
+
+		memcpy( dst + begin, heights + begin - table, end - begin );
+		vmaFlushAllocation( vma_alloc, frame.height_buf.allocation, begin, end - begin );
+	});
+
+	frame.height_seen = lod.changes.generation;
+}
+
+void VkEngine::upload_chunk_indices(){
+	//Both triangles of every quad in the order fill_buffer emits their corners, quarter by quarter
+	constexpr uint32_t side = TerrainLod::CHUNK + 1, half = TerrainLod::CHUNK / 2;
+
+	std::vector<uint32_t> indices;
+	indices.reserve( TerrainLod::CHUNK * TerrainLod::CHUNK * 6 );
+
+	for( uint32_t q = 0; q < 4; ++q ){
+		for( uint32_t y = ( q >> 1 ) * half; y < ( q >> 1 ) * half + half; ++y ){
+			for( uint32_t x = ( q & 1 ) * half; x < ( q & 1 ) * half + half; ++x ){
+				const uint32_t i = x + y * side;
+				const uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side, i + side + 1 };
+				indices.insert( indices.end(), quad, quad + 6 );
+			}
+		}
+	}
+
+	const size_t size = indices.size() * sizeof( uint32_t );
+
+	chunk_index_buf = create_buffer( size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY );
+	chunk_index_ticket = uploads.copy_buffer( chunk_index_buf.buffer, 0, indices.data(), size );
+}
+
+//Rewrites the rows of buf the grid wrote since seen, each frame in flight has its own buffer and generation.
+//Nothing is written while the grid stands still
+void VkEngine::fill_grid_rows( AllocatedBuffer& buf, uint64_t& seen, bool& seen_drawU, size_t rows, size_t row_floats, const std::function<void( float*, size_t, size_t )>& fill ){
+	if( seen_drawU != drawU )
+		seen = 0;
+
+	if( seen == grid.changes.generation )
+		return;
+
+	grid.changes.for_each_range( seen, [&]( size_t y0, size_t y1 ){
+		y1 = std::min( y1, rows );
+		if( y0 >= y1 )
+			return;
+
+		fill( static_cast<float*>( buf.mapped ), y0, y1 );
+		vmaFlushAllocation( vma_alloc, buf.allocation, y0 * row_floats * sizeof( float ), ( y1 - y0 ) * row_floats * sizeof( float ));
+	});
+
+	seen = grid.changes.generation;
+	seen_drawU = drawU;
+}
+
+void VkEngine::write_height_desc( FrameData& frame ){
+	VkDescriptorBufferInfo buf_inf{
+		.buffer = frame.height_buf.buffer,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+
+	VkWriteDescriptorSet set_write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstSet = frame.global_desc,
+		.dstBinding = 1,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = &buf_inf,
+	};
+
+	vkUpdateDescriptorSets( vk_device, 1, &set_write, 0, nullptr );
+}
+
+//Binding 0 covers one GpuCamData, where in the block is the dynamic offset
+void VkEngine::write_camera_desc( FrameData& frame, VkBuffer block ){
+	VkDescriptorBufferInfo buf_inf{
+		.buffer = block,
+		.offset = 0,
+		.range = sizeof( GpuCamData ),
+	};
+
+	VkWriteDescriptorSet set_write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstSet = frame.global_desc,
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.pBufferInfo = &buf_inf,
+	};
+
+	vkUpdateDescriptorSets( vk_device, 1, &set_write, 0, nullptr );
+
+	frame.camera_block = block;
+}
+
 void VkEngine::upload_mesh( Mesh& mesh ){
 	VkBufferCreateInfo buf_cr_inf{
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -911,6 +1190,10 @@ void VkEngine::init_scene(){
 
 	vkUpdateDescriptorSets( vk_device, 1, &tex1_write, 0, nullptr );
 
+	//The first frame waits for the image, every later one is submitted after it
+	tri.mat->tex_ready = textures["outline"].ready;
+	uploads.use( tri.mat->tex_ready );
+
 	for( int y = 0; y < 21; ++y ){
 		for( int x = 0; x < 21; ++x ){
 			tri.transform = glm::translate( glm::vec3{ x - 10.0f, 0, y - 10.0f }) * glm::rotate<float>( 0.5 * M_PI, glm::vec3{ 1.0f, 0.0f, 0.0f });
@@ -926,7 +1209,7 @@ FrameData& VkEngine::get_curr_frame(){
 	return frames[frameNumber % FRAME_OVERLAP];
 }
 
-AllocatedBuffer VkEngine::create_buffer( size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage ){
+AllocatedBuffer VkEngine::create_buffer( size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags flags ){
 	VkBufferCreateInfo buf_inf{
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.pNext = nullptr,
@@ -934,31 +1217,47 @@ AllocatedBuffer VkEngine::create_buffer( size_t size, VkBufferUsageFlags usage,
 		.usage = usage,
 	};
 
+	//Copied to on the transfer queue
+	if( usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT )
+		uploads.share( buf_inf );
+
 	VmaAllocationCreateInfo vma_alloc_inf{
+		.flags = flags,
 		.usage = memory_usage,
 	};
 
 	AllocatedBuffer buf;
+	VmaAllocationInfo info;
 
-	VK_CHECK( vmaCreateBuffer( vma_alloc, &buf_inf, &vma_alloc_inf, &buf.buffer, &buf.allocation, nullptr ));
+	VK_CHECK( vmaCreateBuffer( vma_alloc, &buf_inf, &vma_alloc_inf, &buf.buffer, &buf.allocation, &info ));
 
+	buf.mapped = info.pMappedData;
 	return buf;
 }
 
 void VkEngine::init_descriptors(){
 
-	VkDescriptorSetLayoutBinding binding{
-		.binding = 0,
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		.descriptorCount = 1,
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+	//Camera and the heights of the grid
+	VkDescriptorSetLayoutBinding bindings[2]{
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		},
 	};
 
 	VkDescriptorSetLayoutCreateInfo desc_set_lay_cr_inf{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
 		.pNext = nullptr,
-		.bindingCount = 1,
-		.pBindings = &binding,
+		.bindingCount = 2,
+		.pBindings = bindings,
 	};
 
 	VkDescriptorSetLayoutBinding binding_tex {
@@ -986,6 +1285,8 @@ void VkEngine::init_descriptors(){
 	std::vector<VkDescriptorPoolSize> sizes =
 	{
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
 		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 },
 	};
 
@@ -1004,13 +1305,17 @@ void VkEngine::init_descriptors(){
 
 
 	for( size_t i = 0; i < FRAME_OVERLAP; ++i ){
-		frames[i].camera_buf = create_buffer( sizeof( GpuCamData ), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU );
+		//Camera and the instances of a few thousand chunks fit well below that
+		frames[i].arena.init( vma_alloc, 256 << 10, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			vk_phys_props.limits.minUniformBufferOffsetAlignment );
 
-		frames[i].grid_buf = create_buffer( grid.get_buffer_float_amount() * sizeof( float ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU );
+		frames[i].grid_buf = create_buffer( grid.get_buffer_float_amount() * sizeof( float ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT );
+		frames[i].height_buf = create_buffer( sizeof( LodLevel ) * TerrainLod::MAX_LEVELS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT );
 
 		deletion_queue.emplace_function( [this, i](){
-				vmaDestroyBuffer( vma_alloc, frames[i].camera_buf.buffer, frames[i].camera_buf.allocation );
+				frames[i].arena.destroy();
 				vmaDestroyBuffer( vma_alloc, frames[i].grid_buf.buffer, frames[i].grid_buf.allocation );
+				vmaDestroyBuffer( vma_alloc, frames[i].height_buf.buffer, frames[i].height_buf.allocation );
 			});
 
 		VkDescriptorSetAllocateInfo alloc_inf{
@@ -1023,64 +1328,20 @@ void VkEngine::init_descriptors(){
 
 		vkAllocateDescriptorSets( vk_device, &alloc_inf, &frames[i].global_desc );
 
-		VkDescriptorBufferInfo buf_inf{
-			.buffer = frames[i].camera_buf.buffer,
-			.offset = 0,
-			.range = sizeof( GpuCamData ),
-		};
-
-		VkWriteDescriptorSet set_write{
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.pNext = nullptr,
-			.dstSet = frames[i].global_desc,
-			.dstBinding = 0,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.pBufferInfo = &buf_inf,
-		};
-
-		vkUpdateDescriptorSets( vk_device, 1, &set_write, 0, nullptr );
+		//The camera is written by the first frame into its arena
+		write_height_desc( frames[i] );
 	}
-}
-
-void VkEngine::immediate_submit( std::function<void( VkCommandBuffer )>&& func ){
-	VkCommandBufferAllocateInfo cmd_alloc = vkinit::command_buffer_allocate_info( upload_context.cmd_pool );
-
-	VkCommandBuffer buf;
-	VK_CHECK( vkAllocateCommandBuffers(vk_device, &cmd_alloc, &buf ));
 
-	VkCommandBufferBeginInfo cmd_beg = vkinit::command_buffer_begin_info( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT );
-
-	VK_CHECK( vkBeginCommandBuffer( buf, &cmd_beg ));
-
-	func( buf );
-
-	VK_CHECK( vkEndCommandBuffer( buf ));
-
-	VkSubmitInfo sub_inf{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = nullptr,
-		.waitSemaphoreCount = 0,
-		.pWaitSemaphores = nullptr,
-		.pWaitDstStageMask = nullptr,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &buf,
-		.signalSemaphoreCount = 0,
-		.pSignalSemaphores = nullptr,
-	};
-
-	VK_CHECK( vkQueueSubmit( vk_graphics_queue, 1, &sub_inf, upload_context.fence ));
-
-	vkWaitForFences( vk_device, 1, &upload_context.fence, VK_TRUE, 999999999999 );
-	vkResetFences( vk_device, 1, &upload_context.fence );
-
-	vkResetCommandPool( vk_device, upload_context.cmd_pool, 0 );
+	deletion_queue.emplace_function( [this](){
+			if( chunk_index_buf.buffer )
+				vmaDestroyBuffer( vma_alloc, chunk_index_buf.buffer, chunk_index_buf.allocation );
+		});
 }
 
 void VkEngine::load_images(){
 	Texture outline;
 
-	vkutil::load_image_file( *this, FILE_PREFIX "assets/outline.png", outline.img );
+	vkutil::load_image_file( *this, FILE_PREFIX "assets/outline.png", outline.img, outline.ready );
 
 	auto view_cr = vkinit::image_view_create_info( VK_FORMAT_R8G8B8A8_SRGB, outline.img.image, VK_IMAGE_ASPECT_COLOR_BIT );
 	VK_CHECK( vkCreateImageView( vk_device, &view_cr, nullptr, &outline.view ));
@@ -1093,6 +1354,16 @@ void VkEngine::load_images(){
 
 void VkEngine::load_grid(){
 	grid.init( FILE_PREFIX "assets/riemann3.bmp" );
+	grid.integrator = WaveSimulation::TimeIntegrator::SSPRK3;
+
+	//The grid from the image is shown until the first frame is decoded
+	if( replay_path ){
+		replaying = replay.open( replay_path );
+		if( replaying )
+			std::cout << "Replaying " << replay.reader.frame_amount() << " frames of " << replay_path << std::endl;
+	}
+
+	history.record( grid );
 /*
 	for( size_t y = 0; y < grid.y_s; ++y ){
 		for( size_t x = 0; x < grid.x_s; ++x ){
@@ -1104,11 +1375,35 @@ void VkEngine::load_grid(){
 }
 
 void VkEngine::update( double dT ){
-	constexpr size_t step_amount = 50;
-
-	for( size_t i = 0; i < step_amount; ++i )
-		//grid.step_finite_difference( 0.009 );
-		grid.step_finite_volume( 0.003 );
+	//grid.step_finite_difference( 0.009 );
+	grid.advance( FRAME_TIME );
+	history.record( grid );
 
 	//doUpdate = false;
 }
+
+void VkEngine::scrub( int frames ){
+	const size_t frame = history.frame();
+	const size_t to = frames < 0 ? frame - std::min<size_t>( frame - history.first(), -frames ) : std::min<size_t>( frame + frames, history.last() );
+
+	if( to != frame )
+		history.seek( grid, to, []( WaveSimulation::Riemann2Grid<>& g ){ g.advance( FRAME_TIME ); });
+}
+
+void VkEngine::update_replay( double dT ){
+	replay.advance( dT );
+
+	size_t index;
+	const char* raw = replay.current( index );
+	if( !raw || index == replay_frame )
+		return;
+
+	//fill_buffer() and draw() pick up the new size when the stream was recorded with a region or decimation
+	if( !WaveSimulation::load_snapshot( grid, replay.reader.header, raw )){
+		std::cout << "Snapshot stream is not of a " << WaveSimulation::checkpoint_header( grid ).precision << " Riemann2Grid of order " << grid.order << ", replay stopped" << std::endl;
+		replay.close();
+		replaying = false;
+		return;
+	}
+	replay_frame = index;
+}
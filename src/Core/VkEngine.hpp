@@ -2,8 +2,13 @@
 
 #include "VkTypes.hpp"
 #include "VkMesh.hpp"
+#include "TerrainLod.hpp"
+#include "UploadArena.hpp"
+#include "UploadManager.hpp"
 #include "Camera/StrategyCam.hpp"
 #include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/RewindHistory.hpp"
+#include "WaveSimulation/SnapshotReader.hpp"
 
 #include <vk_mem_alloc.h>
 
@@ -33,6 +38,7 @@ struct DelQueue {
 
 struct Material {
 	VkDescriptorSet tex_set{ VK_NULL_HANDLE };
+	UploadManager::Ticket tex_ready{ 0 }; //Upload of the texture written to tex_set
 	VkPipeline pipeline;
 	VkPipelineLayout layout;
 };
@@ -40,6 +46,7 @@ struct Material {
 struct Texture {
 	AllocatedImage img;
 	VkImageView view;
+	UploadManager::Ticket ready{ 0 }; //Pass to uploads.use() before drawing with it
 };
 
 struct RenderableObject {
@@ -55,9 +62,21 @@ struct FrameData {
 	VkCommandPool cmd_pool;
 	VkCommandBuffer main_buf;
 
-	AllocatedBuffer camera_buf;
+	//Camera and chunk instances, written anew every frame
+	UploadArena arena;
+	VkBuffer camera_block{ VK_NULL_HANDLE }; //Arena block binding 0 of global_desc points into
+	uint32_t camera_offset{ 0 };             //Dynamic offset of the camera in it
+
+	//Persistently mapped, only the rows that changed are written
 	AllocatedBuffer grid_buf;
+	AllocatedBuffer height_buf; //Level table and heights of TerrainLod, binding 1 of global_desc
 	VkDescriptorSet global_desc;
+
+	//Generation of grid.changes the grid buffer was last filled at and the field it holds, 0 refills it
+	uint64_t grid_seen{ 0 };
+	bool grid_drawU{ false };
+	//Generation of lod.changes the height buffer was last filled at
+	uint64_t height_seen{ 0 };
 };
 
 struct GpuCamData {
@@ -66,11 +85,6 @@ struct GpuCamData {
 	glm::mat4 view_proj;
 };
 
-struct UploadContext {
-	VkFence fence;
-	VkCommandPool cmd_pool;
-};
-
 struct VkEngine {
 	public:
 		//General
@@ -102,20 +116,29 @@ struct VkEngine {
 
 		Mesh* get_mesh( const std::string& name );
 
+		void begin_frame( FrameData& frame );
 		void draw_objects( VkCommandBuffer cmd, RenderableObject* first, int count );
+		void draw_grid_lod( VkCommandBuffer cmd );
+		void update_lod();
+		void upload_height_rows( FrameData& frame );
+		void upload_chunk_indices();
+		void write_height_desc( FrameData& frame );
+		void write_camera_desc( FrameData& frame, VkBuffer block );
+		void fill_grid_rows( AllocatedBuffer& buf, uint64_t& seen, bool& seen_drawU, size_t rows, size_t row_floats, const std::function<void( float*, size_t, size_t )>& fill );
 
 	public:
 		//Base Vulkan
 		VkInstance vk_instance;
 		VkDebugUtilsMessengerEXT vk_debug_messenger;
 		VkPhysicalDevice vk_phys_dev;
+		VkPhysicalDeviceProperties vk_phys_props;
 		VkDevice vk_device;
 		VkSurfaceKHR vk_surface;
 
 		DelQueue deletion_queue;
 		VmaAllocator vma_alloc;
 
-		UploadContext upload_context;
+		UploadManager uploads;
 
 		//Swapchain
 		VkSwapchainKHR vk_swapchain;
@@ -145,9 +168,31 @@ struct VkEngine {
 		VkDescriptorPool desc_pool;
 
 		//Simulation
-		WaveSimulation::Riemann2Grid grid;
+		WaveSimulation::Riemann2Grid<> grid;
 		bool drawU = false;
 		bool doUpdate = false;
+		bool drawHeights = true; //Chunked level of detail from the heights, F3 switches to the fill_buffer triangle list
+
+		//Pyramid of the heights, its level 0 is filled from grid up to generation lod_seen of grid.changes
+		TerrainLod lod;
+		uint64_t lod_seen = 0;
+		bool lod_drawU = false;
+
+		//Indices of the CHUNK * CHUNK quads of a chunk by quarter, the same for every chunk
+		AllocatedBuffer chunk_index_buf{};
+		UploadManager::Ticket chunk_index_ticket = 0;
+
+		//Simulated time per frame, what 50 forward euler steps of 0.003 used to cover
+		constexpr static double FRAME_TIME = 0.15;
+
+		//Recent frames the arrow keys step back and forth through
+		WaveSimulation::RewindHistory<WaveSimulation::Riemann2Grid<>> history;
+
+		//Replay, plays a recorded snapshot stream into grid instead of simulating
+		const char* replay_path = nullptr;
+		WaveSimulation::SnapshotPlayer replay;
+		bool replaying = false;
+		size_t replay_frame = SIZE_MAX;
 
 	private:
 		//Init
@@ -172,15 +217,15 @@ struct VkEngine {
 		void load_grid();
 
 		void update( double dT );
+		void update_replay( double dT );
+		void scrub( int frames );
 
 	public:
 		//Vulkan helpers
 		bool vk_load_shader( const char* path, VkShaderModule* shader );
 		void upload_mesh( Mesh& mesh );
 
-		void immediate_submit( std::function<void( VkCommandBuffer )>&& func );
-
-		AllocatedBuffer create_buffer( size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage );
+		AllocatedBuffer create_buffer( size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags flags = 0 );
 };
 
 struct PipelineBuilder {
@@ -1,4 +1,5 @@
 #include "VkMesh.hpp"
+#include "TerrainLod.hpp"
 #include <vulkan/vulkan_core.h>
 
 VertexInputDescription Vertex::get_vk_description(){
@@ -40,3 +41,48 @@ VertexInputDescription Vertex::get_vk_description(){
 
 	return desc;
 }
+
+VertexInputDescription GridVertex::get_vk_description(){
+	VertexInputDescription desc;
+
+	desc.bindings.emplace_back( VkVertexInputBindingDescription{
+			.binding = 0,
+			.stride = sizeof( GridVertex ),
+			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+		});
+
+	desc.attributes.emplace_back( VkVertexInputAttributeDescription{
+			.location = 0,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32B32_SFLOAT,
+			.offset = offsetof( GridVertex, pos ),
+		});
+
+	desc.attributes.emplace_back( VkVertexInputAttributeDescription{
+			.location = 1,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32B32_SFLOAT,
+			.offset = offsetof( GridVertex, normal ),
+		});
+
+	return desc;
+}
+
+VertexInputDescription LodVertex::get_vk_description(){
+	VertexInputDescription desc;
+
+	desc.bindings.emplace_back( VkVertexInputBindingDescription{
+			.binding = 0,
+			.stride = sizeof( LodNode ),
+			.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+		});
+
+	desc.attributes.emplace_back( VkVertexInputAttributeDescription{
+			.location = 0,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32B32A32_SFLOAT,
+			.offset = 0,
+		});
+
+	return desc;
+}
@@ -25,6 +25,19 @@ struct Vertex {
 	static VertexInputDescription get_vk_description();
 };
 
+// Vertex layout written by the grids fill_buffer
+struct GridVertex {
+	glm::vec3 pos;
+	glm::vec3 normal;
+
+	static VertexInputDescription get_vk_description();
+};
+
+// Instance input of grid_lod.vert, one LodNode per chunk
+struct LodVertex {
+	static VertexInputDescription get_vk_description();
+};
+
 struct PushConstants {
 	glm::vec4 data;
 	glm::mat4 camera;
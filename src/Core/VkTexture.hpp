@@ -1,9 +1,11 @@
 #pragma once
 
 #include "Core/VkTypes.hpp"
+#include "Core/UploadManager.hpp"
 
 struct VkEngine;
 
 namespace vkutil {
-	bool load_image_file( VkEngine& engine, const char* path, AllocatedImage& img );
+	//Queues the upload and returns right away, the image is ready once ready passed
+	bool load_image_file( VkEngine& engine, const char* path, AllocatedImage& img, UploadManager::Ticket& ready );
 }
@@ -3,9 +3,22 @@
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 
+#include <iostream>
+#include <stdexcept>
+
+#define VK_CHECK( x ) 											\
+	do { 														\
+		VkResult err = x; 										\
+		if( err ){ 												\
+			std::cout << "Vulkan error: " << err << std::endl; 	\
+			throw std::runtime_error( "Vulkan error" ); 		\
+		} 														\
+	}while( 0 )
+
 struct AllocatedBuffer {
 	VkBuffer buffer;
 	VmaAllocation allocation;
+	void* mapped{ nullptr }; //When created with VMA_ALLOCATION_CREATE_MAPPED_BIT
 };
 
 struct AllocatedImage {
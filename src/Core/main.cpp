@@ -1,8 +1,15 @@
 #include "Core/VkEngine.hpp"
 
+#include <string.h>
+
 int main( int argc, char** argv ){
 	VkEngine e;
 
+	//--replay PATH plays a snapshot stream recorded by wavesim_headless instead of simulating
+	for( int i = 1; i + 1 < argc; ++i )
+		if( !strcmp( argv[i], "--replay" ))
+			e.replay_path = argv[++i];
+
 	e.init();
 	e.run();
 	e.deinit();
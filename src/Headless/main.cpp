@@ -0,0 +1,428 @@
+#include "WaveSimulation/AmrGrid.hpp"
+#include "WaveSimulation/Checkpoint.hpp"
+#include "WaveSimulation/SimpleGrid.hpp"
+#include "WaveSimulation/Simd.hpp"
+#include "WaveSimulation/SnapshotWriter.hpp"
+#include "WaveSimulation/ThreadPool.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string.h>
+
+using namespace WaveSimulation;
+
+struct RunConfig {
+	const char* start_condition{ nullptr };
+	bool simple{ false };
+	bool amr{ false };
+	size_t levels{ 2 };
+	size_t order{ 1 };
+	bool finite_difference{ false };
+	size_t steps{ 1000 };
+	double dt{ 0.003 }; //0 picks the largest stable dt
+	TimeIntegrator integrator{ TimeIntegrator::Euler };
+	TileConfig tiles;
+	size_t depth{ 1 };
+	BoundaryPolicy boundary{ BoundaryPolicy::Reflective };
+	const char* precision{ Fp32::name };
+	bool skip_quiet{ true };
+	TileConfig activity_tiles{ 32, 32 };
+	double quiet_amplitude{ 0 };
+	const char* restart{ nullptr };    //Checkpoint to continue from instead of the start condition
+	const char* checkpoint{ nullptr }; //Checkpoint written after the last step
+	const char* snapshots{ nullptr };  //Snapshot stream written while stepping
+	SnapshotConfig snapshot;
+};
+
+static void print_usage( const char* name ){
+	std::cout << "Usage: " << name << " <start_condition.bmp>|--restart <checkpoint> [options]\n"
+		<< "  --grid simple|riemann|amr  Grid type, amr refines the riemann grid where the waves are (default riemann)\n"
+		<< "  --levels N              Refinement levels of the amr grid, the start condition has one pixel per finest cell (default 2)\n"
+		<< "  --order 1..7            Polynomial order of the riemann grid elements, above 1 steps scalar (default 1)\n"
+		<< "  --method fv|fd          Finite volume or finite difference stepping (default fv)\n"
+		<< "  --steps N               Amount of steps to advance (default 1000)\n"
+		<< "  --dt DT|auto            Timestep, auto uses the largest stable one of ssprk2|ssprk3 (default 0.003)\n"
+		<< "  --integrator I          Riemann grid time integrator euler|ssprk2|ssprk3 (default euler)\n"
+		<< "  --boundary POLICY       reflective|periodic|zero-gradient (default reflective)\n"
+		<< "  --precision P           Storage/compute precision fp64|fp32|fp16|bf16 (default fp32)\n"
+		<< "  --tile WxH              Tile size in cells, 0 spans the whole axis (default 1024x64)\n"
+		<< "  --depth N               Finite volume steps per temporal block, 1 steps the whole grid every step (default 1)\n"
+		<< "  --activity WxH|off      Riemann grid tiles skipped while at rest, off steps every cell (default 32x32)\n"
+		<< "  --quiet-amplitude A     Largest value a tile at rest may hold, 0 keeps the results exact (default 0)\n"
+		<< "  --restart PATH          Continue from a checkpoint, its grid, order, precision, boundary and integrator apply\n"
+		<< "  --checkpoint PATH       Write a checkpoint after the last step\n"
+		<< "  --snapshots PATH        Stream snapshots of the values to PATH while stepping\n"
+		<< "  --snapshot-interval K   Steps between snapshots (default 1)\n"
+		<< "  --snapshot-region X0,Y0,X1,Y1  Cells [X0, X1) x [Y0, Y1) of the snapshots, 0 extends to the edge (default all)\n"
+		<< "  --snapshot-decimation N Keep every N-th cell per axis (default 1)\n"
+		<< "  --snapshot-codec C      raw|lossless|lossy compression of the snapshots (default raw)\n"
+		<< "  --snapshot-tolerance T  Largest absolute error of the lossy codec\n"
+		<< "  --snapshot-wait         Wait for a free buffer instead of dropping snapshots the disk can not keep up with\n"
+		<< "  --threads N             Worker threads including the main thread, 0 uses all (default 0)\n"
+		<< "  --simd LEVEL            Limit the kernels to scalar|sse4.2|avx2|avx512 (default detected)" << std::endl;
+}
+
+static bool parse_args( int argc, char** argv, RunConfig& conf ){
+	for( int i = 1; i < argc; ++i ){
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if( !strcmp( arg, "--grid" ) && val ){
+			conf.simple = !strcmp( val, "simple" );
+			conf.amr = !strcmp( val, "amr" );
+			if( !conf.simple && !conf.amr && strcmp( val, "riemann" ))
+				return false;
+			++i;
+		} else if( !strcmp( arg, "--levels" ) && val ){
+			conf.levels = std::strtoull( val, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--order" ) && val ){
+			conf.order = std::strtoull( val, nullptr, 10 );
+			if( conf.order < 1 || conf.order > 7 )
+				return false;
+			++i;
+		} else if( !strcmp( arg, "--method" ) && val ){
+			conf.finite_difference = !strcmp( val, "fd" );
+			if( !conf.finite_difference && strcmp( val, "fv" ))
+				return false;
+			++i;
+		} else if( !strcmp( arg, "--steps" ) && val ){
+			conf.steps = std::strtoull( val, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--dt" ) && val ){
+			conf.dt = strcmp( val, "auto" ) ? std::strtod( val, nullptr ) : 0;
+			++i;
+		} else if( !strcmp( arg, "--integrator" ) && val ){
+			TimeIntegrator integrator = TimeIntegrator::Euler;
+			while( strcmp( val, time_integrator_name( integrator ))){
+				if( integrator == TimeIntegrator::SSPRK3 )
+					return false;
+				integrator = static_cast<TimeIntegrator>( static_cast<int>( integrator ) + 1 );
+			}
+			conf.integrator = integrator;
+			++i;
+		} else if( !strcmp( arg, "--boundary" ) && val ){
+			if( !strcmp( val, "reflective" ))
+				conf.boundary = BoundaryPolicy::Reflective;
+			else if( !strcmp( val, "periodic" ))
+				conf.boundary = BoundaryPolicy::Periodic;
+			else if( !strcmp( val, "zero-gradient" ))
+				conf.boundary = BoundaryPolicy::ZeroGradient;
+			else
+				return false;
+			++i;
+		} else if( !strcmp( arg, "--precision" ) && val ){
+			conf.precision = val;
+			if( strcmp( val, Fp64::name ) && strcmp( val, Fp32::name ) && strcmp( val, Fp16::name ) && strcmp( val, Bf16::name ))
+				return false;
+			++i;
+		} else if( !strcmp( arg, "--tile" ) && val ){
+			char* end;
+			conf.tiles.x = std::strtoull( val, &end, 10 );
+			if( *end != 'x' )
+				return false;
+			conf.tiles.y = std::strtoull( end + 1, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--activity" ) && val ){
+			conf.skip_quiet = strcmp( val, "off" );
+			if( conf.skip_quiet ){
+				char* end;
+				conf.activity_tiles.x = std::strtoull( val, &end, 10 );
+				if( *end != 'x' )
+					return false;
+				conf.activity_tiles.y = std::strtoull( end + 1, nullptr, 10 );
+			}
+			++i;
+		} else if( !strcmp( arg, "--quiet-amplitude" ) && val ){
+			conf.quiet_amplitude = std::strtod( val, nullptr );
+			++i;
+		} else if( !strcmp( arg, "--depth" ) && val ){
+			conf.depth = std::strtoull( val, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--restart" ) && val ){
+			conf.restart = val;
+			++i;
+		} else if( !strcmp( arg, "--checkpoint" ) && val ){
+			conf.checkpoint = val;
+			++i;
+		} else if( !strcmp( arg, "--snapshots" ) && val ){
+			conf.snapshots = val;
+			++i;
+		} else if( !strcmp( arg, "--snapshot-interval" ) && val ){
+			conf.snapshot.interval = std::strtoull( val, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--snapshot-region" ) && val ){
+			char* end;
+			size_t* bounds[4] = { &conf.snapshot.x0, &conf.snapshot.y0, &conf.snapshot.x1, &conf.snapshot.y1 };
+			for( size_t n = 0; n < 4; ++n ){
+				*bounds[n] = std::strtoull( val, &end, 10 );
+				if( end == val || *end != ( n < 3 ? ',' : '\0' ))
+					return false;
+				val = end + 1;
+			}
+			++i;
+		} else if( !strcmp( arg, "--snapshot-decimation" ) && val ){
+			conf.snapshot.decimation = std::strtoull( val, nullptr, 10 );
+			++i;
+		} else if( !strcmp( arg, "--snapshot-codec" ) && val ){
+			SnapshotCodec codec = SnapshotCodec::Raw;
+			while( strcmp( val, snapshot_codec_name( codec ))){
+				if( codec == SnapshotCodec::Lossy )
+					return false;
+				codec = static_cast<SnapshotCodec>( static_cast<int>( codec ) + 1 );
+			}
+			conf.snapshot.codec = codec;
+			++i;
+		} else if( !strcmp( arg, "--snapshot-tolerance" ) && val ){
+			conf.snapshot.tolerance = std::strtod( val, nullptr );
+			++i;
+		} else if( !strcmp( arg, "--snapshot-wait" )){
+			conf.snapshot.drop_when_full = false;
+		} else if( !strcmp( arg, "--threads" ) && val ){
+			set_thread_amount( std::strtoull( val, nullptr, 10 ));
+			++i;
+		} else if( !strcmp( arg, "--simd" ) && val ){
+			SimdLevel level = SimdLevel::Scalar;
+			while( strcmp( val, simd_level_name( level ))){
+				if( level == SimdLevel::AVX512 )
+					return false;
+				level = static_cast<SimdLevel>( static_cast<int>( level ) + 1 );
+			}
+			set_simd_level( level );
+			++i;
+		} else if( arg[0] != '-' && !conf.start_condition ){
+			conf.start_condition = arg;
+		} else {
+			return false;
+		}
+	}
+
+	return conf.start_condition || conf.restart;
+}
+
+template<typename Grid>
+static int run( Grid& grid, const RunConfig& conf ){
+	CheckpointState state;
+
+	if( conf.restart ){
+		auto start = std::chrono::high_resolution_clock::now();
+		if( !load_checkpoint( grid, conf.restart, &state ))
+			return EXIT_FAILURE;
+		auto end = std::chrono::high_resolution_clock::now();
+
+		std::cout << "restart:      " << conf.restart << " at step " << state.step << ", time " << state.time << ", loaded in "
+			<< std::chrono::duration<double>( end - start ).count() * 1e3 << " ms" << std::endl;
+	} else if( !grid.init( conf.start_condition )){
+		return EXIT_FAILURE;
+	}
+
+	grid.tiles = conf.tiles;
+	grid.boundary = conf.boundary;
+
+	//Only the riemann grid has integrators, main() rejects them for the simple grid
+	constexpr bool integrators = requires { grid.integrator; };
+	double dt = conf.dt;
+	if constexpr( integrators ){
+		grid.integrator = conf.integrator;
+		grid.skip_quiet = conf.skip_quiet;
+		grid.activity_tiles = conf.activity_tiles;
+		grid.quiet_amplitude = conf.quiet_amplitude;
+		dt = dt ? dt : grid.stable_dt();
+	}
+
+	SnapshotWriter snapshots;
+	if( conf.snapshots && !snapshots.open( conf.snapshots, grid, conf.snapshot ))
+		return EXIT_FAILURE;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Temporal blocks never hold a whole grid at a single step, snapshots need the steps one at a time
+	if( conf.depth > 1 && !conf.finite_difference && conf.integrator == TimeIntegrator::Euler && !conf.snapshots ){
+		grid.step_finite_volume_blocked( dt, conf.steps, conf.depth );
+	} else {
+		for( size_t i = 0; i < conf.steps; ++i ){
+			if( conf.finite_difference )
+				grid.step_finite_difference( dt );
+			else if constexpr( integrators )
+				grid.step( dt );
+			else
+				grid.step_finite_volume( dt );
+
+			if( conf.snapshots )
+				snapshots.offer( grid, state.step + i + 1, state.time + dt * ( i + 1 ));
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>( end - start ).count();
+	double cell_updates = static_cast<double>( grid.x_s * grid.y_s ) * conf.steps;
+
+	std::cout << "grid:         " << grid.x_s << "x" << grid.y_s << "\n"
+		<< "tiles:        " << conf.tiles.x << "x" << conf.tiles.y << "\n"
+		<< "threads:      " << thread_pool().thread_amount() << "\n"
+		<< "simd:         " << simd_level_name( active_simd_level() ) << "\n"
+		<< "precision:    " << conf.precision << "\n"
+		<< "integrator:   " << time_integrator_name( conf.integrator ) << "\n"
+		<< "dt:           " << dt << "\n"
+		<< "steps:        " << conf.steps << "\n"
+		<< "time:         " << seconds << " s\n"
+		<< "cell updates: " << cell_updates / seconds << " /s" << std::endl;
+
+	//Tiles stepped over all tiles, the blocked and finite difference steppers step everything
+	if constexpr( integrators )
+		std::cout << "active tiles: " << grid.activity.active_fraction() * 100 << " %" << std::endl;
+
+	if( conf.snapshots ){
+		double capture = snapshots.capture_seconds;
+		start = std::chrono::high_resolution_clock::now();
+		snapshots.close();
+		end = std::chrono::high_resolution_clock::now();
+
+		std::cout << "snapshots:    " << conf.snapshots << ", " << snapshots.frames_written << " written, " << snapshots.frames_dropped << " dropped, "
+			<< snapshots.bytes_written * 1e-6 << " MB through " << ( snapshots.uses_io_uring() ? "io_uring" : "pwrite" ) << "\n"
+			<< "              " << snapshot_codec_name( conf.snapshot.codec ) << ", ratio " << snapshots.raw_bytes / static_cast<double>( snapshots.bytes_written ) << ", "
+			<< snapshots.encode_seconds * 1e3 << " ms encoding\n"
+			<< "              " << capture * 1e3 << " ms in the stepping thread, " << std::chrono::duration<double>( end - start ).count() * 1e3
+			<< " ms draining after the last step" << std::endl;
+
+		if( snapshots.failed )
+			return EXIT_FAILURE;
+	}
+
+	if( conf.checkpoint ){
+		state.time += dt * conf.steps;
+		state.step += conf.steps;
+
+		start = std::chrono::high_resolution_clock::now();
+		if( !save_checkpoint( grid, conf.checkpoint, state ))
+			return EXIT_FAILURE;
+		end = std::chrono::high_resolution_clock::now();
+
+		std::cout << "checkpoint:   " << conf.checkpoint << " at step " << state.step << ", written in "
+			<< std::chrono::duration<double>( end - start ).count() * 1e3 << " ms" << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+template<typename Precision>
+static int run( AmrGrid<Precision>& grid, const RunConfig& conf ){
+	grid.max_level = conf.levels;
+	grid.boundary = conf.boundary;
+	grid.integrator = conf.integrator;
+
+	if( !grid.init( conf.start_condition ))
+		return EXIT_FAILURE;
+
+	double dt = conf.dt ? conf.dt : grid.stable_dt();
+	double cell_updates = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for( size_t i = 0; i < conf.steps; ++i ){
+		cell_updates += grid.cell_amount();
+		grid.step_adaptive( dt );
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>( end - start ).count();
+	size_t finest = grid.x_size( grid.max_level ) * grid.y_size( grid.max_level );
+
+	std::cout << "grid:         amr " << grid.x_size( grid.max_level ) << "x" << grid.y_size( grid.max_level ) << " finest, " << grid.max_level << " levels\n"
+		<< "cells:        " << cell_updates / conf.steps << " average, " << grid.cell_amount() << " at the end, " << finest << " uniform\n"
+		<< "threads:      " << thread_pool().thread_amount() << "\n"
+		<< "simd:         " << simd_level_name( active_simd_level() ) << "\n"
+		<< "precision:    " << conf.precision << "\n"
+		<< "integrator:   " << time_integrator_name( conf.integrator ) << "\n"
+		<< "dt:           " << dt << "\n"
+		<< "steps:        " << conf.steps << "\n"
+		<< "time:         " << seconds << " s\n"
+		<< "cell updates: " << cell_updates / seconds << " /s" << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+template<typename Precision>
+static int run( const RunConfig& conf ){
+	if( conf.simple && ( conf.integrator != TimeIntegrator::Euler || !conf.dt )){
+		std::cout << "The simple grid only steps with forward euler and a fixed dt" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if( !conf.simple && !conf.dt && conf.integrator == TimeIntegrator::Euler ){
+		std::cout << "Forward euler has no stable dt on the riemann grid, --dt auto needs ssprk2 or ssprk3" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if(( conf.simple || conf.amr ) && conf.order != 1 ){
+		std::cout << "Only the riemann grid has elements of higher order" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if( conf.simple ){
+		SimpleGrid<Precision> grid;
+		return run( grid, conf );
+	}
+
+	if( conf.finite_difference ){
+		std::cout << "Finite difference stepping is not implemented for the riemann grid" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if( conf.amr ){
+		if( conf.checkpoint || conf.snapshots ){
+			std::cout << "Checkpoints and snapshots cover the simple and riemann grids" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		AmrGrid<Precision> grid;
+		return run( grid, conf );
+	}
+
+	switch( conf.order ){
+		case 2: { Riemann2Grid<Precision, 2> grid; return run( grid, conf ); }
+		case 3: { Riemann2Grid<Precision, 3> grid; return run( grid, conf ); }
+		case 4: { Riemann2Grid<Precision, 4> grid; return run( grid, conf ); }
+		case 5: { Riemann2Grid<Precision, 5> grid; return run( grid, conf ); }
+		case 6: { Riemann2Grid<Precision, 6> grid; return run( grid, conf ); }
+		case 7: { Riemann2Grid<Precision, 7> grid; return run( grid, conf ); }
+	}
+
+	Riemann2Grid<Precision> grid;
+	return run( grid, conf );
+}
+
+int main( int argc, char** argv ){
+	RunConfig conf;
+
+	if( !parse_args( argc, argv, conf )){
+		print_usage( argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	//The checkpoint decides what is stepped
+	CheckpointHeader header;
+	if( conf.restart ){
+		if( !read_checkpoint_header( conf.restart, header ))
+			return EXIT_FAILURE;
+
+		conf.simple = header.grid == CheckpointGrid::Simple;
+		conf.amr = false;
+		conf.order = header.grid == CheckpointGrid::Simple ? 1 : header.order;
+		conf.precision = header.precision;
+		conf.boundary = static_cast<BoundaryPolicy>( header.boundary );
+		conf.integrator = static_cast<TimeIntegrator>( header.integrator );
+	}
+
+	if( !strcmp( conf.precision, Fp64::name ))
+		return run<Fp64>( conf );
+	if( !strcmp( conf.precision, Fp16::name ))
+		return run<Fp16>( conf );
+	if( !strcmp( conf.precision, Bf16::name ))
+		return run<Bf16>( conf );
+	return run<Fp32>( conf );
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace WaveSimulation {
+	// Which tiles of a grid can change in the next step. A tile is quiet when none of its values exceeds the
+	// quiet amplitude of the grid, and active when it or one of its eight neighbours is not quiet.
+	// A stage reaches one cell further, so with tiles of at least three cells per axis a step of up to three
+	// stages can not carry a wave into a tile with quiet neighbours. The steppers skip such tiles and keep
+	// the values they had at the start of the step in all fields
+	struct ActivityMap {
+		size_t tiles_x{ 0 };
+		size_t tiles_y{ 0 };
+
+		bool valid{ false };  //The flags belong to the running step, the steppers only skip while set
+		bool synced{ false }; //The tiles skipped in the last step still hold the same values in every field
+		int stepper{ -1 };    //Stepper of the last step, synced only holds while the same fields are written
+
+		std::vector<uint8_t> quiet;
+		std::vector<uint8_t> active;
+		std::vector<uint8_t> skipped; //Skipped in the last step
+
+		//Over the run, active tiles of all tiles stepped
+		size_t active_tile_steps{ 0 };
+		size_t tile_steps{ 0 };
+
+		inline void resize( size_t x_tiles, size_t y_tiles ){
+			tiles_x = x_tiles;
+			tiles_y = y_tiles;
+			quiet.assign( tiles_x * tiles_y, 0 );
+			active.assign( tiles_x * tiles_y, 1 );
+			skipped.assign( tiles_x * tiles_y, 0 );
+			valid = false;
+			synced = false;
+		}
+
+		// active from quiet, the neighbours wrap around the domain for periodic boundaries
+		inline void spread( bool periodic ){
+			size_t amount = 0;
+
+			for( size_t y = 0; y < tiles_y; ++y ){
+				for( size_t x = 0; x < tiles_x; ++x ){
+					bool any = false;
+
+					for( ptrdiff_t dy = -1; dy <= 1 && !any; ++dy ){
+						for( ptrdiff_t dx = -1; dx <= 1 && !any; ++dx ){
+							size_t nx = x + dx, ny = y + dy;
+							if( periodic ){
+								nx = ( x + tiles_x + dx ) % tiles_x;
+								ny = ( y + tiles_y + dy ) % tiles_y;
+							} else if( nx >= tiles_x || ny >= tiles_y ){
+								continue;
+							}
+
+							any = !quiet[ny * tiles_x + nx];
+						}
+					}
+
+					active[y * tiles_x + x] = any;
+					amount += any;
+				}
+			}
+
+			active_tile_steps += amount;
+			tile_steps += tiles_x * tiles_y;
+			valid = true;
+		}
+
+		// After the step, the skipped tiles agree in every field now
+		inline void finish(){
+			for( size_t i = 0; i < active.size(); ++i )
+				skipped[i] = valid && !active[i];
+
+			synced = valid;
+			valid = false;
+		}
+
+		// Counts a step without tracking, every tile was stepped
+		inline void count_all( size_t tiles ){
+			active_tile_steps += tiles;
+			tile_steps += tiles;
+		}
+
+		inline double active_fraction() const {
+			return tile_steps ? static_cast<double>( active_tile_steps ) / tile_steps : 1.0;
+		}
+	};
+}
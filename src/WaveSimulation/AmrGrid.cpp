@@ -0,0 +1,529 @@
+#include "AmrGrid.hpp"
+#include "ThreadPool.hpp"
+
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+using namespace WaveSimulation;
+
+static constexpr Direction directions[4] = { Direction::XNeg, Direction::XPos, Direction::YNeg, Direction::YPos };
+
+struct Offset {
+	ptrdiff_t x, y;
+};
+
+static Offset offset(Direction d) {
+	switch (d) {
+		case Direction::XNeg: return { -1, 0 };
+		case Direction::XPos: return { 1, 0 };
+		case Direction::YNeg: return { 0, -1 };
+		case Direction::YPos: return { 0, 1 };
+	}
+	return { 0, 0 };
+}
+
+static Direction opposite(Direction d) {
+	switch (d) {
+		case Direction::XNeg: return Direction::XPos;
+		case Direction::XPos: return Direction::XNeg;
+		case Direction::YNeg: return Direction::YPos;
+		case Direction::YPos: return Direction::YNeg;
+	}
+	return d;
+}
+
+//Coordinate along one axis of the element k of the edge of a block of size n facing offset o, o = 0 runs along the edge
+static ptrdiff_t edge(ptrdiff_t o, size_t n, size_t k) {
+	return o < 0 ? 0 : o > 0 ? n - 1 : k;
+}
+
+template<typename Grid>
+static typename Grid::Cell load(const typename Grid::Field& field, size_t x, size_t y) {
+	return Grid::load(field, field.index(x, y));
+}
+
+template<typename Precision>
+bool AmrGrid<Precision>::init(const char* start_condition) {
+	int width, height, channels;
+
+	stbi_uc* data = stbi_load(start_condition, &width, &height, &channels, STBI_grey);
+
+	if (!data) {
+		std::cout << "Failed to load texture " << start_condition << " because of: " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+
+	const size_t root_pixels = block_size << max_level;
+
+	if (static_cast<size_t>(width) < root_pixels || static_cast<size_t>(height) < root_pixels) {
+		std::cout << "Start condition " << start_condition << " is smaller than one block of level 0 (" << root_pixels << " pixels)" << std::endl;
+		stbi_image_free(data);
+		return false;
+	}
+
+	resize(width / root_pixels, height / root_pixels);
+
+	const double gauss_legendre[2] = { -0.5 / std::sqrt(3.0) + 0.5, 0.5 / std::sqrt(3.0) + 0.5 };
+
+	//Every node takes the pixel it lies in
+	auto image = [&](size_t level, size_t x, size_t y) {
+		const double pixels = static_cast<double>(size_t(1) << (max_level - level));
+
+		Cell cell{ typename Grid::vec4(0), typename Grid::vec4(0), typename Grid::vec4(0) };
+		for (size_t j = 0; j < 2; ++j) {
+			for (size_t i = 0; i < 2; ++i) {
+				size_t px = static_cast<size_t>((x + gauss_legendre[i]) * pixels);
+				size_t py = static_cast<size_t>((y + gauss_legendre[j]) * pixels);
+				cell.p[i + 2 * j] = data[py * width + px] / 255.0f;
+			}
+		}
+		return cell;
+	};
+
+	for (size_t level = 0; level < max_level; ++level) {
+		fill(image);
+		regrid();
+	}
+	fill(image);
+
+	stbi_image_free(data);
+
+	return true;
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::resize(size_t x_blocks, size_t y_blocks) {
+	root_x = x_blocks;
+	root_y = y_blocks;
+
+	blocks.clear();
+	free_blocks.clear();
+	lookup.clear();
+
+	for (size_t y = 0; y < root_y; ++y)
+		for (size_t x = 0; x < root_x; ++x)
+			add_block(0, x, y, none);
+
+	update_leaves();
+	steps_since_regrid = 0;
+}
+
+template<typename Precision>
+size_t AmrGrid<Precision>::find(size_t level, size_t x, size_t y) const {
+	auto it = lookup.find(key(level, x, y));
+	return it == lookup.end() ? none : it->second;
+}
+
+template<typename Precision>
+bool AmrGrid<Precision>::wrap(size_t x_size, size_t y_size, ptrdiff_t& x, ptrdiff_t& y) const {
+	const ptrdiff_t w = x_size, h = y_size;
+
+	if (x >= 0 && x < w && y >= 0 && y < h)
+		return true;
+
+	if (boundary != BoundaryPolicy::Periodic)
+		return false;
+
+	x = (x % w + w) % w;
+	y = (y % h + h) % h;
+	return true;
+}
+
+template<typename Precision>
+size_t AmrGrid<Precision>::neighbour(size_t b, Direction d) const {
+	const Block& block = blocks[b];
+	const Offset o = offset(d);
+
+	ptrdiff_t x = block.x + o.x;
+	ptrdiff_t y = block.y + o.y;
+	if (!wrap(root_x << block.level, root_y << block.level, x, y))
+		return none;
+
+	//Level 0 covers the whole domain
+	for (size_t level = block.level;; --level, x /= 2, y /= 2) {
+		size_t n = find(level, x, y);
+		if (n != none)
+			return n;
+	}
+}
+
+template<typename Precision>
+auto AmrGrid<Precision>::sample(size_t level, size_t x, size_t y) const -> Cell {
+	return sample(&Grid::values, level, x, y);
+}
+
+template<typename Precision>
+auto AmrGrid<Precision>::sample(FieldMember field, size_t level, size_t x, size_t y) const -> Cell {
+	size_t b = find(level, x / block_size, y / block_size);
+
+	if (b == none)
+		return Grid::refine_cell(sample(field, level - 1, x / 2, y / 2), x & 1, y & 1);
+
+	if (blocks[b].leaf())
+		return load<Grid>(blocks[b].grid.*field, x % block_size, y % block_size);
+
+	Cell fine[2][2];
+	for (size_t j = 0; j < 2; ++j)
+		for (size_t i = 0; i < 2; ++i)
+			fine[j][i] = sample(field, level + 1, 2 * x + i, 2 * y + j);
+
+	return Grid::coarsen_cell(fine);
+}
+
+template<typename Precision>
+size_t AmrGrid<Precision>::add_block(size_t level, size_t x, size_t y, size_t parent) {
+	size_t b = blocks.size();
+	if (free_blocks.empty()) {
+		blocks.emplace_back();
+	} else {
+		b = free_blocks.back();
+		free_blocks.pop_back();
+	}
+
+	Block& block = blocks[b];
+	block.level = level;
+	block.x = x;
+	block.y = y;
+	block.parent = parent;
+	std::fill(std::begin(block.children), std::end(block.children), none);
+	block.used = true;
+	setup_grid(block);
+
+	lookup[key(level, x, y)] = b;
+	return b;
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::setup_grid(Block& block) {
+	block.grid.resize(block_size, block_size);
+	//The blocks run in parallel, each one is a single tile
+	block.grid.tiles = TileConfig{ 0, 0 };
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::refine(size_t b) {
+	if (!blocks[b].leaf() || blocks[b].level >= max_level)
+		return;
+
+	//Coarser neighbours come to this level first, so the children have no neighbour two levels coarser
+	for (Direction d: directions)
+		for (size_t n = neighbour(b, d); n != none && blocks[n].level < blocks[b].level; n = neighbour(b, d))
+			refine(n);
+
+	const size_t half = block_size / 2;
+
+	for (size_t q = 0; q < 4; ++q) {
+		size_t c = add_block(blocks[b].level + 1, 2 * blocks[b].x + (q & 1), 2 * blocks[b].y + (q >> 1), b);
+		blocks[b].children[q] = c;
+
+		const Grid& parent = blocks[b].grid;
+		Grid& child = blocks[c].grid;
+
+		for (size_t y = 0; y < block_size; ++y)
+			for (size_t x = 0; x < block_size; ++x)
+				child.set(x, y, Grid::refine_cell(parent.get((q & 1) * half + x / 2, (q >> 1) * half + y / 2), x & 1, y & 1));
+	}
+
+	blocks[b].grid = Grid();
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::coarsen(size_t b) {
+	Block& parent = blocks[b];
+	setup_grid(parent);
+
+	const size_t half = block_size / 2;
+
+	for (size_t y = 0; y < block_size; ++y) {
+		for (size_t x = 0; x < block_size; ++x) {
+			const Grid& child = blocks[parent.children[x / half + 2 * (y / half)]].grid;
+
+			Cell fine[2][2];
+			for (size_t j = 0; j < 2; ++j)
+				for (size_t i = 0; i < 2; ++i)
+					fine[j][i] = child.get(2 * (x % half) + i, 2 * (y % half) + j);
+
+			parent.grid.set(x, y, Grid::coarsen_cell(fine));
+		}
+	}
+
+	for (size_t& c: parent.children) {
+		Block& child = blocks[c];
+		lookup.erase(key(child.level, child.x, child.y));
+		child.used = false;
+		child.grid = Grid();
+		free_blocks.push_back(c);
+		c = none;
+	}
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::update_leaves() {
+	leaves.clear();
+	for (size_t b = 0; b < blocks.size(); ++b)
+		if (blocks[b].used && blocks[b].leaf())
+			leaves.push_back(b);
+}
+
+template<typename Precision>
+double AmrGrid<Precision>::indicator(size_t b) const {
+	const Grid& grid = blocks[b].grid;
+
+	auto spread = [](const typename Grid::vec4& v) {
+		return std::max({ v.x, v.y, v.z, v.w }) - std::min({ v.x, v.y, v.z, v.w });
+	};
+
+	auto jump = [](const typename Grid::vec3& a, const typename Grid::vec3& b) {
+		return std::max({ std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+	};
+
+	T res = 0;
+	for (size_t y = 0; y < block_size; ++y) {
+		for (size_t x = 0; x < block_size; ++x) {
+			const Cell cell = grid.get(x, y);
+
+			res = std::max({ res, spread(cell.p), spread(cell.ux), spread(cell.uy),
+				jump(Grid::face_trace(cell, Direction::XPos), Grid::face_trace(grid.get(x + 1, y), Direction::XNeg)),
+				jump(Grid::face_trace(cell, Direction::YPos), Grid::face_trace(grid.get(x, y + 1), Direction::YNeg)) });
+		}
+	}
+
+	return res;
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::regrid() {
+	thread_pool().parallel_for(leaves.size(), [&](size_t i) {
+		fill_ghosts(leaves[i], &Grid::values);
+	});
+
+	std::vector<double> steepness(blocks.size(), 0);
+	thread_pool().parallel_for(leaves.size(), [&](size_t i) {
+		steepness[leaves[i]] = indicator(leaves[i]);
+	});
+
+	//A steep leaf refines its coarser and same level neighbours too, so the front stays on the finest level
+	//until the next regrid. Leaves that are steep or next to one are kept
+	std::vector<char> refine_flag(blocks.size(), 0), keep(blocks.size(), 0), old_leaf(blocks.size(), 0);
+	for (size_t b: leaves) {
+		old_leaf[b] = 1;
+		keep[b] |= steepness[b] >= coarsen_threshold;
+
+		if (steepness[b] <= refine_threshold)
+			continue;
+
+		refine_flag[b] = 1;
+		for (Direction d: directions) {
+			size_t n = neighbour(b, d);
+			if (n != none && blocks[n].leaf() && blocks[n].level <= blocks[b].level)
+				refine_flag[n] = keep[n] = 1;
+		}
+	}
+
+	const std::vector<size_t> old_leaves = leaves;
+
+	for (size_t b: old_leaves)
+		if (refine_flag[b])
+			refine(b);
+
+	for (size_t b: old_leaves) {
+		if (!blocks[b].used || blocks[b].parent == none)
+			continue;
+
+		const size_t p = blocks[b].parent;
+		bool coarsen_parent = true;
+
+		for (size_t c: blocks[p].children) {
+			coarsen_parent &= c < old_leaf.size() && old_leaf[c] && blocks[c].leaf() && !keep[c];
+
+			//A finer neighbour would end up two levels finer than the parent
+			for (Direction d: directions) {
+				size_t n = coarsen_parent ? neighbour(c, d) : none;
+				coarsen_parent &= n == none || blocks[n].leaf();
+			}
+		}
+
+		if (coarsen_parent)
+			coarsen(p);
+	}
+
+	update_leaves();
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::fill_ghosts(size_t b, FieldMember member) {
+	Block& block = blocks[b];
+	Field& field = block.grid.*member;
+	const size_t n = block_size;
+
+	for (Direction d: directions) {
+		const Offset o = offset(d);
+		const Axis axis = o.x ? Axis::X : Axis::Y;
+		const size_t nb = neighbour(b, d);
+
+		for (size_t k = 0; k < n; ++k) {
+			//Ghost and the interior element it lies behind
+			const size_t src_x = edge(o.x, n, k), src_y = edge(o.y, n, k);
+			const size_t x = src_x + o.x, y = src_y + o.y;
+
+			if (nb == none) {
+				Grid::ghost_cell(field, boundary, x, y, src_x, src_y, axis);
+				continue;
+			}
+
+			//Same level leaf, the element on its opposite edge
+			if (blocks[nb].level == block.level && blocks[nb].leaf()) {
+				const size_t nx = o.x ? edge(-o.x, n, k) : k, ny = o.y ? edge(-o.y, n, k) : k;
+				Grid::store(field, field.index(x, y), load<Grid>(blocks[nb].grid.*member, nx, ny));
+				continue;
+			}
+
+			ptrdiff_t ex = static_cast<ptrdiff_t>(block.x * n) + static_cast<ptrdiff_t>(x);
+			ptrdiff_t ey = static_cast<ptrdiff_t>(block.y * n) + static_cast<ptrdiff_t>(y);
+			wrap(x_size(block.level), y_size(block.level), ex, ey);
+
+			Grid::store(field, field.index(x, y), sample(member, block.level, ex, ey));
+		}
+	}
+}
+
+//The coarse element takes the mean flux through the fine faces next to it. Both sides evaluate the same
+//solver.flux on the same traces, the fine elements against their ghosts refined from this element
+template<typename Precision>
+void AmrGrid<Precision>::correct_fluxes(size_t b, FieldMember in, FieldMember out, double dt) {
+	Block& block = blocks[b];
+	Grid& grid = block.grid;
+	const size_t n = block_size;
+
+	for (Direction d: directions) {
+		const size_t nb = neighbour(b, d);
+		if (nb == none || blocks[nb].level != block.level || blocks[nb].leaf())
+			continue;
+
+		const Offset o = offset(d);
+		const Direction back = opposite(d);
+		const glm::vec2 normal(o.x, o.y);
+
+		for (size_t k = 0; k < n; ++k) {
+			const size_t x = edge(o.x, n, k), y = edge(o.y, n, k);
+
+			const Cell coarse = load<Grid>(grid.*in, x, y);
+			const Cell ghost = load<Grid>(grid.*in, x + o.x, y + o.y);
+			const typename Grid::vec3 own = grid.solver.flux(Grid::face_trace(coarse, d), Grid::face_trace(ghost, back), normal);
+
+			typename Grid::vec3 fine_flux(0);
+			for (size_t j = 0; j < 2; ++j) {
+				//Elements of level + 1 behind the face
+				ptrdiff_t fx = o.x ? 2 * (static_cast<ptrdiff_t>(block.x * n + x) + o.x) + (o.x < 0) : 2 * (block.x * n + x) + j;
+				ptrdiff_t fy = o.y ? 2 * (static_cast<ptrdiff_t>(block.y * n + y) + o.y) + (o.y < 0) : 2 * (block.y * n + y) + j;
+				wrap(x_size(block.level + 1), y_size(block.level + 1), fx, fy);
+
+				const Grid& fine_grid = blocks[find(block.level + 1, fx / n, fy / n)].grid;
+				const size_t lx = fx % n, ly = fy % n;
+
+				const Cell fine = load<Grid>(fine_grid.*in, lx, ly);
+				const Cell fine_ghost = load<Grid>(fine_grid.*in, lx - o.x, ly - o.y);
+				fine_flux += grid.solver.flux(Grid::face_trace(fine_ghost, d), Grid::face_trace(fine, back), normal);
+			}
+
+			grid.add_face_flux(grid.*out, x, y, d, fine_flux * T(0.5) - own, dt);
+		}
+	}
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::stage(FieldMember in, FieldMember out, double dt, FieldMember base, T a, T b) {
+	thread_pool().parallel_for(leaves.size(), [&](size_t i) {
+		fill_ghosts(leaves[i], in);
+	});
+
+	thread_pool().parallel_for(leaves.size(), [&](size_t i) {
+		Grid& grid = blocks[leaves[i]].grid;
+		grid.finite_volume_stage(grid.*in, grid.*out, dt, typename Grid::Stage{ base ? &(grid.*base) : nullptr, a, b });
+	});
+
+	thread_pool().parallel_for(leaves.size(), [&](size_t i) {
+		correct_fluxes(leaves[i], in, out, dt * b);
+	});
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::step(double dt) {
+	for (size_t b: leaves) {
+		Grid& grid = blocks[b].grid;
+
+		grid.K0 = K0;
+		grid.onebyrho0 = onebyrho0;
+		grid.cell_size = cell_size / static_cast<double>(size_t(1) << blocks[b].level);
+		grid.boundary = boundary;
+		grid.solver.update(K0, onebyrho0);
+	}
+
+	switch (integrator) {
+		case TimeIntegrator::Euler:
+			stage(&Grid::values, &Grid::nval, dt);
+			for (size_t b: leaves)
+				std::swap(blocks[b].grid.values, blocks[b].grid.nval);
+			break;
+
+		case TimeIntegrator::SSPRK2:
+			stage(&Grid::values, &Grid::nval, dt);
+			stage(&Grid::nval, &Grid::values, dt, &Grid::values, T(0.5), T(0.5));
+			break;
+
+		case TimeIntegrator::SSPRK3: {
+			constexpr LowStorageStage s0 = ssprk3_stage(0), s1 = ssprk3_stage(1), s2 = ssprk3_stage(2);
+
+			stage(&Grid::values, &Grid::nval, s0.dt_scale * dt);
+			stage(&Grid::nval, &Grid::values, s1.dt_scale * dt, &Grid::values, T(s1.a), T(s1.b));
+			stage(&Grid::values, &Grid::nval, s2.dt_scale * dt, &Grid::nval, T(s2.a), T(s2.b));
+			for (size_t b: leaves)
+				std::swap(blocks[b].grid.values, blocks[b].grid.nval);
+			break;
+		}
+	}
+}
+
+template<typename Precision>
+double AmrGrid<Precision>::stable_dt() const {
+	Grid finest;
+	finest.K0 = K0;
+	finest.onebyrho0 = onebyrho0;
+	finest.cell_size = cell_size / static_cast<double>(size_t(1) << max_level);
+	finest.integrator = integrator;
+	finest.cfl = cfl;
+
+	return finest.stable_dt();
+}
+
+template<typename Precision>
+void AmrGrid<Precision>::step_adaptive(double dt) {
+	step(dt);
+
+	if (++steps_since_regrid >= regrid_interval) {
+		regrid();
+		steps_since_regrid = 0;
+	}
+}
+
+template<typename Precision>
+size_t AmrGrid<Precision>::advance(double time) {
+	double max_dt = stable_dt();
+	if (max_dt <= 0)
+		return 0;
+
+	size_t steps = static_cast<size_t>(std::ceil(time / max_dt));
+
+	for (size_t i = 0; i < steps; ++i)
+		step_adaptive(time / steps);
+
+	return steps;
+}
+
+template struct WaveSimulation::AmrGrid<Fp64>;
+template struct WaveSimulation::AmrGrid<Fp32>;
+template struct WaveSimulation::AmrGrid<Fp16>;
+template struct WaveSimulation::AmrGrid<Bf16>;
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "SimpleGrid.hpp"
+
+namespace WaveSimulation {
+	// Block-structured adaptive mesh refinement of Riemann2Grid, a quadtree of blocks.
+	// The domain is root_x * root_y blocks of block_size * block_size elements on level 0, refining a block
+	// replaces it by four blocks of as many elements at half the element width, down to max_level.
+	// Every leaf is a Riemann2Grid of its own. Its ghosts are taken from the neighbouring leaves: copied on
+	// the same level, refine_cell of a coarser leaf or coarsen_cell of the finer ones. Neighbouring leaves
+	// differ by at most one level.
+	// All leaves step with the same dt. After every stage the coarse element at a coarse-fine face gets the
+	// mean of the fluxes through the two fine faces instead of its own, so the fluxes on both sides agree
+	template<typename Precision = Fp32>
+	struct AmrGrid {
+		using Grid = Riemann2Grid<Precision>;
+		using T = typename Grid::T;
+		using Cell = typename Grid::Cell;
+		using Field = typename Grid::Field;
+		using FieldMember = Field Grid::*;
+
+		static constexpr size_t none = SIZE_MAX;
+
+		struct Block {
+			size_t level;
+			size_t x, y;                 //Position in blocks of its level
+			size_t parent{ none };
+			size_t children[4]{ none, none, none, none }; //(x0, y0), (x1, y0), (x0, y1), (x1, y1)
+			bool used{ true };
+			Grid grid;                   //Only allocated for leaves
+
+			inline bool leaf() const {
+				return children[0] == none;
+			}
+		};
+
+		//One pixel of start_condition per element of max_level, refined where the image has steep gradients
+		bool init(const char* start_condition = nullptr);
+		//root_x * root_y zeroed blocks of level 0
+		void resize(size_t root_x, size_t root_y);
+		//Sets every element of every leaf to func(level, x, y), x and y in elements of level
+		template<typename Func>
+		void fill(Func&& func);
+
+		//One step of integrator on all leaves
+		void step(double dt);
+		//stable_dt() of elements on max_level, so the step stays valid whatever regrid() does. 0 for forward Euler
+		double stable_dt() const;
+		//step() and regrid() every regrid_interval steps
+		void step_adaptive(double dt);
+		//Advances by time in the fewest steps of at most stable_dt() with step_adaptive(), none without a stable dt
+		size_t advance(double time);
+
+		//Refines the leaves with an element above refine_threshold and their neighbours, coarsens four
+		//leaves back when all their elements are below coarsen_threshold
+		void regrid();
+
+		size_t leaf_amount() const { return leaves.size(); }
+		size_t cell_amount() const { return leaves.size() * block_size * block_size; }
+		//Domain size in elements of level
+		size_t x_size(size_t level) const { return root_x * block_size << level; }
+		size_t y_size(size_t level) const { return root_y * block_size << level; }
+
+		//Element (x, y) of level taken from the leaf covering it
+		Cell sample(size_t level, size_t x, size_t y) const;
+
+		size_t block_size{ 16 }; //Has to be even, applies at the next resize()
+		size_t max_level{ 2 };
+		size_t root_x{ 0 };
+		size_t root_y{ 0 };
+
+		double K0{ 1 };
+		double onebyrho0{ 1 };
+		double cell_size{ 1 }; //Element width on level 0
+
+		TimeIntegrator integrator{ TimeIntegrator::SSPRK3 };
+		double cfl{ 0.9 };
+		BoundaryPolicy boundary{ BoundaryPolicy::Reflective };
+
+		//Largest difference of a variable within an element or across its faces, see regrid()
+		double refine_threshold{ 0.01 };
+		double coarsen_threshold{ 0.0025 };
+		size_t regrid_interval{ 8 };
+		size_t steps_since_regrid{ 0 };
+
+		std::vector<Block> blocks;
+		std::vector<size_t> leaves;
+		std::vector<size_t> free_blocks;
+		std::unordered_map<uint64_t, size_t> lookup; //key(level, x, y) to every used block
+
+		static inline uint64_t key(size_t level, size_t x, size_t y) {
+			return static_cast<uint64_t>(level) << 56 | static_cast<uint64_t>(x) << 28 | y;
+		}
+
+		//The used block (level, x, y), none if that part of the tree is not refined that far
+		size_t find(size_t level, size_t x, size_t y) const;
+		//Wraps (x, y) into a domain of x_size * y_size, false if it lies outside and the domain is not periodic
+		bool wrap(size_t x_size, size_t y_size, ptrdiff_t& x, ptrdiff_t& y) const;
+		//The leaf or same level block next to block b in direction d, none behind the domain boundary
+		size_t neighbour(size_t b, Direction d) const;
+		Cell sample(FieldMember field, size_t level, size_t x, size_t y) const;
+
+		size_t add_block(size_t level, size_t x, size_t y, size_t parent);
+		void setup_grid(Block& block);
+		void refine(size_t b);
+		void coarsen(size_t b);
+		void update_leaves();
+		//Largest difference of the leaf, the ghosts of values have to be filled
+		double indicator(size_t b) const;
+
+		void fill_ghosts(size_t b, FieldMember field);
+		void correct_fluxes(size_t b, FieldMember in, FieldMember out, double dt);
+		//Stage of all leaves, out = a * base + b * (in + dt * L(in)) like Riemann2Grid::Stage, without base for a = 0
+		void stage(FieldMember in, FieldMember out, double dt, FieldMember base = nullptr, T a = 0, T b = 1);
+	};
+
+	template<typename Precision>
+	template<typename Func>
+	void AmrGrid<Precision>::fill(Func&& func) {
+		for (size_t b: leaves) {
+			Block& block = blocks[b];
+
+			for (size_t y = 0; y < block_size; ++y)
+				for (size_t x = 0; x < block_size; ++x)
+					block.grid.set(x, y, func(block.level, block.x * block_size + x, block.y * block_size + y));
+		}
+	}
+
+	//Instantiated for every policy in AmrGrid.cpp
+	extern template struct AmrGrid<Fp64>;
+	extern template struct AmrGrid<Fp32>;
+	extern template struct AmrGrid<Fp16>;
+	extern template struct AmrGrid<Bf16>;
+}
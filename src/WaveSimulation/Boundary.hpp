@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace WaveSimulation {
+	enum class BoundaryPolicy {
+		Reflective,   //Rigid wall, mirrored state with the normal velocity negated
+		Periodic,     //Ghosts are copies of the opposite side
+		ZeroGradient, //Mirrored state, waves leave the domain
+	};
+
+	enum class Axis {
+		X,
+		Y,
+	};
+
+	// Calls func( dst_x, dst_y, src_x, src_y, axis ) for every ghost cell of a x_s * y_s grid with
+	// halo layers, src being the interior cell the ghost is taken from and axis the boundary it lies behind.
+	// Negative coordinates are wrapped size_t. The y layers span the x ghosts too, so corners are filled
+	// from already filled x ghosts. Periodic needs halo <= x_s, y_s
+	template<typename Func>
+	inline void for_each_ghost( size_t x_s, size_t y_s, size_t halo, BoundaryPolicy policy, Func&& func ){
+		bool periodic = policy == BoundaryPolicy::Periodic;
+
+		for( size_t y = 0; y < y_s; ++y ){
+			for( size_t k = 1; k <= halo; ++k ){
+				func( 0 - k, y, periodic ? x_s - k : k - 1, y, Axis::X );
+				func( x_s - 1 + k, y, periodic ? k - 1 : x_s - k, y, Axis::X );
+			}
+		}
+
+		for( size_t k = 1; k <= halo; ++k ){
+			for( size_t x = 0 - halo; x != x_s + halo; ++x ){
+				func( x, 0 - k, x, periodic ? y_s - k : k - 1, Axis::Y );
+				func( x, y_s - 1 + k, x, periodic ? k - 1 : y_s - k, Axis::Y );
+			}
+		}
+	}
+}
@@ -0,0 +1,186 @@
+#include "Checkpoint.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace WaveSimulation;
+
+//Header fields every version 1 reader relies on, file_size 0 skips the size check
+static bool check_header(const char* path, const CheckpointHeader& header, uint64_t file_size) {
+	const char* error = nullptr;
+
+	if (memcmp(header.magic, "WAVECKPT", 8))
+		error = "is not a checkpoint";
+	else if (header.byte_order != CHECKPOINT_BYTE_ORDER)
+		error = "was written with another byte order";
+	else if (header.version != CHECKPOINT_VERSION || header.header_size != sizeof(CheckpointHeader))
+		error = "has an unsupported version";
+	else if (header.data_offset % CHECKPOINT_ALIGNMENT || header.data_size != header.plane_size * header.planes * header.storage_size)
+		error = "has a broken layout";
+	else if (file_size && file_size < header.data_offset + header.data_size)
+		error = "is truncated";
+
+	if (error)
+		std::cout << "Checkpoint " << path << " " << error << std::endl;
+	return !error;
+}
+
+bool WaveSimulation::read_checkpoint_header(const char* path, CheckpointHeader& header) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		std::cout << "Failed to open checkpoint " << path << std::endl;
+		return false;
+	}
+
+	bool read = std::fread(&header, sizeof(header), 1, file) == 1;
+	std::fclose(file);
+
+	if (!read) {
+		std::cout << "Checkpoint " << path << " is truncated" << std::endl;
+		return false;
+	}
+	return check_header(path, header, 0);
+}
+
+//Waits until the written data of file is on the disk, not only in the page cache
+static bool sync_file(FILE* file) {
+	if (std::fflush(file))
+		return false;
+#ifdef _WIN32
+	return !_commit(_fileno(file));
+#else
+	return !fsync(fileno(file));
+#endif
+}
+
+//Makes a rename in the directory of path survive a power loss. Windows has no handle to sync a directory with
+static void sync_directory([[maybe_unused]] const char* path) {
+#ifndef _WIN32
+	const std::string name(path);
+	const size_t slash = name.find_last_of('/');
+	const std::string directory = slash == std::string::npos ? "." : slash ? name.substr(0, slash) : "/";
+
+	const int fd = open(directory.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	fsync(fd);
+	close(fd);
+#endif
+}
+
+//The planes go out in one large sequential write, synced before the rename so it never points at unwritten data
+bool WaveSimulation::write_checkpoint(const char* path, const CheckpointHeader& header, const void* data) {
+	const std::string temporary = std::string(path) + ".tmp";
+
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (!file) {
+		std::cout << "Failed to create checkpoint " << temporary << std::endl;
+		return false;
+	}
+
+	const std::vector<char> padding(header.data_offset - sizeof(header), 0);
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+		std::fwrite(data, 1, header.data_size, file) == header.data_size &&
+		sync_file(file);
+	written = !std::fclose(file) && written;
+
+#ifdef _WIN32
+	//Windows does not rename over an existing file
+	if (written)
+		std::remove(path);
+#endif
+
+	if (!written || std::rename(temporary.c_str(), path)) {
+		std::cout << "Failed to write checkpoint " << path << std::endl;
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	sync_directory(path);
+	return true;
+}
+
+#ifdef _WIN32
+//No mmap, the file is read into an aligned buffer the owner frees
+bool WaveSimulation::map_checkpoint(const char* path, CheckpointHeader& header, void*& data, std::shared_ptr<void>& owner) {
+	if (!read_checkpoint_header(path, header))
+		return false;
+
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		std::cout << "Failed to open checkpoint " << path << std::endl;
+		return false;
+	}
+
+	void* buffer = ::operator new(header.data_size, std::align_val_t(FIELD_ALIGNMENT));
+	owner = std::shared_ptr<void>(buffer, [](void* ptr) {
+		::operator delete(ptr, std::align_val_t(FIELD_ALIGNMENT));
+	});
+
+	bool read = !_fseeki64(file, header.data_offset, SEEK_SET) && std::fread(buffer, 1, header.data_size, file) == header.data_size;
+	std::fclose(file);
+
+	if (!read) {
+		std::cout << "Checkpoint " << path << " is truncated" << std::endl;
+		owner.reset();
+		return false;
+	}
+
+	data = buffer;
+	return true;
+}
+#else
+//MAP_PRIVATE keeps the file as written when the steps write to the planes, MADV_WILLNEED starts reading ahead
+//in the background so the first step does not fault in every page on its own
+bool WaveSimulation::map_checkpoint(const char* path, CheckpointHeader& header, void*& data, std::shared_ptr<void>& owner) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		std::cout << "Failed to open checkpoint " << path << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) || static_cast<size_t>(info.st_size) < sizeof(CheckpointHeader)) {
+		std::cout << "Checkpoint " << path << " is truncated" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	const size_t size = info.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED) {
+		std::cout << "Failed to map checkpoint " << path << std::endl;
+		return false;
+	}
+
+	owner = std::shared_ptr<void>(mapping, [size](void* ptr) {
+		munmap(ptr, size);
+	});
+
+	memcpy(&header, mapping, sizeof(header));
+	if (!check_header(path, header, size)) {
+		owner.reset();
+		return false;
+	}
+
+	data = static_cast<char*>(mapping) + header.data_offset;
+	madvise(data, header.data_size, MADV_WILLNEED);
+	return true;
+}
+#endif
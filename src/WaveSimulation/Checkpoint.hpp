@@ -0,0 +1,171 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "SimpleGrid.hpp"
+
+namespace WaveSimulation {
+	// Checkpoint file of a SimpleGrid or Riemann2Grid:
+	//   CheckpointHeader, zero padded to data_offset, a multiple of CHECKPOINT_ALIGNMENT
+	//   the planes of values exactly as SoAField lays them out in memory, ghosts and row padding included
+	// Values are in the byte order of the writer, byte_order tells a reader of the other one apart.
+	// Loading maps the file copy on write and points values at it, pages are only read when a step touches them
+	// and the file is never written. Any change of the header or the layout needs a new version
+	constexpr uint32_t CHECKPOINT_VERSION = 1;
+	constexpr uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+	constexpr size_t CHECKPOINT_ALIGNMENT = 4096; //Page size, a mapping then keeps the FIELD_ALIGNMENT of the planes
+
+	enum class CheckpointGrid : uint32_t {
+		Simple,
+		Riemann2,
+	};
+
+	struct CheckpointHeader {
+		char magic[8];         //"WAVECKPT"
+		uint32_t version;
+		uint32_t byte_order;   //CHECKPOINT_BYTE_ORDER as written
+		uint32_t header_size;  //sizeof(CheckpointHeader)
+		CheckpointGrid grid;
+		uint32_t order;        //Element order, 0 for the simple grid
+		uint32_t storage_size; //Bytes per value
+		char precision[8];     //Precision::name
+
+		//Layout of values, see SoAField
+		uint64_t x_s, y_s;
+		uint64_t halo, pitch, plane_size, origin, planes;
+		uint64_t data_offset, data_size; //In bytes from the start of the file
+
+		//Run and grid parameters
+		double time;
+		uint64_t step;
+		double K0, onebyrho0;
+		double cell_size, cfl;   //Riemann2Grid only
+		uint32_t boundary;       //BoundaryPolicy
+		uint32_t integrator;     //TimeIntegrator, Riemann2Grid only
+	};
+
+	// Time and step count of a run, the grids do not track them
+	struct CheckpointState {
+		double time{ 0 };
+		uint64_t step{ 0 };
+	};
+
+	//Writes values and the parameters of grid to path. The file is written under a temporary name, synced to
+	//the disk and renamed over path once complete, so a crash or power loss never leaves a partial checkpoint behind
+	template<typename Grid>
+	bool save_checkpoint(const Grid& grid, const char* path, const CheckpointState& state = {});
+
+	//Restores values and the parameters of grid from path, which must hold a grid of the same type, order and
+	//precision. values becomes a view of the mapped file, nval is allocated without being touched
+	template<typename Grid>
+	bool load_checkpoint(Grid& grid, const char* path, CheckpointState* state = nullptr);
+
+	//Reads and checks the header only, to pick the grid to load into
+	bool read_checkpoint_header(const char* path, CheckpointHeader& header);
+
+	//Untyped parts in Checkpoint.cpp
+	//Writes header, the padding and header.data_size bytes of data
+	bool write_checkpoint(const char* path, const CheckpointHeader& header, const void* data);
+	//Maps the checkpoint at path copy on write and checks its header, data points at the planes in the mapping owner keeps alive
+	bool map_checkpoint(const char* path, CheckpointHeader& header, void*& data, std::shared_ptr<void>& owner);
+
+	//Header of grid without the run state
+	template<typename Grid>
+	CheckpointHeader checkpoint_header(const Grid& grid) {
+		using S = typename Grid::S;
+
+		CheckpointHeader header{};
+		memcpy(header.magic, "WAVECKPT", 8);
+		header.version = CHECKPOINT_VERSION;
+		header.byte_order = CHECKPOINT_BYTE_ORDER;
+		header.header_size = sizeof(CheckpointHeader);
+		header.storage_size = sizeof(S);
+		strncpy(header.precision, Grid::Policy::name, sizeof(header.precision) - 1);
+
+		header.x_s = grid.x_s;
+		header.y_s = grid.y_s;
+		header.halo = grid.values.halo;
+		header.pitch = grid.values.pitch;
+		header.plane_size = grid.values.plane_size;
+		header.origin = grid.values.origin;
+		header.planes = Grid::Field::plane_amount;
+		header.data_offset = (sizeof(CheckpointHeader) + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+		header.data_size = grid.values.size() * sizeof(S);
+
+		header.K0 = grid.K0;
+		header.onebyrho0 = grid.onebyrho0;
+		header.boundary = static_cast<uint32_t>(grid.boundary);
+
+		if constexpr (StagedGrid<Grid>) {
+			header.grid = CheckpointGrid::Riemann2;
+			header.order = Grid::order;
+			header.cell_size = grid.cell_size;
+			header.cfl = grid.cfl;
+			header.integrator = static_cast<uint32_t>(grid.integrator);
+		} else {
+			header.grid = CheckpointGrid::Simple;
+		}
+
+		return header;
+	}
+
+	template<typename Grid>
+	bool save_checkpoint(const Grid& grid, const char* path, const CheckpointState& state) {
+		CheckpointHeader header = checkpoint_header(grid);
+		header.time = state.time;
+		header.step = state.step;
+
+		return write_checkpoint(path, header, grid.values.plane(0));
+	}
+
+	template<typename Grid>
+	bool load_checkpoint(Grid& grid, const char* path, CheckpointState* state) {
+		CheckpointHeader header;
+		void* data;
+		std::shared_ptr<void> owner;
+
+		if (!map_checkpoint(path, header, data, owner))
+			return false;
+
+		const CheckpointHeader expected = checkpoint_header(Grid{});
+		if (header.grid != expected.grid || header.order != expected.order || header.storage_size != expected.storage_size ||
+				strncmp(header.precision, expected.precision, sizeof(header.precision)) || header.planes != expected.planes) {
+			std::cout << "Checkpoint " << path << " holds a grid of another type, order or precision" << std::endl;
+			return false;
+		}
+
+		//The steppers expect every field of the grid in the layout resize() gives
+		typename Grid::Field layout;
+		layout.layout(header.x_s, header.y_s, header.halo);
+		if (header.pitch != layout.pitch || header.plane_size != layout.plane_size || header.origin != layout.origin) {
+			std::cout << "Checkpoint " << path << " was written with another field alignment" << std::endl;
+			return false;
+		}
+
+		grid.x_s = header.x_s;
+		grid.y_s = header.y_s;
+		grid.values.layout(header.x_s, header.y_s, header.halo);
+		grid.values.adopt(static_cast<typename Grid::S*>(data), std::move(owner));
+		grid.nval.allocate(header.x_s, header.y_s, header.halo);
+
+		grid.K0 = header.K0;
+		grid.onebyrho0 = header.onebyrho0;
+		grid.boundary = static_cast<BoundaryPolicy>(header.boundary);
+
+		if constexpr (StagedGrid<Grid>) {
+			grid.cell_size = header.cell_size;
+			grid.cfl = header.cfl;
+			grid.integrator = static_cast<TimeIntegrator>(header.integrator);
+			grid.activity.resize(0, 0);
+		}
+		grid.changes.resize(grid.y_s);
+
+		if (state)
+			*state = CheckpointState{ header.time, header.step };
+
+		return true;
+	}
+}
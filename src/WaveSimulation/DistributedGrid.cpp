@@ -0,0 +1,362 @@
+#include "DistributedGrid.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+using namespace WaveSimulation;
+
+static constexpr Direction directions[4] = { Direction::XNeg, Direction::XPos, Direction::YNeg, Direction::YPos };
+
+static Direction opposite(Direction d) {
+	switch (d) {
+		case Direction::XNeg: return Direction::XPos;
+		case Direction::XPos: return Direction::XNeg;
+		case Direction::YNeg: return Direction::YPos;
+		case Direction::YPos: return Direction::YNeg;
+	}
+	return d;
+}
+
+//Start and length of the part of size cells rank coord of dims owns, the first size % dims ranks get one more
+static void split(size_t size, int dims, int coord, size_t& start, size_t& length) {
+	const size_t base = size / dims, rest = size % dims, c = coord;
+
+	start = c * base + std::min(c, rest);
+	length = base + (c < rest);
+}
+
+void Decomposition::block(int cx, int cy, size_t& bx0, size_t& by0, size_t& bx_s, size_t& by_s) const {
+	split(x_size, dims[0], cx, bx0, bx_s);
+	split(y_size, dims[1], cy, by0, by_s);
+}
+
+//Calls func(x, y) for the halo layers along face d of a x_s * y_s block, the cells sent when inner and the
+//ghosts received into otherwise. Both sides walk them in the same order
+template<typename Func>
+static void for_each_halo_cell(Direction d, size_t x_s, size_t y_s, size_t halo, bool inner, Func&& func) {
+	for (size_t k = 0; k < halo; ++k) {
+		switch (d) {
+			case Direction::XNeg:
+				for (size_t y = 0; y < y_s; ++y)
+					func(inner ? k : 0 - 1 - k, y);
+				break;
+			case Direction::XPos:
+				for (size_t y = 0; y < y_s; ++y)
+					func(inner ? x_s - 1 - k : x_s + k, y);
+				break;
+			case Direction::YNeg:
+				for (size_t x = 0; x < x_s; ++x)
+					func(x, inner ? k : 0 - 1 - k);
+				break;
+			case Direction::YPos:
+				for (size_t x = 0; x < x_s; ++x)
+					func(x, inner ? y_s - 1 - k : y_s + k);
+				break;
+		}
+	}
+}
+
+template<typename Grid>
+bool DistributedGrid<Grid>::create(MPI_Comm comm, size_t x_size, size_t y_size, BoundaryPolicy boundary, int ranks_x, int ranks_y) {
+	destroy();
+
+	Decomposition& d = decomposition;
+	MPI_Comm_size(comm, &d.ranks);
+
+	if ((ranks_x && d.ranks % ranks_x) || (ranks_y && d.ranks % ranks_y) || (ranks_x && ranks_y && ranks_x * ranks_y != d.ranks)) {
+		std::cout << d.ranks << " ranks can not be arranged as " << ranks_x << "x" << ranks_y << std::endl;
+		return false;
+	}
+
+	//MPI orders the dimensions slowest first, dims and coords here are (x, y)
+	int dims[2] = { ranks_y, ranks_x };
+	MPI_Dims_create(d.ranks, 2, dims);
+
+	if (static_cast<size_t>(dims[1]) > x_size || static_cast<size_t>(dims[0]) > y_size) {
+		std::cout << "A " << x_size << "x" << y_size << " domain can not be split over " << dims[1] << "x" << dims[0] << " ranks" << std::endl;
+		return false;
+	}
+
+	const bool periodic = boundary == BoundaryPolicy::Periodic;
+	const int periods[2] = { periodic, periodic };
+	MPI_Cart_create(comm, 2, dims, periods, 0, &d.comm);
+
+	int coords[2];
+	MPI_Comm_rank(d.comm, &d.rank);
+	MPI_Cart_coords(d.comm, d.rank, 2, coords);
+
+	d.dims[0] = dims[1];
+	d.dims[1] = dims[0];
+	d.coords[0] = coords[1];
+	d.coords[1] = coords[0];
+
+	MPI_Cart_shift(d.comm, 1, 1, &d.neighbours[static_cast<int>(Direction::XNeg)], &d.neighbours[static_cast<int>(Direction::XPos)]);
+	MPI_Cart_shift(d.comm, 0, 1, &d.neighbours[static_cast<int>(Direction::YNeg)], &d.neighbours[static_cast<int>(Direction::YPos)]);
+
+	d.x_size = x_size;
+	d.y_size = y_size;
+	d.block(d.coords[0], d.coords[1], d.x0, d.y0, d.x_s, d.y_s);
+
+	grid.boundary = boundary;
+	grid.resize(d.x_s, d.y_s);
+	if constexpr (StagedGrid<Grid>)
+		grid.skip_quiet = false;
+
+	exchange_wait = 0;
+	return true;
+}
+
+template<typename Grid>
+void DistributedGrid<Grid>::destroy() {
+	if (decomposition.comm != MPI_COMM_NULL)
+		MPI_Comm_free(&decomposition.comm);
+	decomposition = Decomposition{};
+}
+
+template<typename Grid>
+DistributedGrid<Grid>::~DistributedGrid() {
+	int finalized = 0;
+	MPI_Finalized(&finalized);
+	if (!finalized)
+		destroy();
+}
+
+template<typename Grid>
+void DistributedGrid<Grid>::begin_exchange(Field& field) {
+	const Decomposition& d = decomposition;
+	const size_t halo = field.halo;
+
+	request_amount = 0;
+
+	for (Direction dir: directions) {
+		const int i = static_cast<int>(dir);
+
+		if (d.neighbours[i] == MPI_PROC_NULL) {
+			const Axis axis = dir == Direction::XNeg || dir == Direction::XPos ? Axis::X : Axis::Y;
+			const size_t x_s = grid.x_s, y_s = grid.y_s;
+
+			//Mirrors the layers behind the wall the way for_each_ghost() does
+			for (size_t k = 0; k < halo; ++k) {
+				for_each_halo_cell(dir, x_s, y_s, 1, false, [&](size_t x, size_t y) {
+					switch (dir) {
+						case Direction::XNeg: grid.ghost_cell(field, grid.boundary, x - k, y, k, y, axis); break;
+						case Direction::XPos: grid.ghost_cell(field, grid.boundary, x + k, y, x_s - 1 - k, y, axis); break;
+						case Direction::YNeg: grid.ghost_cell(field, grid.boundary, x, y - k, x, k, axis); break;
+						case Direction::YPos: grid.ghost_cell(field, grid.boundary, x, y + k, x, y_s - 1 - k, axis); break;
+					}
+				});
+			}
+			continue;
+		}
+
+		const size_t cells = halo * (dir == Direction::XNeg || dir == Direction::XPos ? grid.y_s : grid.x_s);
+		const int bytes = static_cast<int>(cells * Field::plane_amount * sizeof(S));
+
+		recv[i].resize(cells * Field::plane_amount);
+		send[i].resize(cells * Field::plane_amount);
+
+		//The message travelling in direction d is tagged d, so two faces towards the same rank stay apart
+		MPI_Irecv(recv[i].data(), bytes, MPI_BYTE, d.neighbours[i], static_cast<int>(opposite(dir)), d.comm, &requests[request_amount++]);
+
+		S* out = send[i].data();
+		for (size_t n = 0; n < Field::plane_amount; ++n) {
+			const S* plane = field.plane(n);
+			for_each_halo_cell(dir, grid.x_s, grid.y_s, halo, true, [&](size_t x, size_t y) {
+				*out++ = plane[field.index(x, y)];
+			});
+		}
+
+		MPI_Isend(send[i].data(), bytes, MPI_BYTE, d.neighbours[i], i, d.comm, &requests[request_amount++]);
+	}
+}
+
+template<typename Grid>
+bool DistributedGrid<Grid>::test_exchange() {
+	int done = 1;
+	if (request_amount)
+		MPI_Testall(request_amount, requests, &done, MPI_STATUSES_IGNORE);
+	return done;
+}
+
+template<typename Grid>
+void DistributedGrid<Grid>::finish_exchange(Field& field) {
+	const Decomposition& d = decomposition;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	MPI_Waitall(request_amount, requests, MPI_STATUSES_IGNORE);
+	exchange_wait += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	request_amount = 0;
+
+	for (Direction dir: directions) {
+		const int i = static_cast<int>(dir);
+		if (d.neighbours[i] == MPI_PROC_NULL)
+			continue;
+
+		const S* in = recv[i].data();
+		for (size_t n = 0; n < Field::plane_amount; ++n) {
+			S* plane = field.plane(n);
+			for_each_halo_cell(dir, grid.x_s, grid.y_s, field.halo, false, [&](size_t x, size_t y) {
+				plane[field.index(x, y)] = *in++;
+			});
+		}
+	}
+}
+
+template<typename Grid>
+template<typename Stage>
+void DistributedGrid<Grid>::run_stage(Field& in, Field& out, double dt, const Stage& stage) {
+	overlapped(in, [&](const Tile& tile) {
+		grid.finite_volume_region(in, out, tile, dt, stage);
+	});
+}
+
+template<typename Grid>
+void DistributedGrid<Grid>::step_finite_volume(double dt) {
+	grid.solver.update(grid.K0, grid.onebyrho0);
+
+	overlapped(grid.values, [&](const Tile& tile) {
+		grid.finite_volume_region(grid.values, grid.nval, tile, dt);
+	});
+
+	std::swap(grid.values, grid.nval);
+	grid.changes.mark(0, grid.y_s);
+	if constexpr (StagedGrid<Grid>)
+		grid.activity.synced = false;
+}
+
+template<typename Grid>
+void DistributedGrid<Grid>::step_finite_difference(double dt) requires (!StagedGrid<Grid>) {
+	overlapped(grid.values, [&](const Tile& tile) {
+		grid.finite_difference_region(grid.values, grid.nval, tile, dt);
+	});
+
+	std::swap(grid.values, grid.nval);
+	grid.changes.mark(0, grid.y_s);
+}
+
+//The stages of Riemann2Grid::step(), each one exchanges the halos of the field it reads
+template<typename Grid>
+void DistributedGrid<Grid>::step(double dt) requires StagedGrid<Grid> {
+	using Stage = typename Grid::Stage;
+
+	switch (grid.integrator) {
+		case TimeIntegrator::Euler:
+			step_finite_volume(dt);
+			return;
+
+		case TimeIntegrator::SSPRK2:
+			grid.solver.update(grid.K0, grid.onebyrho0);
+			run_stage(grid.values, grid.nval, dt, Stage{});
+			run_stage(grid.nval, grid.values, dt, Stage{ &grid.values, T(0.5), T(0.5) });
+			break;
+
+		case TimeIntegrator::SSPRK3: {
+			constexpr LowStorageStage s0 = ssprk3_stage(0), s1 = ssprk3_stage(1), s2 = ssprk3_stage(2);
+
+			grid.solver.update(grid.K0, grid.onebyrho0);
+			run_stage(grid.values, grid.nval, s0.dt_scale * dt, Stage{});
+			run_stage(grid.nval, grid.values, s1.dt_scale * dt, Stage{ &grid.values, T(s1.a), T(s1.b) });
+			run_stage(grid.values, grid.nval, s2.dt_scale * dt, Stage{ &grid.nval, T(s2.a), T(s2.b) });
+			std::swap(grid.values, grid.nval);
+			break;
+		}
+	}
+
+	grid.activity.synced = false;
+	grid.changes.mark(0, grid.y_s);
+}
+
+template<typename Grid>
+double DistributedGrid<Grid>::stable_dt() const requires StagedGrid<Grid> {
+	double local = grid.stable_dt(), global = local;
+	MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_MIN, decomposition.comm);
+	return global;
+}
+
+//Every rank sends its interior plane by plane, root places the blocks by the coordinates of their rank
+template<typename Grid>
+void DistributedGrid<Grid>::gather(Grid& whole, int root) const {
+	const Decomposition& d = decomposition;
+	const size_t planes = Field::plane_amount;
+
+	std::vector<S> block;
+	block.reserve(d.x_s * d.y_s * planes);
+	for (size_t n = 0; n < planes; ++n)
+		for (size_t y = 0; y < d.y_s; ++y)
+			for (size_t x = 0; x < d.x_s; ++x)
+				block.push_back(grid.values.plane(n)[grid.values.index(x, y)]);
+
+	std::vector<int> counts, displs;
+	std::vector<S> all;
+	if (d.rank == root) {
+		counts.resize(d.ranks);
+		displs.resize(d.ranks);
+		for (int r = 0, offset = 0; r < d.ranks; ++r) {
+			int coords[2];
+			size_t bx0, by0, bx_s, by_s;
+			MPI_Cart_coords(d.comm, r, 2, coords);
+			d.block(coords[1], coords[0], bx0, by0, bx_s, by_s);
+
+			counts[r] = static_cast<int>(bx_s * by_s * planes * sizeof(S));
+			displs[r] = offset;
+			offset += counts[r];
+		}
+		all.resize(d.x_size * d.y_size * planes);
+	}
+
+	MPI_Gatherv(block.data(), static_cast<int>(block.size() * sizeof(S)), MPI_BYTE,
+		all.data(), counts.data(), displs.data(), MPI_BYTE, root, d.comm);
+
+	if (d.rank != root)
+		return;
+
+	whole.boundary = grid.boundary;
+	whole.resize(d.x_size, d.y_size, grid.values.halo);
+
+	for (int r = 0; r < d.ranks; ++r) {
+		int coords[2];
+		size_t bx0, by0, bx_s, by_s;
+		MPI_Cart_coords(d.comm, r, 2, coords);
+		d.block(coords[1], coords[0], bx0, by0, bx_s, by_s);
+
+		const S* in = all.data() + displs[r] / sizeof(S);
+		for (size_t n = 0; n < planes; ++n)
+			for (size_t y = 0; y < by_s; ++y)
+				for (size_t x = 0; x < bx_s; ++x)
+					whole.values.plane(n)[whole.values.index(bx0 + x, by0 + y)] = *in++;
+	}
+}
+
+template struct WaveSimulation::DistributedGrid<SimpleGrid<Fp64>>;
+template struct WaveSimulation::DistributedGrid<SimpleGrid<Fp32>>;
+template struct WaveSimulation::DistributedGrid<SimpleGrid<Fp16>>;
+template struct WaveSimulation::DistributedGrid<SimpleGrid<Bf16>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 2>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 2>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 2>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 2>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 3>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 3>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 3>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 3>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 4>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 4>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 4>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 4>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 5>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 5>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 5>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 5>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 6>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 6>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 6>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 6>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp64, 7>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp32, 7>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Fp16, 7>>;
+template struct WaveSimulation::DistributedGrid<Riemann2Grid<Bf16, 7>>;
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <mpi.h>
+#include <algorithm>
+#include <stddef.h>
+#include <vector>
+#include "SimpleGrid.hpp"
+
+namespace WaveSimulation {
+	// 2D Cartesian decomposition of a x_size * y_size domain over the ranks of a communicator.
+	// Every rank owns the block [x0, x0 + x_s) x [y0, y0 + y_s), the blocks of an axis differ by at most one cell
+	struct Decomposition {
+		MPI_Comm comm{ MPI_COMM_NULL }; //Cartesian, periodic when the boundary is
+		int rank{ 0 };
+		int ranks{ 1 };
+		int dims[2]{ 1, 1 };   //Ranks along x and y
+		int coords[2]{ 0, 0 };
+		int neighbours[4]{ MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL }; //Per Direction, none behind a wall
+
+		size_t x_size{ 0 }, y_size{ 0 };
+		size_t x0{ 0 }, y0{ 0 };
+		size_t x_s{ 0 }, y_s{ 0 };
+
+		//Block of the rank at coords (cx, cy)
+		void block(int cx, int cy, size_t& bx0, size_t& by0, size_t& bx_s, size_t& by_s) const;
+	};
+
+	// Grid (SimpleGrid or Riemann2Grid) stepped on a block of a domain decomposed over MPI ranks.
+	// The local grid holds the block with its ghost layers. Ghosts on a face shared with another rank are
+	// received from it, ghosts behind the domain boundary are filled by ghost_cell() as update_ghosts() does.
+	// The steppers read the four face neighbours of a cell only, so the corner ghosts are not exchanged.
+	//
+	// Every stage posts non-blocking sends and receives of the halo layers, steps the interior cells that do
+	// not read ghosts while they are in flight, then waits and steps the frame of cells along the faces.
+	// Cells do the same arithmetic as on one rank, the result is bitwise that of the undecomposed grid.
+	// MPI is only called from the thread that steps, the library needs MPI_THREAD_FUNNELED.
+	// Activity tracking is not used, every cell is stepped
+	template<typename Grid>
+	struct DistributedGrid {
+		using T = typename Grid::T;
+		using S = typename Grid::S;
+		using Field = typename Grid::Field;
+
+		//Cells a stage reads on every side of a cell
+		static constexpr size_t reach = 1;
+
+		DistributedGrid() = default;
+		DistributedGrid(const DistributedGrid&) = delete;
+		DistributedGrid& operator=(const DistributedGrid&) = delete;
+
+		//Splits x_size * y_size over the ranks of comm, ranks_x * ranks_y of them or a balanced split for 0.
+		//Allocates the zeroed local block, collective over comm
+		bool create(MPI_Comm comm, size_t x_size, size_t y_size, BoundaryPolicy boundary, int ranks_x = 0, int ranks_y = 0);
+		void destroy();
+		~DistributedGrid();
+
+		//Sets every local cell to func(x, y) of its global coordinates
+		template<typename Func>
+		void fill(Func&& func);
+
+		//Forward Euler on both grids
+		void step_finite_volume(double dt);
+		//Central differences, SimpleGrid only
+		void step_finite_difference(double dt) requires (!StagedGrid<Grid>);
+		//One step of grid.integrator
+		void step(double dt) requires StagedGrid<Grid>;
+		//Smallest stable_dt() of all ranks
+		double stable_dt() const requires StagedGrid<Grid>;
+
+		//Copies the blocks of all ranks into whole on root, which is resized to the domain. Collective
+		void gather(Grid& whole, int root = 0) const;
+
+		//Fills the ghosts behind walls and starts the exchange of the halo layers of field with the neighbours
+		void begin_exchange(Field& field);
+		//Lets MPI progress the exchange, true once it is done
+		bool test_exchange();
+		//Waits for the exchange and unpacks the received halos into the ghosts of field
+		void finish_exchange(Field& field);
+		//Runs func(tile) over the tiles of the local block while the halos of in are exchanged,
+		//the interior between the calls to test_exchange() and the frame once they arrived
+		template<typename Func>
+		void overlapped(Field& in, Func&& func);
+
+		Grid grid; //Local block, its K0, onebyrho0, tiles, integrator and cfl apply
+		Decomposition decomposition;
+
+		size_t progress_bands{ 4 }; //The interior is stepped in as many bands of rows, MPI progresses between them
+		double exchange_wait{ 0 };  //Seconds spent in finish_exchange() over the run, the part of the exchange not hidden
+
+	private:
+		//Grid::Stage over the local block with the halos of in exchanged
+		template<typename Stage>
+		void run_stage(Field& in, Field& out, double dt, const Stage& stage);
+
+		std::vector<S> send[4];
+		std::vector<S> recv[4];
+		MPI_Request requests[8];
+		int request_amount{ 0 };
+	};
+
+	template<typename Grid>
+	template<typename Func>
+	void DistributedGrid<Grid>::fill(Func&& func) {
+		const Decomposition& d = decomposition;
+
+		for (size_t y = 0; y < d.y_s; ++y)
+			for (size_t x = 0; x < d.x_s; ++x)
+				grid.set(x, y, func(d.x0 + x, d.y0 + y));
+	}
+
+	template<typename Grid>
+	template<typename Func>
+	void DistributedGrid<Grid>::overlapped(Field& in, Func&& func) {
+		const size_t x_s = grid.x_s, y_s = grid.y_s;
+
+		begin_exchange(in);
+
+		if (x_s <= 2 * reach || y_s <= 2 * reach) {
+			finish_exchange(in);
+			for_each_tile(Tile{ 0, x_s, 0, y_s, true, true, true, true }, grid.tiles, func);
+			return;
+		}
+
+		const size_t x0 = reach, x1 = x_s - reach;
+		const size_t y0 = reach, y1 = y_s - reach;
+		const size_t bands = std::min(progress_bands ? progress_bands : 1, y1 - y0);
+
+		for (size_t b = 0; b < bands; ++b) {
+			for_each_tile(Tile{ x0, x1, y0 + (y1 - y0) * b / bands, y0 + (y1 - y0) * (b + 1) / bands, false, false, false, false },
+				grid.tiles, func);
+			test_exchange();
+		}
+
+		finish_exchange(in);
+
+		for_each_tile(Tile{ 0, x_s, 0, y0, true, true, true, false }, grid.tiles, func);
+		for_each_tile(Tile{ 0, x_s, y1, y_s, true, true, false, true }, grid.tiles, func);
+		for_each_tile(Tile{ 0, x0, y0, y1, true, false, false, false }, grid.tiles, func);
+		for_each_tile(Tile{ x1, x_s, y0, y1, false, true, false, false }, grid.tiles, func);
+	}
+
+	//Instantiated for every grid in DistributedGrid.cpp
+	extern template struct DistributedGrid<SimpleGrid<Fp64>>;
+	extern template struct DistributedGrid<SimpleGrid<Fp32>>;
+	extern template struct DistributedGrid<SimpleGrid<Fp16>>;
+	extern template struct DistributedGrid<SimpleGrid<Bf16>>;
+
+	extern template struct DistributedGrid<Riemann2Grid<Fp64>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 2>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 2>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 2>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 2>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 3>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 3>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 3>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 3>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 4>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 4>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 4>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 4>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 5>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 5>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 5>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 5>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 6>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 6>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 6>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 6>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp64, 7>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp32, 7>>;
+	extern template struct DistributedGrid<Riemann2Grid<Fp16, 7>>;
+	extern template struct DistributedGrid<Riemann2Grid<Bf16, 7>>;
+}
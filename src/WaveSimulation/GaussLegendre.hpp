@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+
+namespace WaveSimulation {
+	namespace detail {
+		//Legendre polynomial P_n at x from the three term recurrence, prev is P_(n - 1)
+		constexpr double legendre(size_t n, double x, double& prev) {
+			double p0 = 1, p1 = x;
+			for (size_t k = 2; k <= n; ++k) {
+				double p2 = ((2 * k - 1) * x * p1 - (k - 1) * p0) / k;
+				p0 = p1;
+				p1 = p2;
+			}
+
+			prev = n ? p0 : 0;
+			return n ? p1 : 1;
+		}
+
+		//P_n' at x in (-1, 1)
+		constexpr double legendre_derivative(size_t n, double x) {
+			double prev = 0;
+			double p = legendre(n, x, prev);
+			return n * (x * p - prev) / (x * x - 1);
+		}
+
+		template<size_t n>
+		struct GaussLegendreTables {
+			using Table = std::array<double, n>;
+			using Matrix = std::array<Table, n>;
+
+			Table node{}, weight{};
+			Table at0{}, at1{}, lift0{}, lift1{};
+			Matrix derivative{}, weak_derivative{};
+			std::array<Matrix, 2> half{}, coarsen{};
+
+			constexpr double basis(size_t k, double x) const {
+				double res = 1;
+				for (size_t m = 0; m < n; ++m)
+					if (m != k)
+						res *= (x - node[m]) / (node[k] - node[m]);
+				return res;
+			}
+
+			constexpr double basis_derivative(size_t k, double x) const {
+				double res = 0;
+				for (size_t m = 0; m < n; ++m) {
+					if (m == k)
+						continue;
+
+					double term = 1 / (node[k] - node[m]);
+					for (size_t r = 0; r < n; ++r)
+						if (r != k && r != m)
+							term *= (x - node[r]) / (node[k] - node[r]);
+					res += term;
+				}
+				return res;
+			}
+		};
+
+		//The roots of P_m lie between the roots of P_(m - 1), each is found by bisection of its interval
+		template<size_t n>
+		constexpr std::array<double, n> legendre_roots() {
+			std::array<double, n> roots{}, prev{};
+
+			for (size_t m = 1; m <= n; ++m) {
+				for (size_t r = 0; r < m; ++r) {
+					double lo = r ? prev[r - 1] : -1;
+					double hi = r + 1 < m ? prev[r] : 1;
+					double prev = 0;
+					const double p_lo = legendre(m, lo, prev);
+
+					for (int it = 0; it < 2000; ++it) {
+						double mid = 0.5 * (lo + hi);
+						if (mid == lo || mid == hi)
+							break;
+
+						if ((legendre(m, mid, prev) < 0) == (p_lo < 0))
+							lo = mid;
+						else
+							hi = mid;
+					}
+					roots[r] = 0.5 * (lo + hi);
+				}
+
+				//The roots are symmetric, the middle one of odd m is 0
+				for (size_t r = 0; r < m / 2; ++r) {
+					double x = 0.5 * (roots[m - 1 - r] - roots[r]);
+					roots[r] = -x;
+					roots[m - 1 - r] = x;
+				}
+				if (m % 2)
+					roots[m / 2] = 0;
+
+				prev = roots;
+			}
+
+			return roots;
+		}
+
+		template<size_t n>
+		constexpr GaussLegendreTables<n> gauss_legendre_tables() {
+			GaussLegendreTables<n> t;
+			const std::array<double, n> roots = legendre_roots<n>();
+
+			for (size_t i = 0; i < n; ++i) {
+				const double dp = legendre_derivative(n, roots[i]);
+
+				t.node[i] = 0.5 * roots[i] + 0.5;
+				t.weight[i] = 1 / ((1 - roots[i] * roots[i]) * dp * dp);
+			}
+			//Symmetric and summing to the length of the element, so order 1 gets exactly 1/2
+			double sum = 0;
+			for (size_t i = 0; i < n / 2; ++i)
+				t.weight[i] = t.weight[n - 1 - i] = 0.5 * (t.weight[i] + t.weight[n - 1 - i]);
+			for (size_t i = 0; i < n; ++i)
+				sum += t.weight[i];
+			for (size_t i = 0; i < n; ++i)
+				t.weight[i] /= sum;
+
+			for (size_t i = 0; i < n; ++i) {
+				t.at0[i] = t.basis(i, 0);
+				t.at1[i] = t.basis(i, 1);
+				t.lift0[i] = t.at0[i] / t.weight[i];
+				t.lift1[i] = t.at1[i] / t.weight[i];
+
+				for (size_t k = 0; k < n; ++k) {
+					t.derivative[i][k] = t.basis_derivative(k, t.node[i]);
+					t.weak_derivative[i][k] = t.weight[k] * t.basis_derivative(i, t.node[k]) / t.weight[i];
+
+					for (size_t q = 0; q < 2; ++q) {
+						t.half[q][i][k] = t.basis(k, 0.5 * (q + t.node[i]));
+						t.coarsen[q][i][k] = 0.5 * t.weight[i] / t.weight[k] * t.half[q][i][k];
+					}
+				}
+			}
+
+			return t;
+		}
+
+		template<typename T>
+		constexpr T table_cast(double value) {
+			return T(value);
+		}
+
+		template<typename T, typename U, size_t n>
+		constexpr auto table_cast(const std::array<U, n>& table) {
+			std::array<decltype(table_cast<T>(table[0])), n> res{};
+			for (size_t i = 0; i < n; ++i)
+				res[i] = table_cast<T>(table[i]);
+			return res;
+		}
+	}
+
+	// Nodal element of order N on [0, 1], the Lagrange polynomials l_k through the N + 1 Gauss-Legendre nodes.
+	// The 2D element is their tensor product, node i + (N + 1) * j sits at (node[i], node[j]) and its mass matrix
+	// is diagonal with weight[i] * weight[j] since the quadrature on the nodes is exact for the products of two bases.
+	// The tables are computed at compile time in double and rounded to T once
+	template<size_t N, typename T = double>
+	struct GaussLegendre {
+		static constexpr size_t nodes = N + 1;
+		using Table = std::array<T, nodes>;
+		using Matrix = std::array<Table, nodes>;
+
+		static constexpr detail::GaussLegendreTables<nodes> tables = detail::gauss_legendre_tables<nodes>();
+
+		static constexpr Table node = detail::table_cast<T>(tables.node);
+		static constexpr Table weight = detail::table_cast<T>(tables.weight);
+
+		//l_k(0) and l_k(1), extrapolate the nodes to a face
+		static constexpr Table at0 = detail::table_cast<T>(tables.at0);
+		static constexpr Table at1 = detail::table_cast<T>(tables.at1);
+		//Inverse mass times the face integral, what a flux at a face node adds to the nodes of its line
+		static constexpr Table lift0 = detail::table_cast<T>(tables.lift0);
+		static constexpr Table lift1 = detail::table_cast<T>(tables.lift1);
+
+		//[i][k] = l_k'(node i), the derivative at the nodes
+		static constexpr Matrix derivative = detail::table_cast<T>(tables.derivative);
+		//[i][k] = weight k * l_i'(node k) / weight i, inverse mass times the volume integral against the derivative of l_i
+		static constexpr Matrix weak_derivative = detail::table_cast<T>(tables.weak_derivative);
+
+		//[q][i][k] = l_k((q + node i) / 2), the element evaluated at the nodes of its half q
+		static constexpr std::array<Matrix, 2> half = detail::table_cast<T>(tables.half);
+		//[q][i][k] = weight i / (2 weight k) * half[q][i][k], projects the nodes of half q back onto node k
+		static constexpr std::array<Matrix, 2> coarsen = detail::table_cast<T>(tables.coarsen);
+	};
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace WaveSimulation {
+	// Planes and rows start on a cache line
+	constexpr size_t FIELD_ALIGNMENT = 64;
+
+	template<typename T>
+	struct AlignedAllocator {
+		using value_type = T;
+
+		AlignedAllocator() = default;
+
+		template<typename U>
+		AlignedAllocator( const AlignedAllocator<U>& ){}
+
+		T* allocate( size_t n ){
+			return static_cast<T*>( ::operator new( n * sizeof( T ), std::align_val_t( FIELD_ALIGNMENT )));
+		}
+
+		void deallocate( T* ptr, size_t ){
+			::operator delete( ptr, std::align_val_t( FIELD_ALIGNMENT ));
+		}
+
+		//Default initialization, growing a vector of plain values leaves the new pages untouched
+		template<typename U>
+		void construct( U* ptr ){
+			::new( static_cast<void*>( ptr )) U;
+		}
+
+		template<typename U, typename... Args>
+		void construct( U* ptr, Args&&... args ){
+			::new( static_cast<void*>( ptr )) U( std::forward<Args>( args )... );
+		}
+
+		template<typename U>
+		bool operator==( const AlignedAllocator<U>& ) const { return true; }
+	};
+
+	// Structure of arrays storage: every variable (and DG node) is its own contiguous plane.
+	// Every plane is surrounded by halo ghost cells, index( x, y ) accepts x and y in [-halo, size + halo),
+	// negative coordinates are passed as wrapped size_t (x - 1 for x = 0). Rows are padded to
+	// FIELD_ALIGNMENT and the first interior cell of every row starts on a cache line.
+	// The planes are owned by the field, or a view of memory kept alive by mapping (see Checkpoint.hpp).
+	// Copies always own their planes
+	template<typename T, size_t Planes>
+	struct SoAField {
+		using value_type = T;
+		static constexpr size_t plane_amount = Planes;
+
+		SoAField() = default;
+		SoAField( SoAField&& ) = default;
+		SoAField& operator=( SoAField&& ) = default;
+
+		SoAField( const SoAField& other ){
+			*this = other;
+		}
+
+		SoAField& operator=( const SoAField& other ){
+			if( this == &other )
+				return *this;
+
+			halo = other.halo;
+			pitch = other.pitch;
+			plane_size = other.plane_size;
+			origin = other.origin;
+			data.assign( other.plane( 0 ), other.plane( 0 ) + other.size());
+			mapped = nullptr;
+			mapping.reset();
+			return *this;
+		}
+
+		//Sets the layout of a x_s * y_s field without touching the planes
+		void layout( size_t x_s, size_t y_s, size_t halo_width = 1 ){
+			constexpr size_t row_align = FIELD_ALIGNMENT / sizeof( T );
+
+			halo = halo_width;
+
+			size_t x_pad = ( halo + row_align - 1 ) / row_align * row_align;
+			pitch = ( x_pad + x_s + halo + row_align - 1 ) / row_align * row_align;
+			plane_size = pitch * ( y_s + 2 * halo );
+			origin = halo * pitch + x_pad;
+		}
+
+		//Zeroed planes
+		void resize( size_t x_s, size_t y_s, size_t halo_width = 1 ){
+			layout( x_s, y_s, halo_width );
+			unmap();
+			data.assign( size(), T{} );
+		}
+
+		//Planes of unspecified values, for fields that are written before they are read.
+		//Fresh pages from the system are not touched until then
+		void allocate( size_t x_s, size_t y_s, size_t halo_width = 1 ){
+			layout( x_s, y_s, halo_width );
+			unmap();
+			data.resize( size());
+		}
+
+		//Views the planes at planes, laid out as layout() computes, which owner keeps alive
+		void adopt( T* planes, std::shared_ptr<void> owner ){
+			data.clear();
+			data.shrink_to_fit();
+			mapped = planes;
+			mapping = std::move( owner );
+		}
+
+		inline size_t size() const {
+			return plane_size * Planes;
+		}
+
+		inline T* plane( size_t i ){
+			return ( mapped ? mapped : data.data()) + i * plane_size;
+		}
+
+		inline const T* plane( size_t i ) const {
+			return ( mapped ? mapped : data.data()) + i * plane_size;
+		}
+
+		//Unsigned wrap around keeps ghost coordinates exact
+		inline size_t index( size_t x, size_t y ) const {
+			return origin + y * pitch + x;
+		}
+
+		size_t halo{ 0 };
+		size_t pitch{ 0 };
+		size_t plane_size{ 0 };
+		size_t origin{ 0 }; //Offset of cell ( 0, 0 ) in a plane
+
+		std::vector<T, AlignedAllocator<T>> data;
+		T* mapped{ nullptr };
+		std::shared_ptr<void> mapping;
+
+	private:
+		void unmap(){
+			mapped = nullptr;
+			mapping.reset();
+		}
+	};
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace WaveSimulation {
+	// IEEE half precision storage type, converted with round to nearest even
+	struct Half {
+		uint16_t bits;
+
+		Half() = default;
+		Half( float f ) : bits( from_float( f )){}
+
+		operator float() const { return to_float( bits ); }
+
+		static inline uint16_t from_float( float f ){
+			uint32_t u;
+			memcpy( &u, &f, sizeof( u ));
+
+			const uint32_t sign = u & 0x80000000u;
+			u ^= sign;
+
+			uint16_t h;
+			if( u >= ( 127 + 16 ) << 23 ){
+				//Too large for a half, inf or nan
+				h = u > 0x7f800000u ? 0x7e00 : 0x7c00;
+			} else if( u < 113u << 23 ){
+				//Subnormal half, the float addition rounds the mantissa into place
+				const uint32_t magic_u = (( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+				float magic, v;
+				memcpy( &magic, &magic_u, sizeof( magic ));
+				memcpy( &v, &u, sizeof( v ));
+				v += magic;
+				memcpy( &u, &v, sizeof( u ));
+				h = static_cast<uint16_t>( u - magic_u );
+			} else {
+				uint32_t mant_odd = ( u >> 13 ) & 1;
+				u += ( static_cast<uint32_t>( 15 - 127 ) << 23 ) + 0xfff + mant_odd;
+				h = static_cast<uint16_t>( u >> 13 );
+			}
+
+			return h | static_cast<uint16_t>( sign >> 16 );
+		}
+
+		static inline float to_float( uint16_t h ){
+			const uint32_t shifted_exp = 0x7c00u << 13;
+
+			uint32_t u = ( h & 0x7fffu ) << 13;
+			uint32_t exp = u & shifted_exp;
+			u += ( 127 - 15 ) << 23;
+
+			float f;
+			if( exp == shifted_exp ){
+				u += ( 128 - 16 ) << 23; //inf, nan
+			} else if( exp == 0 ){
+				//Subnormal half, renormalized by the float subtraction
+				const uint32_t magic_u = 113u << 23;
+				float magic;
+				u += 1 << 23;
+				memcpy( &f, &u, sizeof( f ));
+				memcpy( &magic, &magic_u, sizeof( magic ));
+				f -= magic;
+				memcpy( &u, &f, sizeof( u ));
+			}
+
+			u |= static_cast<uint32_t>( h & 0x8000u ) << 16;
+			memcpy( &f, &u, sizeof( f ));
+			return f;
+		}
+	};
+
+	// bfloat16 storage type, the upper half of a float rounded to nearest even
+	struct BFloat16 {
+		uint16_t bits;
+
+		BFloat16() = default;
+		BFloat16( float f ) : bits( from_float( f )){}
+
+		operator float() const { return to_float( bits ); }
+
+		static inline uint16_t from_float( float f ){
+			uint32_t u;
+			memcpy( &u, &f, sizeof( u ));
+
+			if(( u & 0x7fffffffu ) > 0x7f800000u )
+				return static_cast<uint16_t>(( u >> 16 ) | 0x40 ); //Keep nan quiet
+
+			u += 0x7fff + (( u >> 16 ) & 1 );
+			return static_cast<uint16_t>( u >> 16 );
+		}
+
+		static inline float to_float( uint16_t b ){
+			uint32_t u = static_cast<uint32_t>( b ) << 16;
+			float f;
+			memcpy( &f, &u, sizeof( f ));
+			return f;
+		}
+	};
+
+	// Precision policies for the grids: the type fields are stored in and the type the solver computes in.
+	// Every step converts storage to compute on load and back on store, nothing else changes type in the loops
+	struct Fp64 {
+		using storage = double;
+		using compute = double;
+		static constexpr const char* name = "fp64";
+	};
+
+	struct Fp32 {
+		using storage = float;
+		using compute = float;
+		static constexpr const char* name = "fp32";
+	};
+
+	// Half the memory traffic of Fp32, about 3 significant digits
+	struct Fp16 {
+		using storage = Half;
+		using compute = float;
+		static constexpr const char* name = "fp16";
+	};
+
+	// Half the memory traffic of Fp32 with the float exponent range, about 2 significant digits
+	struct Bf16 {
+		using storage = BFloat16;
+		using compute = float;
+		static constexpr const char* name = "bf16";
+	};
+}
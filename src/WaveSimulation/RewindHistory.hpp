@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <stddef.h>
+#include <vector>
+#include "SnapshotCodec.hpp"
+#include "SnapshotReader.hpp"
+
+namespace WaveSimulation {
+	// Recent history of a grid advanced in fixed frames, to step back and forth through without starting over.
+	// Every keyframe_interval frames the grid is kept as a lossless snapshot keyframe, the oldest are dropped once
+	// the keyframes take more than budget bytes. A frame in between is restored from the keyframe before it and
+	// advanced again, stepping is deterministic so the result is bitwise the frame that was recorded
+	template<typename Grid>
+	struct RewindHistory {
+		//threads 0 compresses on all
+		explicit RewindHistory(size_t budget = size_t(256) << 20, size_t keyframe_interval = 16, size_t threads = 0) :
+			budget(budget), keyframe_interval(std::max(keyframe_interval, size_t(1))), threads(threads) {}
+
+		void clear() {
+			keyframes.clear();
+			bytes = 0;
+			current = latest = 0;
+		}
+
+		//Call with the grid to start from, then after every frame it advanced. Frames after the current one
+		//are dropped, recording after a seek back continues from there
+		void record(const Grid& grid) {
+			if (!encoder || grid.x_s != header.width || grid.y_s != header.height) {
+				SnapshotConfig config;
+				header = snapshot_header(grid, config);
+				encoder = std::make_unique<SnapshotEncoder>(header, SnapshotCodec::Lossless, 0, 1, threads);
+				decoder = std::make_unique<SnapshotDecoder>(header, threads);
+				clear();
+			} else {
+				++current;
+			}
+
+			while (!keyframes.empty() && keyframes.back().frame >= current) {
+				bytes -= keyframes.back().payload.size();
+				keyframes.pop_back();
+			}
+			latest = current;
+
+			if (!keyframes.empty() && current - keyframes.back().frame < keyframe_interval)
+				return;
+
+			raw.resize(header.planes * header.width * header.height * header.storage_size);
+			encoded.resize(encoder->bound());
+			capture_snapshot(grid, header, raw.data());
+
+			Keyframe keyframe{ current };
+			keyframe.snapshot.raw_size = raw.size();
+			keyframe.payload.assign(encoded.data(), encoded.data() + encoder->encode(keyframe.snapshot, raw.data(), encoded.data()));
+			bytes += keyframe.payload.size();
+			keyframes.push_back(std::move(keyframe));
+
+			//The newest keyframe stays even when it alone is over budget
+			while (keyframes.size() > 1 && bytes > budget) {
+				bytes -= keyframes.front().payload.size();
+				keyframes.pop_front();
+			}
+		}
+
+		//Moves grid to frame, between first() and last(). Restores the keyframe before it unless the current
+		//frame is closer, then calls advance(grid) once per frame in between
+		template<typename Advance>
+		bool seek(Grid& grid, size_t frame, Advance&& advance) {
+			if (keyframes.empty() || frame < first() || frame > latest)
+				return false;
+
+			auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frame, [](size_t f, const Keyframe& keyframe) {
+				return f < keyframe.frame;
+			}) - 1;
+
+			if (frame < current || frame - current > frame - it->frame) {
+				raw.resize(it->snapshot.raw_size);
+				if (!decoder->decode(it->snapshot, it->payload.data(), raw.data()) || !load_snapshot(grid, header, raw.data()))
+					return false;
+				current = it->frame;
+			}
+
+			for (; current < frame; ++current)
+				advance(grid);
+			return true;
+		}
+
+		size_t frame() const { return current; }
+		//Oldest frame still restorable
+		size_t first() const { return keyframes.empty() ? 0 : keyframes.front().frame; }
+		//Newest frame recorded
+		size_t last() const { return latest; }
+		//Compressed size of the keyframes
+		size_t size() const { return bytes; }
+
+		const size_t budget;
+		const size_t keyframe_interval;
+		const size_t threads;
+
+	private:
+		struct Keyframe {
+			size_t frame;
+			SnapshotFrame snapshot{};
+			std::vector<char> payload;
+		};
+
+		SnapshotHeader header{};
+		std::unique_ptr<SnapshotEncoder> encoder;
+		std::unique_ptr<SnapshotDecoder> decoder;
+
+		std::deque<Keyframe> keyframes;
+		std::vector<char> raw;
+		std::vector<char> encoded;
+		size_t bytes{ 0 };
+		size_t current{ 0 };
+		size_t latest{ 0 };
+	};
+}
@@ -0,0 +1,18 @@
+#include "Riemann2Kernel.hpp"
+#include "Simd.hpp"
+
+using namespace WaveSimulation;
+
+Riemann2KernelInfo WaveSimulation::riemann2_kernel( Riemann2Storage storage ){
+#if defined( WAVESIM_X86_SIMD )
+	switch( active_simd_level() ){
+		case SimdLevel::AVX512: return { riemann2_row_avx512( storage ), 16 };
+		case SimdLevel::AVX2: return { riemann2_row_avx2( storage ), 8 };
+		case SimdLevel::SSE42: return { riemann2_row_sse42( storage ), 4 };
+		case SimdLevel::Scalar: break;
+	}
+#else
+	(void)storage;
+#endif
+	return {};
+}
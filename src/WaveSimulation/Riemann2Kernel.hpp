@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stddef.h>
+
+// Vectorized Riemann2Grid::step_finite_volume for interior cells.
+// The body is written once against a vector type V and instantiated per ISA in
+// Riemann2Kernel_<isa>.cpp, which are the only files compiled with the ISA flags.
+// Keep this header free of library includes: inline functions instantiated there
+// would be emitted with the wider ISA and could be picked by the linker for other callers.
+// The operations mirror the scalar path step for step and the ISA files disable fp
+// contraction, so every level produces the same values as the scalar reference.
+// The kernel always computes in float, the storage type of the planes is converted
+// on load and store by a second policy L, rounding like Half and BFloat16 in Precision.hpp.
+
+namespace WaveSimulation {
+	// Constants of the 2 point Gauss-Legendre element, computed like the scalar path
+	struct Riemann2Constants {
+		float interp0_w1, interp0_w2; //Extrapolation of a node pair to coordinate 0
+		float interp1_w1, interp1_w2; //and to coordinate 1
+		float base0_at0, base1_at0;   //Node basis functions on the face at 0
+		float base0_at1, base1_at1;   //and at 1
+		float minus_wdev;
+	};
+
+	// Element type of the planes
+	enum class Riemann2Storage {
+		F32,
+		F16,
+		BF16,
+	};
+
+	struct Riemann2KernelArgs {
+		const void* in[12]; //Planes of the Riemann2Storage the kernel was picked for
+		void* out[12];
+		const void* base[12]; //Runge-Kutta stage out = a * base + b * ( in + dt * L( in )), null for a forward Euler step. May be out
+		size_t pitch;
+		size_t origin; //Offset of cell ( 0, 0 ), cells are at in[n][origin + y * pitch + x]
+
+		float dt;         //Timestep over cell size
+		float a, b;       //Stage weights, only used with base
+		float K;          //K0
+		float R;          //onebyrho0
+		float minus_half_c; //-0.5 * sqrt( K0 * onebyrho0 )
+
+		Riemann2Constants k;
+	};
+
+	// Updates the cells [x0, x1) of row y, x1 - x0 has to be a multiple of the vector width.
+	// Neighbours outside the grid are read from the ghost cells
+	using Riemann2RowKernel = void (*)( const Riemann2KernelArgs& args, size_t y, size_t x0, size_t x1 );
+
+	struct Riemann2KernelInfo {
+		Riemann2RowKernel row{ nullptr };
+		size_t width{ 1 };
+	};
+
+	// Kernel for the active simd level and storage, row is null for the scalar level
+	// or when the level has no conversion for the storage
+	Riemann2KernelInfo riemann2_kernel( Riemann2Storage storage = Riemann2Storage::F32 );
+
+	Riemann2RowKernel riemann2_row_sse42( Riemann2Storage storage );
+	Riemann2RowKernel riemann2_row_avx2( Riemann2Storage storage );
+	Riemann2RowKernel riemann2_row_avx512( Riemann2Storage storage );
+
+	namespace detail {
+		// L::load( plane, i ) reads V::width values starting at element i of a plane, L::store( plane, i, v ) writes them
+		template<typename V, typename L>
+		struct Riemann2Kernel {
+			using reg = typename V::reg;
+
+			// (interp( a0, a1 ) + interp( b0, b1 )) * 0.5
+			static inline reg trace( reg a0, reg a1, reg b0, reg b1, reg w1, reg w2, reg half ){
+				reg ia = V::add( V::mul( w2, a1 ), V::mul( w1, a0 ));
+				reg ib = V::add( V::mul( w2, b1 ), V::mul( w1, b0 ));
+				return V::mul( V::add( ia, ib ), half );
+			}
+
+			static void row( const Riemann2KernelArgs& args, size_t y, size_t x0, size_t x1 ){
+				if( args.base[0] )
+					row_impl<true>( args, y, x0, x1 );
+				else
+					row_impl<false>( args, y, x0, x1 );
+			}
+
+			template<bool Stage>
+			static void row_impl( const Riemann2KernelArgs& args, size_t y, size_t x0, size_t x1 ){
+				const Riemann2Constants& k = args.k;
+
+				const reg half = V::set1( 0.5f );
+				const reg two = V::set1( 2.0f );
+				const reg dt = V::set1( args.dt );
+				const reg K = V::set1( args.K );
+				const reg R = V::set1( args.R );
+				const reg mhc = V::set1( args.minus_half_c );
+				const reg mw = V::set1( k.minus_wdev );
+				const reg wa = V::set1( args.a ), wb = V::set1( args.b );
+
+				const reg i0w1 = V::set1( k.interp0_w1 ), i0w2 = V::set1( k.interp0_w2 );
+				const reg i1w1 = V::set1( k.interp1_w1 ), i1w2 = V::set1( k.interp1_w2 );
+				const reg b00 = V::set1( k.base0_at0 ), b10 = V::set1( k.base1_at0 );
+				const reg b01 = V::set1( k.base0_at1 ), b11 = V::set1( k.base1_at1 );
+
+				//Face matrices scaled by the normal, rows are (R * n, -K * n) for the left and (R * n, K * n) for the right state
+				const reg Rn = V::set1( -args.R ), Rp = R;
+				const reg Kn = V::set1( -args.K );
+
+				const void* const* in = args.in;
+
+				for( size_t x = x0; x < x1; x += V::width ){
+					const size_t i = args.origin + y * args.pitch + x;
+					const size_t ixn = i - 1, ixp = i + 1, iyn = i - args.pitch, iyp = i + args.pitch;
+
+					reg p[4], u[4], v[4];
+					for( int n = 0; n < 4; ++n ){
+						p[n] = L::load( in[n], i );
+						u[n] = L::load( in[4 + n], i );
+						v[n] = L::load( in[8 + n], i );
+					}
+
+					reg fp[4], fu[4], fv[4];
+
+					//x-1, normal (-1, 0)
+					{
+						reg lp = trace( p[0], p[1], p[2], p[3], i0w1, i0w2, half );
+						reg lu = trace( u[0], u[1], u[2], u[3], i0w1, i0w2, half );
+						reg rp = trace( L::load( in[0], ixn ), L::load( in[1], ixn ), L::load( in[2], ixn ), L::load( in[3], ixn ), i1w1, i1w2, half );
+						reg ru = trace( L::load( in[4], ixn ), L::load( in[5], ixn ), L::load( in[6], ixn ), L::load( in[7], ixn ), i1w1, i1w2, half );
+
+						reg tx = V::add( V::mul( half, V::add( V::mul( Rn, lu ), V::mul( Rn, ru ))), V::mul( mhc, V::sub( lp, rp )));
+						reg ty = V::add( V::mul( half, V::add( V::mul( K, lp ), V::mul( Kn, rp ))), V::mul( mhc, V::sub( lu, ru )));
+
+						fp[0] = V::mul( b00, tx ); fp[1] = V::mul( b10, tx ); fp[2] = fp[0]; fp[3] = fp[1];
+						fu[0] = V::mul( b00, ty ); fu[1] = V::mul( b10, ty ); fu[2] = fu[0]; fu[3] = fu[1];
+					}
+
+					//x+1, normal (1, 0)
+					{
+						reg lp = trace( p[0], p[1], p[2], p[3], i1w1, i1w2, half );
+						reg lu = trace( u[0], u[1], u[2], u[3], i1w1, i1w2, half );
+						reg rp = trace( L::load( in[0], ixp ), L::load( in[1], ixp ), L::load( in[2], ixp ), L::load( in[3], ixp ), i0w1, i0w2, half );
+						reg ru = trace( L::load( in[4], ixp ), L::load( in[5], ixp ), L::load( in[6], ixp ), L::load( in[7], ixp ), i0w1, i0w2, half );
+
+						reg tx = V::add( V::mul( half, V::add( V::mul( Rp, lu ), V::mul( Rp, ru ))), V::mul( mhc, V::sub( lp, rp )));
+						reg ty = V::add( V::mul( half, V::add( V::mul( Kn, lp ), V::mul( K, rp ))), V::mul( mhc, V::sub( lu, ru )));
+
+						reg a = V::mul( b01, tx ), b = V::mul( b11, tx );
+						fp[0] = V::add( fp[0], a ); fp[1] = V::add( fp[1], b ); fp[2] = V::add( fp[2], a ); fp[3] = V::add( fp[3], b );
+						a = V::mul( b01, ty ); b = V::mul( b11, ty );
+						fu[0] = V::add( fu[0], a ); fu[1] = V::add( fu[1], b ); fu[2] = V::add( fu[2], a ); fu[3] = V::add( fu[3], b );
+					}
+
+					//y-1, normal (0, -1)
+					{
+						reg lp = trace( p[0], p[2], p[1], p[3], i0w1, i0w2, half );
+						reg lv = trace( v[0], v[2], v[1], v[3], i0w1, i0w2, half );
+						reg rp = trace( L::load( in[0], iyn ), L::load( in[2], iyn ), L::load( in[1], iyn ), L::load( in[3], iyn ), i1w1, i1w2, half );
+						reg rv = trace( L::load( in[8], iyn ), L::load( in[10], iyn ), L::load( in[9], iyn ), L::load( in[11], iyn ), i1w1, i1w2, half );
+
+						reg tx = V::add( V::mul( half, V::add( V::mul( Rn, lv ), V::mul( Rn, rv ))), V::mul( mhc, V::sub( lp, rp )));
+						reg tz = V::add( V::mul( half, V::add( V::mul( K, lp ), V::mul( Kn, rp ))), V::mul( mhc, V::sub( lv, rv )));
+
+						reg a = V::mul( b00, tx ), b = V::mul( b10, tx );
+						fp[0] = V::add( fp[0], a ); fp[1] = V::add( fp[1], a ); fp[2] = V::add( fp[2], b ); fp[3] = V::add( fp[3], b );
+						fv[0] = V::mul( b00, tz ); fv[1] = fv[0]; fv[2] = V::mul( b10, tz ); fv[3] = fv[2];
+					}
+
+					//y+1, normal (0, 1)
+					{
+						reg lp = trace( p[0], p[2], p[1], p[3], i1w1, i1w2, half );
+						reg lv = trace( v[0], v[2], v[1], v[3], i1w1, i1w2, half );
+						reg rp = trace( L::load( in[0], iyp ), L::load( in[2], iyp ), L::load( in[1], iyp ), L::load( in[3], iyp ), i0w1, i0w2, half );
+						reg rv = trace( L::load( in[8], iyp ), L::load( in[10], iyp ), L::load( in[9], iyp ), L::load( in[11], iyp ), i0w1, i0w2, half );
+
+						reg tx = V::add( V::mul( half, V::add( V::mul( Rp, lv ), V::mul( Rp, rv ))), V::mul( mhc, V::sub( lp, rp )));
+						reg tz = V::add( V::mul( half, V::add( V::mul( Kn, lp ), V::mul( K, rp ))), V::mul( mhc, V::sub( lv, rv )));
+
+						reg a = V::mul( b01, tx ), b = V::mul( b11, tx );
+						fp[0] = V::add( fp[0], a ); fp[1] = V::add( fp[1], a ); fp[2] = V::add( fp[2], b ); fp[3] = V::add( fp[3], b );
+						a = V::mul( b01, tz ); b = V::mul( b11, tz );
+						fv[0] = V::add( fv[0], a ); fv[1] = V::add( fv[1], a ); fv[2] = V::add( fv[2], b ); fv[3] = V::add( fv[3], b );
+					}
+
+					//Volume integral
+					reg r1x = V::mul( mw, V::add( V::mul( R, V::add( u[0], u[2] )), V::mul( R, V::add( u[1], u[3] ))));
+					reg r1y = V::mul( mw, V::sub( V::mul( K, V::add( p[0], p[2] )), V::mul( K, V::add( p[1], p[3] ))));
+					reg r2x = V::mul( mw, V::add( V::mul( R, V::add( v[0], v[1] )), V::mul( R, V::add( v[2], v[3] ))));
+					reg r2z = V::mul( mw, V::sub( V::mul( K, V::add( p[0], p[1] )), V::mul( K, V::add( p[2], p[3] ))));
+
+					reg vp[4] = {
+						V::neg( V::add( r1x, r2x )),
+						V::sub( r1x, r2x ),
+						V::sub( r2x, r1x ),
+						V::add( r1x, r2x ),
+					};
+
+					for( int n = 0; n < 4; ++n ){
+						reg res[3] = {
+							V::add( p[n], V::mul( V::add( V::mul( fp[n], two ), vp[n] ), dt )),
+							V::add( u[n], V::mul( V::add( V::mul( fu[n], two ), r1y ), dt )),
+							V::add( v[n], V::mul( V::add( V::mul( fv[n], two ), r2z ), dt )),
+						};
+
+						for( int c = 0; c < 3; ++c ){
+							const size_t plane = 4 * c + n;
+							if constexpr( Stage )
+								res[c] = V::add( V::mul( wa, L::load( args.base[plane], i )), V::mul( wb, res[c] ));
+							L::store( args.out[plane], i, res[c] );
+						}
+					}
+				}
+			}
+		};
+	}
+}
@@ -0,0 +1,63 @@
+#include "Riemann2Kernel.hpp"
+
+#include <immintrin.h>
+#include <stdint.h>
+
+using namespace WaveSimulation;
+
+namespace {
+	struct VecAvx2 {
+		using reg = __m256;
+		static constexpr size_t width = 8;
+
+		static inline reg load( const float* ptr ){ return _mm256_loadu_ps( ptr ); }
+		static inline void store( float* ptr, reg v ){ _mm256_storeu_ps( ptr, v ); }
+		static inline reg set1( float v ){ return _mm256_set1_ps( v ); }
+		static inline reg add( reg a, reg b ){ return _mm256_add_ps( a, b ); }
+		static inline reg sub( reg a, reg b ){ return _mm256_sub_ps( a, b ); }
+		static inline reg mul( reg a, reg b ){ return _mm256_mul_ps( a, b ); }
+		static inline reg neg( reg a ){ return _mm256_xor_ps( a, _mm256_set1_ps( -0.0f )); }
+	};
+
+	struct StorageF32 {
+		static inline __m256 load( const void* plane, size_t i ){ return VecAvx2::load( static_cast<const float*>( plane ) + i ); }
+		static inline void store( void* plane, size_t i, __m256 v ){ VecAvx2::store( static_cast<float*>( plane ) + i, v ); }
+	};
+
+	struct StorageF16 {
+		static inline __m256 load( const void* plane, size_t i ){
+			return _mm256_cvtph_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( static_cast<const uint16_t*>( plane ) + i )));
+		}
+
+		static inline void store( void* plane, size_t i, __m256 v ){
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( static_cast<uint16_t*>( plane ) + i ), _mm256_cvtps_ph( v, _MM_FROUND_TO_NEAREST_INT ));
+		}
+	};
+
+	//Upper half of the float bits, rounded to nearest even
+	struct StorageBF16 {
+		static inline __m256 load( const void* plane, size_t i ){
+			__m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i*>( static_cast<const uint16_t*>( plane ) + i ));
+			return _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_cvtepu16_epi32( h ), 16 ));
+		}
+
+		static inline void store( void* plane, size_t i, __m256 v ){
+			__m256i u = _mm256_castps_si256( v );
+			__m256i lsb = _mm256_and_si256( _mm256_srli_epi32( u, 16 ), _mm256_set1_epi32( 1 ));
+			u = _mm256_srli_epi32( _mm256_add_epi32( u, _mm256_add_epi32( lsb, _mm256_set1_epi32( 0x7fff ))), 16 );
+
+			//The pack works per 128 bit lane, the two low quadwords hold the 8 results
+			__m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi32( u, u ), 0x08 );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( static_cast<uint16_t*>( plane ) + i ), _mm256_castsi256_si128( packed ));
+		}
+	};
+}
+
+Riemann2RowKernel WaveSimulation::riemann2_row_avx2( Riemann2Storage storage ){
+	switch( storage ){
+		case Riemann2Storage::F32: return detail::Riemann2Kernel<VecAvx2, StorageF32>::row;
+		case Riemann2Storage::F16: return detail::Riemann2Kernel<VecAvx2, StorageF16>::row;
+		case Riemann2Storage::BF16: return detail::Riemann2Kernel<VecAvx2, StorageBF16>::row;
+	}
+	return nullptr;
+}
@@ -0,0 +1,60 @@
+#include "Riemann2Kernel.hpp"
+
+#include <immintrin.h>
+#include <stdint.h>
+
+using namespace WaveSimulation;
+
+namespace {
+	struct VecAvx512 {
+		using reg = __m512;
+		static constexpr size_t width = 16;
+
+		static inline reg load( const float* ptr ){ return _mm512_loadu_ps( ptr ); }
+		static inline void store( float* ptr, reg v ){ _mm512_storeu_ps( ptr, v ); }
+		static inline reg set1( float v ){ return _mm512_set1_ps( v ); }
+		static inline reg add( reg a, reg b ){ return _mm512_add_ps( a, b ); }
+		static inline reg sub( reg a, reg b ){ return _mm512_sub_ps( a, b ); }
+		static inline reg mul( reg a, reg b ){ return _mm512_mul_ps( a, b ); }
+		static inline reg neg( reg a ){ return _mm512_castsi512_ps( _mm512_xor_si512( _mm512_castps_si512( a ), _mm512_set1_epi32( static_cast<int>( 0x80000000u )))); }
+	};
+
+	struct StorageF32 {
+		static inline __m512 load( const void* plane, size_t i ){ return VecAvx512::load( static_cast<const float*>( plane ) + i ); }
+		static inline void store( void* plane, size_t i, __m512 v ){ VecAvx512::store( static_cast<float*>( plane ) + i, v ); }
+	};
+
+	struct StorageF16 {
+		static inline __m512 load( const void* plane, size_t i ){
+			return _mm512_cvtph_ps( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( static_cast<const uint16_t*>( plane ) + i )));
+		}
+
+		static inline void store( void* plane, size_t i, __m512 v ){
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>( static_cast<uint16_t*>( plane ) + i ), _mm512_cvtps_ph( v, _MM_FROUND_TO_NEAREST_INT ));
+		}
+	};
+
+	//Upper half of the float bits, rounded to nearest even
+	struct StorageBF16 {
+		static inline __m512 load( const void* plane, size_t i ){
+			__m256i h = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( static_cast<const uint16_t*>( plane ) + i ));
+			return _mm512_castsi512_ps( _mm512_slli_epi32( _mm512_cvtepu16_epi32( h ), 16 ));
+		}
+
+		static inline void store( void* plane, size_t i, __m512 v ){
+			__m512i u = _mm512_castps_si512( v );
+			__m512i lsb = _mm512_and_si512( _mm512_srli_epi32( u, 16 ), _mm512_set1_epi32( 1 ));
+			u = _mm512_srli_epi32( _mm512_add_epi32( u, _mm512_add_epi32( lsb, _mm512_set1_epi32( 0x7fff ))), 16 );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>( static_cast<uint16_t*>( plane ) + i ), _mm512_cvtepi32_epi16( u ));
+		}
+	};
+}
+
+Riemann2RowKernel WaveSimulation::riemann2_row_avx512( Riemann2Storage storage ){
+	switch( storage ){
+		case Riemann2Storage::F32: return detail::Riemann2Kernel<VecAvx512, StorageF32>::row;
+		case Riemann2Storage::F16: return detail::Riemann2Kernel<VecAvx512, StorageF16>::row;
+		case Riemann2Storage::BF16: return detail::Riemann2Kernel<VecAvx512, StorageBF16>::row;
+	}
+	return nullptr;
+}
@@ -0,0 +1,51 @@
+#include "Riemann2Kernel.hpp"
+
+#include <nmmintrin.h>
+#include <stdint.h>
+
+using namespace WaveSimulation;
+
+namespace {
+	struct VecSse42 {
+		using reg = __m128;
+		static constexpr size_t width = 4;
+
+		static inline reg load( const float* ptr ){ return _mm_loadu_ps( ptr ); }
+		static inline void store( float* ptr, reg v ){ _mm_storeu_ps( ptr, v ); }
+		static inline reg set1( float v ){ return _mm_set1_ps( v ); }
+		static inline reg add( reg a, reg b ){ return _mm_add_ps( a, b ); }
+		static inline reg sub( reg a, reg b ){ return _mm_sub_ps( a, b ); }
+		static inline reg mul( reg a, reg b ){ return _mm_mul_ps( a, b ); }
+		static inline reg neg( reg a ){ return _mm_xor_ps( a, _mm_set1_ps( -0.0f )); }
+	};
+
+	struct StorageF32 {
+		static inline __m128 load( const void* plane, size_t i ){ return VecSse42::load( static_cast<const float*>( plane ) + i ); }
+		static inline void store( void* plane, size_t i, __m128 v ){ VecSse42::store( static_cast<float*>( plane ) + i, v ); }
+	};
+
+	//Upper half of the float bits, rounded to nearest even
+	struct StorageBF16 {
+		static inline __m128 load( const void* plane, size_t i ){
+			__m128i h = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( static_cast<const uint16_t*>( plane ) + i ));
+			return _mm_castsi128_ps( _mm_slli_epi32( _mm_cvtepu16_epi32( h ), 16 ));
+		}
+
+		static inline void store( void* plane, size_t i, __m128 v ){
+			__m128i u = _mm_castps_si128( v );
+			__m128i lsb = _mm_and_si128( _mm_srli_epi32( u, 16 ), _mm_set1_epi32( 1 ));
+			u = _mm_srli_epi32( _mm_add_epi32( u, _mm_add_epi32( lsb, _mm_set1_epi32( 0x7fff ))), 16 );
+			_mm_storel_epi64( reinterpret_cast<__m128i*>( static_cast<uint16_t*>( plane ) + i ), _mm_packus_epi32( u, u ));
+		}
+	};
+}
+
+//No half conversion instructions below F16C, F16 stays scalar
+Riemann2RowKernel WaveSimulation::riemann2_row_sse42( Riemann2Storage storage ){
+	switch( storage ){
+		case Riemann2Storage::F32: return detail::Riemann2Kernel<VecSse42, StorageF32>::row;
+		case Riemann2Storage::BF16: return detail::Riemann2Kernel<VecSse42, StorageBF16>::row;
+		case Riemann2Storage::F16: break;
+	}
+	return nullptr;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cmath>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace WaveSimulation {
+	// Axis aligned face normals, XNeg is the face towards x - 1
+	enum class Direction {
+		XNeg,
+		XPos,
+		YNeg,
+		YPos,
+	};
+
+	// Upwind flux of the acoustic equations for the state (p, ux, uy).
+	// update() rebuilds the constants when the material changed, flux<D>() is the flux matrix
+	// product of solveRiemann written out for one normal, so only the non zero entries remain.
+	// T is the compute type of the grid
+	template<typename T = float>
+	struct RiemannSolver {
+		using vec3 = glm::vec<3, T>;
+
+		double K0{ 0 };
+		double onebyrho0{ 0 };
+
+		T K{ 0 };
+		T R{ 0 };               //onebyrho0
+		T minus_half_c{ -0.0f }; //-0.5 * sqrt( K0 * onebyrho0 )
+
+		inline void update( double K0_, double onebyrho0_ ){
+			if( K0_ == K0 && onebyrho0_ == onebyrho0 )
+				return;
+
+			K0 = K0_;
+			onebyrho0 = onebyrho0_;
+
+			K = K0;
+			R = onebyrho0;
+			T c = std::sqrt( K0 * onebyrho0 );
+			minus_half_c = T( -0.5 ) * c;
+		}
+
+		template<Direction D>
+		inline vec3 flux( const vec3& left, const vec3& right ) const {
+			constexpr bool x_face = D == Direction::XNeg || D == Direction::XPos;
+			constexpr T n = D == Direction::XNeg || D == Direction::YNeg ? -1 : 1;
+			constexpr int u = x_face ? 1 : 2; //Velocity component along the normal
+
+			const T Rn = n * R;
+			const T Kn = n * K;
+
+			vec3 res( 0 );
+			res.x = T( 0.5 ) * ( Rn * left[u] + Rn * right[u] ) + minus_half_c * ( left.x - right.x );
+			res[u] = T( 0.5 ) * ( -Kn * left.x + Kn * right.x ) + minus_half_c * ( left[u] - right[u] );
+			return res;
+		}
+
+		// Normal has to be one of the four axis directions
+		inline vec3 flux( const vec3& left, const vec3& right, glm::vec2 normal ) const {
+			if( normal.x < 0 )
+				return flux<Direction::XNeg>( left, right );
+			if( normal.x > 0 )
+				return flux<Direction::XPos>( left, right );
+			if( normal.y < 0 )
+				return flux<Direction::YNeg>( left, right );
+			return flux<Direction::YPos>( left, right );
+		}
+	};
+}
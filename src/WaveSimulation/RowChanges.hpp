@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace WaveSimulation {
+	// Rows of values written since a reader last looked, so a viewer only regenerates what changed. Every write
+	// bumps generation and stamps the rows it touched with it, a reader keeps the generation it last read at
+	struct RowChanges {
+		uint64_t generation{ 1 };
+		std::vector<uint64_t> rows; //Generation of the last write per row
+
+		//Every row counts as written
+		inline void resize( size_t y_size ){
+			rows.assign( y_size, ++generation );
+		}
+
+		//Rows [y0, y1) were written
+		inline void mark( size_t y0, size_t y1 ){
+			++generation;
+			for( size_t y = y0; y < y1 && y < rows.size(); ++y )
+				rows[y] = generation;
+		}
+
+		// func( y0, y1 ) for every run of rows written after generation seen
+		template<typename Func>
+		void for_each_range( uint64_t seen, Func&& func ) const {
+			for( size_t y = 0; y < rows.size(); ){
+				if( rows[y] <= seen ){
+					++y;
+					continue;
+				}
+
+				size_t end = y + 1;
+				while( end < rows.size() && rows[end] > seen )
+					++end;
+
+				func( y, end );
+				y = end;
+			}
+		}
+	};
+}
@@ -0,0 +1,98 @@
+#include "Simd.hpp"
+
+#include <stdint.h>
+
+#if defined( WAVESIM_X86_SIMD )
+	#if defined( _MSC_VER )
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+using namespace WaveSimulation;
+
+#if defined( WAVESIM_X86_SIMD )
+static void cpuid( unsigned leaf, unsigned subleaf, unsigned regs[4] ){
+#if defined( _MSC_VER )
+	int r[4];
+	__cpuidex( r, leaf, subleaf );
+	for( int i = 0; i < 4; ++i )
+		regs[i] = r[i];
+#else
+	__cpuid_count( leaf, subleaf, regs[0], regs[1], regs[2], regs[3] );
+#endif
+}
+
+static uint64_t xgetbv0(){
+#if defined( _MSC_VER )
+	return _xgetbv( 0 );
+#else
+	uint32_t eax, edx;
+	__asm__ volatile( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ));
+	return ( static_cast<uint64_t>( edx ) << 32 ) | eax;
+#endif
+}
+#endif
+
+SimdLevel WaveSimulation::detect_simd_level(){
+#if defined( WAVESIM_X86_SIMD )
+	unsigned regs[4];
+
+	cpuid( 0, 0, regs );
+	unsigned max_leaf = regs[0];
+
+	cpuid( 1, 0, regs );
+	bool sse42 = regs[2] & ( 1u << 20 );
+	bool osxsave = regs[2] & ( 1u << 27 );
+	bool avx = regs[2] & ( 1u << 28 );
+	bool f16c = regs[2] & ( 1u << 29 ); //Half conversions of the AVX2 and AVX512 kernels
+
+	if( !sse42 )
+		return SimdLevel::Scalar;
+
+	//The os has to save the ymm/zmm registers on context switches
+	uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+	bool ymm_state = ( xcr0 & 0x6 ) == 0x6;
+	bool zmm_state = ( xcr0 & 0xe6 ) == 0xe6;
+
+	if( max_leaf < 7 || !avx || !f16c || !ymm_state )
+		return SimdLevel::SSE42;
+
+	cpuid( 7, 0, regs );
+	bool avx2 = regs[1] & ( 1u << 5 );
+	bool avx512f = regs[1] & ( 1u << 16 );
+
+	if( avx512f && zmm_state )
+		return SimdLevel::AVX512;
+	if( avx2 )
+		return SimdLevel::AVX2;
+	return SimdLevel::SSE42;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+static SimdLevel& simd_level_storage(){
+	static SimdLevel level = detect_simd_level();
+	return level;
+}
+
+SimdLevel WaveSimulation::active_simd_level(){
+	return simd_level_storage();
+}
+
+void WaveSimulation::set_simd_level( SimdLevel level ){
+	SimdLevel detected = detect_simd_level();
+	simd_level_storage() = level < detected ? level : detected;
+}
+
+const char* WaveSimulation::simd_level_name( SimdLevel level ){
+	switch( level ){
+		case SimdLevel::Scalar: return "scalar";
+		case SimdLevel::SSE42: return "sse4.2";
+		case SimdLevel::AVX2: return "avx2";
+		case SimdLevel::AVX512: return "avx512";
+	}
+	return "unknown";
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace WaveSimulation {
+	enum class SimdLevel {
+		Scalar,
+		SSE42,
+		AVX2,
+		AVX512,
+	};
+
+	// Highest level supported by the cpu and os, queried with cpuid once
+	SimdLevel detect_simd_level();
+
+	// Level the kernels dispatch to, defaults to detect_simd_level()
+	SimdLevel active_simd_level();
+
+	// Force a lower level, e.g. to compare against the scalar reference. Clamped to the detected level
+	void set_simd_level( SimdLevel level );
+
+	const char* simd_level_name( SimdLevel level );
+}
@@ -1,6 +1,8 @@
 #include "SimpleGrid.hpp"
+#include "TemporalBlocking.hpp"
 
 #include "stb_image.h"
+#include <algorithm>
 #include <glm/ext/matrix_float3x3.hpp>
 #include <glm/geometric.hpp>
 #include <iostream>
@@ -9,55 +11,66 @@
 #include <glm/vec3.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <utility>
-#include <vulkan/vulkan_core.h>
 
 using namespace WaveSimulation;
 
-void SimpleGrid::init( const char* start_condition ){
+template<typename Precision>
+bool SimpleGrid<Precision>::init( const char* start_condition ){
 	int width, height, channels;
 
 	stbi_uc* data = stbi_load( start_condition, &width, &height, &channels, STBI_grey );
 
 	if( !data ){
 		std::cout << "Failed to load texture " << start_condition << " because of: " << stbi_failure_reason() << std::endl;
-		return;
+		return false;
 	}
 
 	int res = 4;
 
-	x_s = width / res;
-	y_s = height / res;
-
-	values.resize( x_s * y_s );
-
-	/*
-	for( size_t i = 0; i < x_s * y_s; ++i )
-		values[i] = glm::vec3( data[i] / 255.0, 0, 0 );
-	*/
+	resize( width / res, height / res );
 
 	for(size_t iy = 0; iy < y_s; ++iy){
 		for( size_t ix = 0; ix < x_s; ++ix){
-			values[iy * x_s + ix] = glm::vec3(data[iy * res * x_s * res + ix * res] / 255.0f, 0, 0);
+			set( ix, iy, vec3(data[iy * res * x_s * res + ix * res] / 255.0f, 0, 0));
 		}
 	}
 
-	nval.resize( values.size() );
-
 	stbi_image_free( data );
+
+	return true;
+}
+
+template<typename Precision>
+void SimpleGrid<Precision>::resize( size_t x_size, size_t y_size, size_t ghost_width ){
+	x_s = x_size;
+	y_s = y_size;
+
+	ghost_width = ghost_width ? ghost_width : 1;
+
+	values.resize( x_s, y_s, ghost_width );
+	nval.resize( x_s, y_s, ghost_width );
+	changes.resize( y_s );
 }
 
-size_t SimpleGrid::get_buffer_float_amount(){
+template<typename Precision>
+size_t SimpleGrid<Precision>::get_buffer_float_amount(){
 	return (x_s - 1) * (y_s - 1) * 36;
 }
 
-void SimpleGrid::fill_buffer( float* buffer, bool drawU ){
+template<typename Precision>
+void SimpleGrid<Precision>::fill_buffer( float* buffer, bool drawU ){
+	fill_buffer( buffer, drawU, 0, y_s - 1 );
+}
+
+template<typename Precision>
+void SimpleGrid<Precision>::fill_buffer( float* buffer, bool drawU, size_t y0, size_t y1 ){
 	constexpr float yscale = 0.3;
 	const float xscale = 2.0 / x_s;
 	const float zscale = 2.0 / y_s;
 
-	size_t index = 0;
+	size_t index = y0 * ( x_s - 1 ) * 36;
 
-	for( size_t y = 0; y < y_s - 1; ++y ){
+	for( size_t y = y0; y < std::min( y1, y_s - 1 ); ++y ){
 		for( size_t x = 0; x < x_s - 1; ++x ){
 			float dx1, dy1, dx2, dy2;
 			if (drawU) {
@@ -135,134 +148,185 @@ void SimpleGrid::fill_buffer( float* buffer, bool drawU ){
 	}
 }
 
-VertexInputDescription SimpleGrid::get_vk_description(){
-	VertexInputDescription desc;
-
-	desc.bindings.emplace_back( VkVertexInputBindingDescription{
-			.binding = 0,
-			.stride = 6 * sizeof( float ),
-			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-		});
-
-	desc.attributes.emplace_back( VkVertexInputAttributeDescription{
-			.location = 0,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = 0,
-		});
-
-	desc.attributes.emplace_back( VkVertexInputAttributeDescription{
-			.location = 1,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = 3 * sizeof( float ),
-		});
-
-	return desc;
+template<typename Precision>
+void SimpleGrid<Precision>::fill_heights( float* buffer, bool drawU ) const {
+	fill_heights( buffer, drawU, 0, y_s );
 }
 
-void SimpleGrid::update_ghosts( void (*func)( glm::vec3&, size_t, size_t )){
-	for( size_t x = 0; x < x_s; ++x ){
-		func( (*this)[0][x], x, 0 );
-		func( (*this)[y_s - 1][x], x, y_s - 1 );
-	}
+template<typename Precision>
+void SimpleGrid<Precision>::fill_heights( float* buffer, bool drawU, size_t y0, size_t y1 ) const {
+	for( size_t y = y0; y < std::min( y1, y_s ); ++y )
+		for( size_t x = 0; x < x_s; ++x )
+			buffer[x + y * x_s] = drawU ? (*this)[y][x].y : (*this)[y][x].x;
+}
 
-	for( size_t y = 1; y < y_s - 1; ++y ){
-		func( (*this)[y][0], y, 0 );
-		func( (*this)[y][x_s - 1], y, x_s - 1 );
-	}
+template<typename Precision>
+void SimpleGrid<Precision>::ghost_cell( Field& field, BoundaryPolicy boundary, size_t x, size_t y, size_t src_x, size_t src_y, Axis axis ){
+	vec3 cell = load( field, field.index( src_x, src_y ));
+
+	//Wall: the velocity through it is mirrored
+	if( boundary == BoundaryPolicy::Reflective )
+		cell[axis == Axis::X ? UX : UY] *= -1;
+
+	store( field, field.index( x, y ), cell );
 }
 
-void SimpleGrid::step_finite_difference( double dt ){
-	for( size_t x = 0; x < x_s; ++x ){
-		for( size_t y = 0; y < y_s; ++y ){
-			size_t xn = x ? x - 1 : 0;
-			size_t yn = y ? y - 1 : 0;
-			size_t xp = x != x_s - 1 ? x + 1 : x;
-			size_t yp = y != y_s - 1 ? y + 1 : y;
-
-#define IDX( x, y ) ((y) * x_s + (x))
-			//TODO 2d velocity
-			nval[IDX( x, y )] = glm::vec3(
-					values[IDX( x, y )].x - K0 * ( values[IDX(xp, y)].y - values[IDX(xn, y)].y +
-						values[IDX( x,yp)].y - values[IDX( x,yn)].y ) * 0.5 * dt,
-					values[IDX( x, y )].y - onebyrho0 * ( values[IDX(xp, y)].x - values[IDX(xn, y)].x +
-						values[IDX( x,yp)].x - values[IDX( x,yn)].x ) * 0.5 * dt,
-					0
-				);
-		}
-	}
+template<typename Precision>
+void SimpleGrid<Precision>::update_ghosts(){
+	for_each_ghost( x_s, y_s, values.halo, boundary, [this]( size_t x, size_t y, size_t src_x, size_t src_y, Axis axis ){
+		ghost_cell( values, boundary, x, y, src_x, src_y, axis );
+	});
+}
+
+template<typename Precision>
+void SimpleGrid<Precision>::step_finite_difference( double dt ){
+	update_ghosts();
+
+	for_each_tile( x_s, y_s, tiles, [this, dt]( const Tile& tile ){
+		finite_difference_region( values, nval, tile, dt );
+	});
 
 	std::swap( values, nval );
+	changes.mark( 0, y_s );
 }
 
-void SimpleGrid::step_finite_volume( double dt ){
-	float distance = std::sqrt(K0 * onebyrho0) * dt * 10;
+#define IDX( x, y ) in.index( x, y )
+template<typename Precision>
+void SimpleGrid<Precision>::finite_difference_region( const Field& in, Field& out, const Tile& region, double dt ) const {
+	const S* ps = in.plane( P );
+	const S* us = in.plane( UX );
+	S* np = out.plane( P );
+	S* nu = out.plane( UX );
+	S* nuy = out.plane( UY );
+
+	auto p = [ps]( size_t i ){ return T( ps[i] ); };
+	auto u = [us]( size_t i ){ return T( us[i] ); };
+
+	for_each_cell( region, [&]( size_t x, size_t y ){
+		//TODO 2d velocity
+		np[IDX( x, y )] = S( T( p( IDX( x, y )) - K0 * ( u( IDX(x + 1, y)) - u( IDX(x - 1, y)) +
+				u( IDX( x,y + 1)) - u( IDX( x,y - 1)) ) * 0.5 * dt ));
+		nu[IDX( x, y )] = S( T( u( IDX( x, y )) - onebyrho0 * ( p( IDX(x + 1, y)) - p( IDX(x - 1, y)) +
+				p( IDX( x,y + 1)) - p( IDX( x,y - 1)) ) * 0.5 * dt ));
+		nuy[IDX( x, y )] = S( 0.0f );
+	});
+}
 
-	for( size_t x = 0; x < x_s; ++x ){
-		for( size_t y = 0; y < y_s; ++y ){
-			size_t xn = x ? x - 1 : 0;
-			size_t yn = y ? y - 1 : 0;
-			size_t xp = x != x_s - 1 ? x + 1 : x;
-			size_t yp = y != y_s - 1 ? y + 1 : y;
+template<typename Precision>
+void SimpleGrid<Precision>::step_finite_volume( double dt ){
+	solver.update( K0, onebyrho0 );
+	update_ghosts();
 
-			nval[IDX( x, y )] = values[IDX(x, y)];
+	for_each_tile( x_s, y_s, tiles, [this, dt]( const Tile& tile ){
+		finite_volume_region( values, nval, tile, dt );
+	});
 
-			glm::vec3 temp;
+	std::swap( values, nval );
+	changes.mark( 0, y_s );
+}
 
-			//x-1
-			if( xn != x ){
-				temp = solveRiemann(x, y, xn, y, dt, glm::vec2( -1, 0 ));
-				nval[IDX(x, y)] += temp * distance;
-			}
-			//x+1
-			if( xp != x ){
-				temp = solveRiemann(x, y, xp, y, dt, glm::vec2( 1, 0 ));
-				nval[IDX(x, y)] += temp * distance;
-			}
-			//y-1
-			if( yn != y ){
-				temp = solveRiemann(x, y, x, yn, dt, glm::vec2( 0, -1 ));
-				nval[IDX(x, y)] += temp * distance;
-			}
-			//y+1
-			if( yp != y ){
-				temp = solveRiemann(x, y, x, yp, dt, glm::vec2( 0, 1 ));
-				nval[IDX(x, y)] += temp * distance;
-			}
+template<typename Precision>
+void SimpleGrid<Precision>::finite_volume_region( const Field& in, Field& out, const Tile& region, double dt ) const {
+	T distance = std::sqrt(K0 * onebyrho0) * dt * 10;
 
-		}
+	for_each_cell( region, [&]( size_t x, size_t y ){
+		const vec3 curr = load( in, IDX( x, y ));
+		vec3 next = curr;
+
+		next += solver.template flux<Direction::XNeg>( curr, load( in, IDX( x - 1, y ))) * distance;
+		next += solver.template flux<Direction::XPos>( curr, load( in, IDX( x + 1, y ))) * distance;
+		next += solver.template flux<Direction::YNeg>( curr, load( in, IDX( x, y - 1 ))) * distance;
+		next += solver.template flux<Direction::YPos>( curr, load( in, IDX( x, y + 1 ))) * distance;
+
+		store( out, IDX( x, y ), next );
+	});
+}
+#undef IDX
+
+template<typename Precision>
+void SimpleGrid<Precision>::step_finite_difference_blocked( double dt, size_t steps, size_t depth ){
+	depth = std::min( { depth ? depth : 1, x_s, y_s } );
+
+	for( size_t done = 0; done < steps; done += depth ){
+		size_t block = std::min( depth, steps - done );
+
+		update_ghosts();
+		step_temporal_block( values, nval, x_s, y_s, tiles, boundary, block,
+			[this, dt]( const Field& in, Field& out, const Tile& region ){
+				finite_difference_region( in, out, region, dt );
+			},
+			[this]( Field& field, size_t x, size_t y, size_t src_x, size_t src_y, Axis axis ){
+				ghost_cell( field, boundary, x, y, src_x, src_y, axis );
+			});
+
+		std::swap( values, nval );
 	}
 
-	std::swap( values, nval );
+	changes.mark( 0, y_s );
 }
 
-glm::vec3 SimpleGrid::solveRiemann( size_t xl, size_t yl, size_t xr, size_t yr, double dT, glm::vec2 normal ){
+template<typename Precision>
+void SimpleGrid<Precision>::step_finite_volume_blocked( double dt, size_t steps, size_t depth ){
+	depth = std::min( { depth ? depth : 1, x_s, y_s } );
+	solver.update( K0, onebyrho0 );
 
-	float c = std::sqrt( K0 * onebyrho0 );
+	for( size_t done = 0; done < steps; done += depth ){
+		size_t block = std::min( depth, steps - done );
 
-	glm::mat3 F =
-		glm::mat3( 
+		update_ghosts();
+		step_temporal_block( values, nval, x_s, y_s, tiles, boundary, block,
+			[this, dt]( const Field& in, Field& out, const Tile& region ){
+				finite_volume_region( in, out, region, dt );
+			},
+			[this]( Field& field, size_t x, size_t y, size_t src_x, size_t src_y, Axis axis ){
+				ghost_cell( field, boundary, x, y, src_x, src_y, axis );
+			});
+
+		std::swap( values, nval );
+	}
+
+	changes.mark( 0, y_s );
+}
+
+#define IDX( x, y ) values.index( x, y )
+template<typename Precision>
+auto SimpleGrid<Precision>::solveRiemann( size_t xl, size_t yl, size_t xr, size_t yr, [[maybe_unused]] double dT, glm::vec2 normal ) -> vec3 {
+
+	using mat3 = glm::mat<3, 3, T>;
+
+	T c = std::sqrt( K0 * onebyrho0 );
+
+	mat3 F =
+		mat3( 
 			0, K0, 0, 
 			onebyrho0, 0, 0, 
-			0, 0, 0 ) * normal.x +
-		glm::mat3(
+			0, 0, 0 ) * T( normal.x ) +
+		mat3(
 			0, 0, K0,
 			0, 0, 0,
-			onebyrho0, 0, 0 ) * normal.y;
+			onebyrho0, 0, 0 ) * T( normal.y );
+
+	vec3 left = load( values, IDX( xl, yl ));
+	vec3 right = load( values, IDX( xr, yr ));
 
-	glm::vec3 Fm = F * values[IDX( xl, yl )];
-	glm::vec3 Fp = F * values[IDX( xr, yr )];
+	vec3 Fm = F * left;
+	vec3 Fp = F * right;
 
 	Fm.y *= -1;
 	Fm.z *= -1;
 
-	auto upwind = -0.5f * c * ( values[IDX( xl, yl )] - values[IDX( xr, yr )]);
+	auto upwind = T( -0.5 ) * c * ( left - right );
 
 	if( normal.x == 0.0f )
 		upwind.y = 0;
 	else
 		upwind.z = 0;
 
-	return 0.5f * ( Fm + Fp ) + upwind;
+	return T( 0.5 ) * ( Fm + Fp ) + upwind;
 }
+
+template struct WaveSimulation::SimpleGrid<Fp64>;
+template struct WaveSimulation::SimpleGrid<Fp32>;
+template struct WaveSimulation::SimpleGrid<Fp16>;
+template struct WaveSimulation::SimpleGrid<Bf16>;
+
@@ -1,26 +1,77 @@
 #pragma once
 
+#include <array>
 #include <stddef.h>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
-#include "Core/VkMesh.hpp"
+#include <glm/vec4.hpp>
+#include "Activity.hpp"
+#include "Boundary.hpp"
+#include "GaussLegendre.hpp"
+#include "GridStorage.hpp"
+#include "Precision.hpp"
+#include "RiemannSolver.hpp"
+#include "RowChanges.hpp"
+#include "Tiling.hpp"
+#include "TimeIntegration.hpp"
 
 namespace WaveSimulation {
 	// Accessed with SimpleGrid[y][x]
+	// Stored as the planes p, ux, uy in Precision::storage, stepped in Precision::compute (see Precision.hpp)
+	template<typename Precision = Fp32>
 	struct SimpleGrid {
-		void init( const char* start_condition = nullptr );
+		using Policy = Precision;
+		using T = typename Precision::compute;
+		using S = typename Precision::storage;
+		using vec3 = glm::vec<3, T>;
+		using Field = SoAField<S, 3>;
+
+		static constexpr size_t P = 0, UX = 1, UY = 2;
+
+		struct Row {
+			const SimpleGrid* grid;
+			size_t y;
+
+			inline vec3 operator[]( size_t x ) const {
+				return grid->get( x, y );
+			}
+		};
+
+		bool init( const char* start_condition = nullptr );
+		//Allocates a zeroed x_size * y_size grid with ghost_width ghost layers, cells can then be written with set()
+		void resize( size_t x_size, size_t y_size, size_t ghost_width = 1 );
 		size_t get_buffer_float_amount();
 		void fill_buffer( float* buffer, bool drawU );
+		//Only the quads of rows [y0, y1) at their place in buffer. Quad row y is drawn from cell rows y and y + 1,
+		//so the rows changes marked since the buffer was last filled need rewriting from one row above them
+		void fill_buffer( float* buffer, bool drawU, size_t y0, size_t y1 );
+		//One height per cell for a static indexed mesh, the vertex shader places the nodes and derives the normals
+		size_t get_height_amount() const { return x_s * y_s; }
+		void fill_heights( float* buffer, bool drawU ) const;
+		void fill_heights( float* buffer, bool drawU, size_t y0, size_t y1 ) const;
 		
-		void update_ghosts( void(*)( glm::vec3& cell, size_t x, size_t y ));
+		//Fills the ghost layers from the interior according to boundary, done at the start of every step
+		void update_ghosts();
 
 		//Central difference d2x d2y forward difference d2t
 		void step_finite_difference( double dt );
 		void step_finite_volume( double dt );
 
+		//steps single steps, depth of them at a time per tile (see TemporalBlocking.hpp). Same result as calling the above steps times
+		void step_finite_difference_blocked( double dt, size_t steps, size_t depth = 8 );
+		void step_finite_volume_blocked( double dt, size_t steps, size_t depth = 8 );
+
+		//Advance the cells of region from in to out, the neighbours of the region have to be valid in in
+		void finite_difference_region( const Field& in, Field& out, const Tile& region, double dt ) const;
+		void finite_volume_region( const Field& in, Field& out, const Tile& region, double dt ) const;
+
+		//Ghost cell ( x, y ) of field from the interior cell ( src_x, src_y ) behind the boundary axis
+		static void ghost_cell( Field& field, BoundaryPolicy boundary, size_t x, size_t y, size_t src_x, size_t src_y, Axis axis );
+
 		//FV / DG
-		glm::vec3 solveRiemann( size_t xl, size_t yl, size_t xr, size_t yr, double dT, glm::vec2 normal );
+		//Generic flux for any normal, the steppers use the specialized solver.flux<Direction>()
+		vec3 solveRiemann( size_t xl, size_t yl, size_t xr, size_t yr, double dT, glm::vec2 normal );
 
 		size_t x_s{ 2 };
 		size_t y_s{ 2 };
@@ -28,50 +79,249 @@ namespace WaveSimulation {
 		double K0{ 0.25 };
 		double onebyrho0{ 1 };
 
+		TileConfig tiles;
+		BoundaryPolicy boundary{ BoundaryPolicy::Reflective };
+		RiemannSolver<T> solver; //Rebuilt from K0 and onebyrho0 at the start of every step if they changed
+		RowChanges changes; //Rows of values every write touched, see fill_buffer()
+
 		//std::vector<double> oval;   //t - dt
-		std::vector<glm::vec3> values; //t
-		std::vector<glm::vec3> nval;   //t + dt
+		Field values; //t
+		Field nval;   //t + dt
+
+		static inline vec3 load( const Field& field, size_t i ){
+			return vec3( T( field.plane( P )[i] ), T( field.plane( UX )[i] ), T( field.plane( UY )[i] ));
+		}
+
+		static inline void store( Field& field, size_t i, const vec3& cell ){
+			field.plane( P )[i] = S( cell.x );
+			field.plane( UX )[i] = S( cell.y );
+			field.plane( UY )[i] = S( cell.z );
+		}
+
+		inline vec3 get( size_t x, size_t y ) const {
+			return load( values, values.index( x, y ));
+		}
 
-		inline glm::vec3* operator[]( size_t y ){
-			return &values[ y * x_s ];
+		inline void set( size_t x, size_t y, const vec3& cell ){
+			store( values, values.index( x, y ), cell );
+			changes.mark( y, y + 1 );
 		}
 
-		static VertexInputDescription get_vk_description();
+		inline Row operator[]( size_t y ) const {
+			return Row{ this, y };
+		}
 	};
 
+	// Node values of an element of order Order, node i + (Order + 1) * j sits at (x_i, y_j)
+	template<typename T = float, size_t Order = 1>
 	struct Riemann2Cell {
-		glm::vec4 p;
-		glm::vec4 ux;
-		glm::vec4 uy;
+		std::array<T, (Order + 1) * (Order + 1)> p;
+		std::array<T, (Order + 1) * (Order + 1)> ux;
+		std::array<T, (Order + 1) * (Order + 1)> uy;
+	};
+
+	// Order 1 keeps its four nodes in glm vectors
+	template<typename T>
+	struct Riemann2Cell<T, 1> {
+		glm::vec<4, T> p;
+		glm::vec<4, T> ux;
+		glm::vec<4, T> uy;
 	};
 
+	// Nodal DG on elements of polynomial order Order with (Order + 1)^2 Gauss-Legendre nodes (see GaussLegendre.hpp)
+	// Stored as one plane per variable and node, node n of p is plane P + n
+	// Order 1 nodes are ordered (x0, y0), (x1, y0), (x0, y1), (x1, y1). Its faces pass the mean of the trace along
+	// the face to the Riemann solver, higher orders solve one flux per face node.
+	// The simd kernels cover order 1 on the float computing policies, everything else runs scalar
+	template<typename Precision = Fp32, size_t Order = 1>
 	struct Riemann2Grid {
-		void init(const char* start_condition = nullptr);
+		using Policy = Precision;
+		using T = typename Precision::compute;
+		using S = typename Precision::storage;
+		using vec3 = glm::vec<3, T>;
+		using vec4 = glm::vec<4, T>;
+		using Cell = Riemann2Cell<T, Order>;
+		using Element = GaussLegendre<Order, T>;
+
+		static constexpr size_t order = Order;
+		static constexpr size_t nodes = Element::nodes * Element::nodes;
+
+		using Field = SoAField<S, 3 * nodes>;
+
+		static constexpr size_t P = 0, UX = nodes, UY = 2 * nodes;
+
+		//out = a * base + b * (in + dt * L(in)), a Runge-Kutta stage in Shu-Osher form. Without base a forward Euler step
+		struct Stage {
+			const Field* base{ nullptr };
+			T a{ 0 };
+			T b{ 1 };
+		};
+
+		struct Row {
+			const Riemann2Grid* grid;
+			size_t y;
+
+			inline Cell operator[](size_t x) const {
+				return grid->get(x, y);
+			}
+		};
+
+		bool init(const char* start_condition = nullptr);
+		//Allocates a zeroed x_size * y_size grid with ghost_width ghost layers, cells can then be written with set()
+		void resize(size_t x_size, size_t y_size, size_t ghost_width = 1);
 		size_t get_buffer_float_amount();
 		void fill_buffer(float* buffer, bool drawU);
+		//Only the quads of rows [y0, y1) at their place in buffer, quad row y is drawn from cell row y alone
+		//so the rows changes marked since the buffer was last filled are all that needs rewriting
+		void fill_buffer(float* buffer, bool drawU, size_t y0, size_t y1);
+		//One height per cell, the corner fill_buffer starts the quad of the cell at, for a static indexed mesh
+		size_t get_height_amount() const { return x_s * y_s; }
+		void fill_heights(float* buffer, bool drawU) const;
+		void fill_heights(float* buffer, bool drawU, size_t y0, size_t y1) const;
 
-		void update_ghosts(void(*)(Riemann2Cell& cell, size_t x, size_t y));
+		//Fills the ghost layers from the interior according to boundary, done at the start of every step and stage
+		void update_ghosts();
+		void update_ghosts(Field& field);
 
 		//Central difference d2x d2y forward difference d2t
 		void step_finite_difference(double dt);
+		//Forward Euler
 		void step_finite_volume(double dt);
 
+		//One step of integrator
+		void step(double dt);
+		//Largest dt integrator stays stable with for the fastest wave of the material, scaled by cfl. 0 for forward
+		//Euler, which no dt keeps stable
+		double stable_dt() const;
+		//Advances by time in the fewest steps of at most stable_dt(), returns the amount of steps. Without a stable dt
+		//nothing is stepped
+		size_t advance(double time);
+
+		//Flags the tiles the next step of stepper can change, from values with filled ghosts. Called by step() and step_finite_volume()
+		void update_activity(TimeIntegrator stepper);
+
+		//steps single steps, depth of them at a time per tile (see TemporalBlocking.hpp). Same result as calling step_finite_volume steps times
+		void step_finite_volume_blocked(double dt, size_t steps, size_t depth = 8);
+
+		//Reference implementation of step_finite_volume without simd kernels
+		void step_finite_volume_scalar(double dt);
+		//One stage over the whole grid, the ghosts of in have to be filled
+		void finite_volume_stage(const Field& in, Field& out, double dt, const Stage& stage = {});
+		//One stage over the cells of region only, without activity tracking. The neighbours of region have to be valid in in
+		void finite_volume_region(const Field& in, Field& out, const Tile& region, double dt, const Stage& stage = {}) const;
+		void update_cell(const Field& in, Field& out, size_t x, size_t y, double dt, const Stage& stage = {}) const;
+
+		//Ghost cell (x, y) of field from the interior cell (src_x, src_y) behind the boundary axis
+		static void ghost_cell(Field& field, BoundaryPolicy boundary, size_t x, size_t y, size_t src_x, size_t src_y, Axis axis);
+
+		//Element operations between resolutions (see AmrGrid.hpp)
+		//The quarter (qx, qy) of cell, its polynomial evaluated at the nodes of the half size element
+		static Cell refine_cell(const Cell& cell, size_t qx, size_t qy);
+		//L2 projection of the quarters fine[qy][qx] onto one element, keeps the mean and undoes refine_cell
+		static Cell coarsen_cell(const Cell (&fine)[2][2]);
+		//State on face d of cell that update_cell passes to the Riemann solver
+		static vec3 face_trace(const Cell& cell, Direction d) requires (Order == 1);
+		//Adds flux through face d of cell (x, y) the way update_cell adds the face term of a dt step
+		void add_face_flux(Field& field, size_t x, size_t y, Direction d, const vec3& flux, double dt) const requires (Order == 1);
+
 		//FV / DG
-		glm::vec3 solveRiemann(glm::vec3 left, glm::vec3 right, double dT, glm::vec2 normal);
+		//Generic flux for any normal, the steppers use the specialized solver.flux<Direction>()
+		vec3 solveRiemann(vec3 left, vec3 right, double dT, glm::vec2 normal);
 
 		size_t x_s{ 2 };
 		size_t y_s{ 2 };
 
 		double K0{ 1 };
 		double onebyrho0{ 1 };
+		double cell_size{ 1 }; //Element width, the operator scales with dt / cell_size
+
+		TimeIntegrator integrator{ TimeIntegrator::Euler };
+		double cfl{ 0.9 }; //Fraction of the stability limit stable_dt() returns
+
+		TileConfig tiles;
+		BoundaryPolicy boundary{ BoundaryPolicy::Reflective };
+		RiemannSolver<T> solver; //Rebuilt from K0 and onebyrho0 at the start of every step if they changed
+
+		//step() and step_finite_volume() skip tiles that are at rest with their neighbours (see Activity.hpp)
+		bool skip_quiet{ true };
+		TileConfig activity_tiles{ 32, 32 }; //At least 3 cells per axis including the last tile, smaller tiles step everything
+		double quiet_amplitude{ 0 };         //Largest value at rest, 0 only skips tiles the step can not change
+		ActivityMap activity;
+		RowChanges changes; //Rows of values every write touched, see fill_buffer()
 
-		std::vector<Riemann2Cell> values; //t
-		std::vector<Riemann2Cell> nval;   //t + dt
+		Field values; //t
+		Field nval;   //t + dt
 
-		inline Riemann2Cell* operator[](size_t y) {
-			return &values[y * x_s];
+		static inline Cell load(const Field& field, size_t i) {
+			Cell cell;
+			for (size_t n = 0; n < nodes; ++n) {
+				cell.p[n] = T(field.plane(P + n)[i]);
+				cell.ux[n] = T(field.plane(UX + n)[i]);
+				cell.uy[n] = T(field.plane(UY + n)[i]);
+			}
+			return cell;
 		}
 
-		static VertexInputDescription get_vk_description();
+		static inline void store(Field& field, size_t i, const Cell& cell) {
+			for (size_t n = 0; n < nodes; ++n) {
+				field.plane(P + n)[i] = S(cell.p[n]);
+				field.plane(UX + n)[i] = S(cell.ux[n]);
+				field.plane(UY + n)[i] = S(cell.uy[n]);
+			}
+		}
+
+		inline Cell get(size_t x, size_t y) const {
+			return load(values, values.index(x, y));
+		}
+
+		inline void set(size_t x, size_t y, const Cell& cell) {
+			store(values, values.index(x, y), cell);
+			activity.synced = false;
+			changes.mark(y, y + 1);
+		}
+
+		inline Row operator[](size_t y) const {
+			return Row{ this, y };
+		}
 	};
+
+	// Riemann2Grid has Runge-Kutta stages, SimpleGrid only single steps
+	template<typename Grid>
+	concept StagedGrid = requires { typename Grid::Stage; };
+
+	//Instantiated for every policy in SimpleGrid.cpp and Riemann2Grid.cpp
+	extern template struct SimpleGrid<Fp64>;
+	extern template struct SimpleGrid<Fp32>;
+	extern template struct SimpleGrid<Fp16>;
+	extern template struct SimpleGrid<Bf16>;
+
+	//Riemann2Grid for orders 1 to 7
+	extern template struct Riemann2Grid<Fp64>;
+	extern template struct Riemann2Grid<Fp32>;
+	extern template struct Riemann2Grid<Fp16>;
+	extern template struct Riemann2Grid<Bf16>;
+	extern template struct Riemann2Grid<Fp64, 2>;
+	extern template struct Riemann2Grid<Fp32, 2>;
+	extern template struct Riemann2Grid<Fp16, 2>;
+	extern template struct Riemann2Grid<Bf16, 2>;
+	extern template struct Riemann2Grid<Fp64, 3>;
+	extern template struct Riemann2Grid<Fp32, 3>;
+	extern template struct Riemann2Grid<Fp16, 3>;
+	extern template struct Riemann2Grid<Bf16, 3>;
+	extern template struct Riemann2Grid<Fp64, 4>;
+	extern template struct Riemann2Grid<Fp32, 4>;
+	extern template struct Riemann2Grid<Fp16, 4>;
+	extern template struct Riemann2Grid<Bf16, 4>;
+	extern template struct Riemann2Grid<Fp64, 5>;
+	extern template struct Riemann2Grid<Fp32, 5>;
+	extern template struct Riemann2Grid<Fp16, 5>;
+	extern template struct Riemann2Grid<Bf16, 5>;
+	extern template struct Riemann2Grid<Fp64, 6>;
+	extern template struct Riemann2Grid<Fp32, 6>;
+	extern template struct Riemann2Grid<Fp16, 6>;
+	extern template struct Riemann2Grid<Bf16, 6>;
+	extern template struct Riemann2Grid<Fp64, 7>;
+	extern template struct Riemann2Grid<Fp32, 7>;
+	extern template struct Riemann2Grid<Fp16, 7>;
+	extern template struct Riemann2Grid<Bf16, 7>;
 }
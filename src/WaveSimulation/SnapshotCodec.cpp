@@ -0,0 +1,689 @@
+#include "SnapshotCodec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+using namespace WaveSimulation;
+
+//rANS with byte renormalization after ryg_rans, frequencies sum to 1 << RANS_SCALE
+constexpr uint32_t RANS_SCALE = 14;
+constexpr uint32_t RANS_L = 1u << 23;
+
+//Mode byte of a lossless chunk
+enum ChunkMode : uint8_t {
+	ChunkStored,
+	ChunkConstant,
+	ChunkRans,
+};
+
+//Mode byte plus the largest of a stored chunk and a coded one with every frequency present
+constexpr size_t LOSSLESS_CHUNK_BOUND = 1 + 32 + 256 * 2 + SNAPSHOT_CHUNK + 8;
+
+//A lossy block is a width byte, a varint of the mean and 15 coefficients of up to 64 bits, or 16 stored values
+constexpr size_t LOSSY_BLOCK_BOUND = 1 + 10 + 15 * 8;
+constexpr uint8_t LOSSY_STORED = 0xFF;
+constexpr double LOSSY_RANGE = 4503599627370496.0; //2^52, quantized values stay exact in a double
+
+const char* WaveSimulation::snapshot_codec_name(SnapshotCodec codec) {
+	switch (codec) {
+		case SnapshotCodec::Raw: return "raw";
+		case SnapshotCodec::Lossless: return "lossless";
+		case SnapshotCodec::Lossy: return "lossy";
+	}
+	return "unknown";
+}
+
+//Calls func with a null pointer of the storage type named by header.precision
+template<typename Func>
+static bool with_storage(const SnapshotHeader& header, Func&& func) {
+	if (!strncmp(header.precision, Fp64::name, sizeof(header.precision)))
+		func(static_cast<Fp64::storage*>(nullptr));
+	else if (!strncmp(header.precision, Fp32::name, sizeof(header.precision)))
+		func(static_cast<Fp32::storage*>(nullptr));
+	else if (!strncmp(header.precision, Fp16::name, sizeof(header.precision)))
+		func(static_cast<Fp16::storage*>(nullptr));
+	else if (!strncmp(header.precision, Bf16::name, sizeof(header.precision)))
+		func(static_cast<Bf16::storage*>(nullptr));
+	else
+		return false;
+	return true;
+}
+
+static size_t chunk_amount(const SnapshotHeader& header, SnapshotCodec codec) {
+	if (codec == SnapshotCodec::Lossless)
+		return header.storage_size * ((header.planes * header.width * header.height + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK);
+	return header.planes * ((header.height + 3) / 4);
+}
+
+static size_t chunk_bound(const SnapshotHeader& header, SnapshotCodec codec) {
+	if (codec == SnapshotCodec::Lossless)
+		return LOSSLESS_CHUNK_BOUND;
+	return (header.width + 3) / 4 * std::max(LOSSY_BLOCK_BOUND, 1 + 16 * size_t(header.storage_size));
+}
+
+// Lossless chunks
+
+//Counts scaled to sum to 1 << RANS_SCALE, every present byte keeps at least 1
+static void normalize(const uint32_t* counts, size_t total, uint32_t* freq) {
+	uint32_t sum = 0;
+	for (size_t s = 0; s < 256; ++s) {
+		freq[s] = counts[s] ? std::max<uint32_t>(1, static_cast<uint32_t>((uint64_t(counts[s]) << RANS_SCALE) / total)) : 0;
+		sum += freq[s];
+	}
+
+	//Rounding leaves the sum a little off, the largest frequencies absorb it
+	while (sum != 1u << RANS_SCALE) {
+		size_t largest = std::max_element(freq, freq + 256) - freq;
+		if (sum < 1u << RANS_SCALE) {
+			freq[largest] += (1u << RANS_SCALE) - sum;
+			sum = 1u << RANS_SCALE;
+		} else {
+			uint32_t take = std::min(sum - (1u << RANS_SCALE), freq[largest] - 1);
+			take = std::max<uint32_t>(take, 1);
+			freq[largest] -= take;
+			sum -= take;
+		}
+	}
+}
+
+//Coding of one byte value, after RansEncSymbol of ryg_rans
+struct EncodeSymbol {
+	uint32_t x_max;     //Renormalize states at or above
+	uint32_t rcp_freq;  //Fixed point reciprocal of the frequency
+	uint32_t bias;
+	uint32_t cmpl_freq; //(1 << RANS_SCALE) - freq
+	uint32_t rcp_shift;
+
+	EncodeSymbol() = default;
+	EncodeSymbol(uint32_t start, uint32_t freq) {
+		x_max = ((RANS_L >> RANS_SCALE) << 8) * freq;
+		cmpl_freq = (1u << RANS_SCALE) - freq;
+		if (freq < 2) {
+			//x / 1 overflows the reciprocal, the bias does the work instead
+			rcp_freq = ~0u;
+			rcp_shift = 0;
+			bias = start + (1u << RANS_SCALE) - 1;
+		} else {
+			uint32_t shift = 0;
+			while (freq > (1u << shift))
+				++shift;
+			rcp_freq = static_cast<uint32_t>(((uint64_t(1) << (shift + 31)) + freq - 1) / freq);
+			rcp_shift = shift - 1;
+			bias = start;
+		}
+	}
+
+	inline void put(uint32_t& x, uint8_t*& ptr) const {
+		while (x >= x_max) {
+			*--ptr = static_cast<uint8_t>(x);
+			x >>= 8;
+		}
+		const uint32_t q = static_cast<uint32_t>((uint64_t(x) * rcp_freq) >> 32) >> rcp_shift;
+		x += bias + q * cmpl_freq;
+	}
+};
+
+//Codes n bytes of data into out, which holds LOSSLESS_CHUNK_BOUND bytes
+static size_t encode_chunk(const uint8_t* data, size_t n, uint8_t* out) {
+	uint32_t counts[256] = {};
+	for (size_t i = 0; i < n; ++i)
+		++counts[data[i]];
+
+	size_t present = 0;
+	for (size_t s = 0; s < 256; ++s)
+		present += counts[s] != 0;
+
+	if (present == 1) {
+		out[0] = ChunkConstant;
+		out[1] = data[0];
+		return 2;
+	}
+
+	uint32_t freq[256], cum[257];
+	normalize(counts, n, freq);
+	cum[0] = 0;
+	for (size_t s = 0; s < 256; ++s)
+		cum[s + 1] = cum[s] + freq[s];
+
+	//Table: bitmap of the present bytes, then their frequencies
+	uint8_t* p = out;
+	*p++ = ChunkRans;
+	memset(p, 0, 32);
+	for (size_t s = 0; s < 256; ++s)
+		if (freq[s])
+			p[s / 8] |= uint8_t(1) << (s % 8);
+	p += 32;
+	for (size_t s = 0; s < 256; ++s) {
+		if (freq[s]) {
+			*p++ = static_cast<uint8_t>(freq[s]);
+			*p++ = static_cast<uint8_t>(freq[s] >> 8);
+		}
+	}
+
+	//rANS codes backwards, into the end of the stored fallback's space. Two interleaved states, even bytes go
+	//to the first, and the division by the frequency is a multiplication by its reciprocal
+	EncodeSymbol symbols[256];
+	for (size_t s = 0; s < 256; ++s)
+		symbols[s] = EncodeSymbol(cum[s], freq[s]);
+
+	uint8_t* const end = out + LOSSLESS_CHUNK_BOUND;
+	uint8_t* ptr = end;
+	uint32_t x[2] = { RANS_L, RANS_L };
+	for (size_t i = n; i-- > 0 && ptr - p > 16;)
+		symbols[data[i]].put(x[i & 1], ptr);
+
+	for (size_t r = 2; r-- > 0;) {
+		ptr -= 4;
+		for (size_t b = 0; b < 4; ++b)
+			ptr[b] = static_cast<uint8_t>(x[r] >> (8 * b));
+	}
+
+	const size_t coded = end - ptr;
+	if (ptr - p <= 8 || (p - out) + coded >= 1 + n) {
+		out[0] = ChunkStored;
+		memcpy(out + 1, data, n);
+		return 1 + n;
+	}
+
+	memmove(p, ptr, coded);
+	return (p - out) + coded;
+}
+
+static bool decode_chunk(const uint8_t* in, size_t size, uint8_t* data, size_t n) {
+	if (!size)
+		return false;
+
+	const uint8_t* const end = in + size;
+	switch (in[0]) {
+		case ChunkStored:
+			if (size != 1 + n)
+				return false;
+			memcpy(data, in + 1, n);
+			return true;
+		case ChunkConstant:
+			if (size != 2)
+				return false;
+			memset(data, in[1], n);
+			return true;
+		case ChunkRans:
+			break;
+		default:
+			return false;
+	}
+
+	const uint8_t* p = in + 1;
+	if (end - p < 32)
+		return false;
+	const uint8_t* bitmap = p;
+	p += 32;
+
+	uint32_t freq[256], cum[256];
+	uint32_t sum = 0;
+	for (size_t s = 0; s < 256; ++s) {
+		freq[s] = 0;
+		if (bitmap[s / 8] & (1 << (s % 8))) {
+			if (end - p < 2)
+				return false;
+			freq[s] = p[0] | (uint32_t(p[1]) << 8);
+			p += 2;
+		}
+		cum[s] = sum;
+		sum += freq[s];
+	}
+	if (sum != 1u << RANS_SCALE || end - p < 8)
+		return false;
+
+	uint8_t slots[1 << RANS_SCALE];
+	for (size_t s = 0; s < 256; ++s)
+		memset(slots + cum[s], static_cast<int>(s), freq[s]);
+
+	uint32_t x[2];
+	for (size_t r = 0; r < 2; ++r, p += 4)
+		x[r] = p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+
+	constexpr uint32_t mask = (1u << RANS_SCALE) - 1;
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t& state = x[i & 1];
+		const uint32_t slot = state & mask;
+		const uint8_t s = slots[slot];
+		data[i] = s;
+		state = freq[s] * (state >> RANS_SCALE) + slot - cum[s];
+		while (state < RANS_L) {
+			if (p == end)
+				return false;
+			state = (state << 8) | *p++;
+		}
+	}
+	return p == end;
+}
+
+// Lossy blocks
+
+//Reversible lifting of 4 values into their mean, the difference of the pair means and the pair differences
+static inline void forward_lift(int64_t& x0, int64_t& x1, int64_t& x2, int64_t& x3) {
+	const int64_t d0 = x0 - x1, s0 = x1 + (d0 >> 1);
+	const int64_t d1 = x2 - x3, s1 = x3 + (d1 >> 1);
+	const int64_t dd = s0 - s1, ss = s1 + (dd >> 1);
+	x0 = ss;
+	x1 = dd;
+	x2 = d0;
+	x3 = d1;
+}
+
+static inline void inverse_lift(int64_t& x0, int64_t& x1, int64_t& x2, int64_t& x3) {
+	const int64_t s1 = x0 - (x1 >> 1), s0 = x1 + s1;
+	const int64_t b = s0 - (x2 >> 1), a = x2 + b;
+	const int64_t d = s1 - (x3 >> 1), c = x3 + d;
+	x0 = a;
+	x1 = b;
+	x2 = c;
+	x3 = d;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+	return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+	return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+//Little endian bit stream of up to 32 bits per call
+struct BitWriter {
+	uint8_t* p;
+	uint64_t acc{ 0 };
+	unsigned fill{ 0 };
+
+	void put(uint64_t v, unsigned n) {
+		acc |= v << fill;
+		fill += n;
+		while (fill >= 8) {
+			*p++ = static_cast<uint8_t>(acc);
+			acc >>= 8;
+			fill -= 8;
+		}
+	}
+
+	void put_wide(uint64_t v, unsigned n) {
+		if (n > 32) {
+			put(v & 0xffffffffu, 32);
+			put(v >> 32, n - 32);
+		} else {
+			put(v, n);
+		}
+	}
+
+	void flush() {
+		if (fill)
+			*p++ = static_cast<uint8_t>(acc);
+		acc = 0;
+		fill = 0;
+	}
+};
+
+struct BitReader {
+	const uint8_t* p;
+	uint64_t acc{ 0 };
+	unsigned fill{ 0 };
+
+	uint64_t get(unsigned n) {
+		while (fill < n) {
+			acc |= uint64_t(*p++) << fill;
+			fill += 8;
+		}
+		const uint64_t v = n ? acc & (~uint64_t(0) >> (64 - n)) : 0;
+		acc = n < 64 ? acc >> n : 0;
+		fill -= n;
+		return v;
+	}
+
+	uint64_t get_wide(unsigned n) {
+		if (n > 32) {
+			const uint64_t low = get(32);
+			return low | (get(n - 32) << 32);
+		}
+		return get(n);
+	}
+
+	void align() {
+		acc = 0;
+		fill = 0;
+	}
+};
+
+template<typename S>
+static inline double to_double(S s) {
+	if constexpr (std::is_floating_point_v<S>)
+		return static_cast<double>(s);
+	else
+		return static_cast<double>(static_cast<float>(s));
+}
+
+template<typename S>
+static inline S from_double(double d) {
+	if constexpr (std::is_floating_point_v<S>)
+		return static_cast<S>(d);
+	else
+		return S(static_cast<float>(d));
+}
+
+//Quantization step of tolerance. Rounding the reconstruction to a storage type can at most double the error
+//of the quantizer, going through float first to a 16 bit type doubles it again
+template<typename S>
+static double lossy_step(double tolerance) {
+	double step = std::exp2(std::floor(std::log2(tolerance)));
+	return std::is_floating_point_v<S> ? step : step / 2;
+}
+
+//Encodes the blocks of one row of blocks of a plane
+template<typename S>
+static size_t encode_block_row(const S* plane, size_t width, size_t height, size_t by, double step, uint8_t* out) {
+	uint8_t* p = out;
+	int64_t mean = 0;
+
+	for (size_t bx = 0; bx < (width + 3) / 4; ++bx) {
+		//Edges repeat the last row and column
+		S values[16];
+		for (size_t j = 0; j < 4; ++j)
+			for (size_t i = 0; i < 4; ++i)
+				values[j * 4 + i] = plane[std::min(by * 4 + j, height - 1) * width + std::min(bx * 4 + i, width - 1)];
+
+		int64_t q[16];
+		bool stored = false;
+		for (size_t i = 0; i < 16 && !stored; ++i) {
+			const double v = std::nearbyint(to_double(values[i]) / step);
+			stored = !(std::fabs(v) <= LOSSY_RANGE);
+			q[i] = stored ? 0 : static_cast<int64_t>(v);
+		}
+
+		if (stored) {
+			*p++ = LOSSY_STORED;
+			memcpy(p, values, sizeof(values));
+			p += sizeof(values);
+			continue;
+		}
+
+		for (size_t j = 0; j < 4; ++j)
+			forward_lift(q[j * 4], q[j * 4 + 1], q[j * 4 + 2], q[j * 4 + 3]);
+		for (size_t i = 0; i < 4; ++i)
+			forward_lift(q[i], q[4 + i], q[8 + i], q[12 + i]);
+
+		uint64_t largest = 0;
+		for (size_t i = 1; i < 16; ++i)
+			largest |= zigzag(q[i]);
+		unsigned bits = 0;
+		while (bits < 64 && largest >> bits)
+			++bits;
+
+		*p++ = static_cast<uint8_t>(bits);
+
+		uint64_t delta = zigzag(q[0] - mean);
+		mean = q[0];
+		do {
+			*p++ = static_cast<uint8_t>((delta & 0x7f) | (delta > 0x7f ? 0x80 : 0));
+			delta >>= 7;
+		} while (delta);
+
+		BitWriter writer{ p };
+		for (size_t i = 1; i < 16; ++i)
+			writer.put_wide(zigzag(q[i]), bits);
+		writer.flush();
+		p = writer.p;
+	}
+
+	return p - out;
+}
+
+template<typename S>
+static bool decode_block_row(const uint8_t* in, size_t size, S* plane, size_t width, size_t height, size_t by, double step) {
+	const uint8_t* p = in;
+	const uint8_t* const end = in + size;
+	int64_t mean = 0;
+
+	for (size_t bx = 0; bx < (width + 3) / 4; ++bx) {
+		if (p == end)
+			return false;
+		const uint8_t bits = *p++;
+
+		S values[16];
+		if (bits == LOSSY_STORED) {
+			if (size_t(end - p) < sizeof(values))
+				return false;
+			memcpy(values, p, sizeof(values));
+			p += sizeof(values);
+		} else {
+			if (bits > 64)
+				return false;
+
+			uint64_t delta = 0;
+			for (unsigned shift = 0;; shift += 7) {
+				if (p == end || shift > 63)
+					return false;
+				delta |= uint64_t(*p & 0x7f) << shift;
+				if (!(*p++ & 0x80))
+					break;
+			}
+
+			if (size_t(end - p) < (15 * size_t(bits) + 7) / 8)
+				return false;
+
+			int64_t q[16];
+			q[0] = mean + unzigzag(delta);
+			mean = q[0];
+
+			BitReader reader{ p };
+			for (size_t i = 1; i < 16; ++i)
+				q[i] = unzigzag(reader.get_wide(bits));
+			p += (15 * bits + 7) / 8;
+
+			for (size_t i = 0; i < 4; ++i)
+				inverse_lift(q[i], q[4 + i], q[8 + i], q[12 + i]);
+			for (size_t j = 0; j < 4; ++j)
+				inverse_lift(q[j * 4], q[j * 4 + 1], q[j * 4 + 2], q[j * 4 + 3]);
+
+			for (size_t i = 0; i < 16; ++i)
+				values[i] = from_double<S>(static_cast<double>(q[i]) * step);
+		}
+
+		for (size_t j = 0; j < 4 && by * 4 + j < height; ++j)
+			for (size_t i = 0; i < 4 && bx * 4 + i < width; ++i)
+				plane[(by * 4 + j) * width + bx * 4 + i] = values[j * 4 + i];
+	}
+
+	return p == end;
+}
+
+// Encoder
+
+SnapshotEncoder::SnapshotEncoder(const SnapshotHeader& h, SnapshotCodec c, double t, size_t k, size_t threads) :
+		header(h), codec(c), tolerance(t), keyframe_interval(std::max(k, size_t(1))), pool(threads) {
+	if (codec != SnapshotCodec::Raw) {
+		scratch.resize(chunk_amount(header, codec) * chunk_bound(header, codec));
+		sizes.resize(chunk_amount(header, codec));
+	}
+}
+
+size_t SnapshotEncoder::bound() const {
+	const size_t raw = header.planes * header.width * header.height * header.storage_size;
+	if (codec == SnapshotCodec::Raw)
+		return raw;
+	return sizeof(uint32_t) * (1 + sizes.size()) + scratch.size();
+}
+
+//Chunks are coded into fixed slots of scratch in parallel, then packed behind the chunk sizes
+size_t SnapshotEncoder::encode(SnapshotFrame& frame, const char* raw, char* out) {
+	const size_t raw_size = header.planes * header.width * header.height * header.storage_size;
+	const size_t chunks = sizes.size(), slot = chunk_bound(header, codec);
+
+	frame.codec = codec;
+	frame.raw_size = raw_size;
+	frame.tolerance = 0;
+	frame.flags = SNAPSHOT_KEYFRAME;
+
+	if (codec == SnapshotCodec::Raw) {
+		memcpy(out, raw, raw_size);
+		frame.payload_size = raw_size;
+		return raw_size;
+	}
+
+	if (codec == SnapshotCodec::Lossless) {
+		const bool keyframe = since_keyframe == 0 || previous.size() != raw_size;
+		since_keyframe = (since_keyframe + 1) % keyframe_interval;
+		frame.flags = keyframe ? SNAPSHOT_KEYFRAME : 0;
+
+		const size_t B = header.storage_size, values = raw_size / B;
+		const size_t per_stream = chunks / B;
+		const uint8_t* cur = reinterpret_cast<const uint8_t*>(raw);
+		const uint8_t* prev = keyframe ? nullptr : reinterpret_cast<const uint8_t*>(previous.data());
+
+		pool.parallel_for(chunks, [&](size_t i) {
+			const size_t k = i / per_stream, begin = (i % per_stream) * SNAPSHOT_CHUNK;
+			const size_t n = std::min(SNAPSHOT_CHUNK, values - begin);
+
+			uint8_t bytes[SNAPSHOT_CHUNK];
+			const uint8_t* src = cur + begin * B + k;
+			if (prev) {
+				const uint8_t* before = prev + begin * B + k;
+				for (size_t j = 0; j < n; ++j)
+					bytes[j] = src[j * B] ^ before[j * B];
+			} else {
+				for (size_t j = 0; j < n; ++j)
+					bytes[j] = src[j * B];
+			}
+
+			sizes[i] = static_cast<uint32_t>(encode_chunk(bytes, n, reinterpret_cast<uint8_t*>(scratch.data() + i * slot)));
+		});
+
+		previous.assign(raw, raw + raw_size);
+	} else {
+		const size_t width = header.width, height = header.height, rows = (height + 3) / 4;
+		frame.tolerance = tolerance;
+
+		with_storage(header, [&](auto* type) {
+			using S = std::remove_pointer_t<decltype(type)>;
+			const double step = lossy_step<S>(tolerance);
+			const S* planes = reinterpret_cast<const S*>(raw);
+
+			pool.parallel_for(chunks, [&](size_t i) {
+				const size_t n = i / rows, by = i % rows;
+				sizes[i] = static_cast<uint32_t>(encode_block_row(planes + n * width * height, width, height, by, step,
+					reinterpret_cast<uint8_t*>(scratch.data() + i * slot)));
+			});
+		});
+	}
+
+	std::vector<size_t> offsets(chunks + 1);
+	offsets[0] = sizeof(uint32_t) * (1 + chunks);
+	for (size_t i = 0; i < chunks; ++i)
+		offsets[i + 1] = offsets[i] + sizes[i];
+
+	const uint32_t amount = static_cast<uint32_t>(chunks);
+	memcpy(out, &amount, sizeof(amount));
+	memcpy(out + sizeof(amount), sizes.data(), chunks * sizeof(uint32_t));
+	pool.parallel_for(chunks, [&](size_t i) {
+		memcpy(out + offsets[i], scratch.data() + i * slot, sizes[i]);
+	});
+
+	frame.payload_size = offsets[chunks];
+	return frame.payload_size;
+}
+
+// Decoder
+
+SnapshotDecoder::SnapshotDecoder(const SnapshotHeader& h, size_t threads) : header(h), pool(threads) {}
+
+bool SnapshotDecoder::decode(const SnapshotFrame& frame, const char* payload, char* raw) {
+	const size_t raw_size = header.planes * header.width * header.height * header.storage_size;
+	if (frame.raw_size != raw_size)
+		return false;
+
+	if (frame.codec == SnapshotCodec::Raw) {
+		if (frame.payload_size != raw_size)
+			return false;
+		memcpy(raw, payload, raw_size);
+		return true;
+	}
+
+	if (frame.codec != SnapshotCodec::Lossless && frame.codec != SnapshotCodec::Lossy)
+		return false;
+
+	const bool keyframe = frame.flags & SNAPSHOT_KEYFRAME;
+	if (frame.codec == SnapshotCodec::Lossless && !keyframe && !has_previous)
+		return false;
+
+	//Chunk directory
+	const size_t chunks = chunk_amount(header, frame.codec);
+	uint32_t amount;
+	if (frame.payload_size < sizeof(uint32_t) * (1 + chunks))
+		return false;
+	memcpy(&amount, payload, sizeof(amount));
+	if (amount != chunks)
+		return false;
+
+	std::vector<uint32_t> sizes(chunks);
+	memcpy(sizes.data(), payload + sizeof(uint32_t), chunks * sizeof(uint32_t));
+	std::vector<size_t> offsets(chunks + 1);
+	offsets[0] = sizeof(uint32_t) * (1 + chunks);
+	for (size_t i = 0; i < chunks; ++i)
+		offsets[i + 1] = offsets[i] + sizes[i];
+	if (offsets[chunks] != frame.payload_size)
+		return false;
+
+	std::atomic<bool> broken{ false };
+	const uint8_t* in = reinterpret_cast<const uint8_t*>(payload);
+
+	if (frame.codec == SnapshotCodec::Lossless) {
+		const size_t B = header.storage_size, values = raw_size / B;
+		const size_t per_stream = chunks / B;
+		uint8_t* out = reinterpret_cast<uint8_t*>(raw);
+		const uint8_t* prev = keyframe ? nullptr : reinterpret_cast<const uint8_t*>(previous.data());
+
+		pool.parallel_for(chunks, [&](size_t i) {
+			const size_t k = i / per_stream, begin = (i % per_stream) * SNAPSHOT_CHUNK;
+			const size_t n = std::min(SNAPSHOT_CHUNK, values - begin);
+
+			uint8_t bytes[SNAPSHOT_CHUNK];
+			if (!decode_chunk(in + offsets[i], sizes[i], bytes, n)) {
+				broken = true;
+				return;
+			}
+
+			uint8_t* dst = out + begin * B + k;
+			if (prev) {
+				const uint8_t* before = prev + begin * B + k;
+				for (size_t j = 0; j < n; ++j)
+					dst[j * B] = bytes[j] ^ before[j * B];
+			} else {
+				for (size_t j = 0; j < n; ++j)
+					dst[j * B] = bytes[j];
+			}
+		});
+
+		if (!broken) {
+			previous.assign(raw, raw + raw_size);
+			has_previous = true;
+		}
+	} else {
+		const size_t width = header.width, height = header.height, rows = (height + 3) / 4;
+
+		if (!(frame.tolerance > 0))
+			return false;
+
+		bool known = with_storage(header, [&](auto* type) {
+			using S = std::remove_pointer_t<decltype(type)>;
+			const double step = lossy_step<S>(frame.tolerance);
+			S* planes = reinterpret_cast<S*>(raw);
+
+			pool.parallel_for(chunks, [&](size_t i) {
+				const size_t n = i / rows, by = i % rows;
+				if (!decode_block_row(in + offsets[i], sizes[i], planes + n * width * height, width, height, by, step))
+					broken = true;
+			});
+		});
+
+		broken = broken || !known;
+	}
+
+	return !broken;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "SnapshotWriter.hpp"
+#include "ThreadPool.hpp"
+
+namespace WaveSimulation {
+	// Compressed snapshot payloads. Both codecs split a frame into chunks that encode and decode independently
+	// on a pool of their own, the payload starts with the chunk count and the encoded size of every chunk as
+	// uint32_t, followed by the chunks back to back.
+	//
+	// Lossless: values are XORed with the same value of the frame before unless the frame is a keyframe, then
+	// byte shuffled, byte k of every value forms stream k. The streams are cut into SNAPSHOT_CHUNK byte chunks,
+	// each stored, a single repeated byte or coded with a static order 0 rANS.
+	//
+	// Lossy: every plane is cut into 4x4 blocks, the rows of blocks of a plane are the chunks. A block is quantized
+	// to a power of two step no larger than the tolerance, then decorrelated by a reversible integer lifting
+	// transform along rows and columns like ZFP does. Its mean is stored as varint delta to the block before and
+	// the 15 other coefficients with the bit width of the largest one. Quantizing before the transform rather
+	// than truncating bit planes after it is what keeps every value within the tolerance. Blocks out of the range
+	// of the quantizer are stored as they are
+	constexpr size_t SNAPSHOT_CHUNK = size_t(1) << 16;
+
+	struct SnapshotEncoder {
+		//threads 0 uses all
+		SnapshotEncoder(const SnapshotHeader& header, SnapshotCodec codec, double tolerance, size_t keyframe_interval, size_t threads = 0);
+
+		//Largest payload encode() writes
+		size_t bound() const;
+
+		//Encodes the raw payload of frame into out and fills in codec, flags, tolerance and payload_size
+		size_t encode(SnapshotFrame& frame, const char* raw, char* out);
+
+		const SnapshotHeader header;
+		const SnapshotCodec codec;
+		const double tolerance;
+		const size_t keyframe_interval;
+
+	private:
+		ThreadPool pool;
+		std::vector<char> scratch;      //Chunks before they are packed
+		std::vector<uint32_t> sizes;
+		std::vector<char> previous;     //Raw payload of the frame before, for the delta
+		size_t since_keyframe{ 0 };
+	};
+
+	struct SnapshotDecoder {
+		explicit SnapshotDecoder(const SnapshotHeader& header, size_t threads = 0);
+
+		//Decodes payload into raw, frame.raw_size bytes. A frame that is not a keyframe needs the frame before
+		//decoded by the same decoder, false if it was not or the payload is broken
+		bool decode(const SnapshotFrame& frame, const char* payload, char* raw);
+
+		//Forgets the frame before, the next frame decoded has to be a keyframe
+		void reset() { has_previous = false; }
+
+		const SnapshotHeader header;
+
+	private:
+		ThreadPool pool;
+		std::vector<char> previous;
+		bool has_previous{ false };
+	};
+}
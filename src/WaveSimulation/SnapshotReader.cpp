@@ -0,0 +1,334 @@
+#include "SnapshotReader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace WaveSimulation;
+
+#ifdef _WIN32
+//No mmap, the whole stream is read into memory
+static const char* map_stream(const char* path, size_t& size, std::shared_ptr<void>& owner) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return nullptr;
+
+	_fseeki64(file, 0, SEEK_END);
+	size = static_cast<size_t>(_ftelli64(file));
+	_fseeki64(file, 0, SEEK_SET);
+
+	void* buffer = ::operator new(size, std::align_val_t(FIELD_ALIGNMENT));
+	owner = std::shared_ptr<void>(buffer, [](void* ptr) {
+		::operator delete(ptr, std::align_val_t(FIELD_ALIGNMENT));
+	});
+
+	bool read = std::fread(buffer, 1, size, file) == size;
+	std::fclose(file);
+	if (!read)
+		owner.reset();
+	return read ? static_cast<const char*>(buffer) : nullptr;
+}
+#else
+//Frames are read in order, MADV_SEQUENTIAL lets the kernel read ahead further and drop what was played
+static const char* map_stream(const char* path, size_t& size, std::shared_ptr<void>& owner) {
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat info;
+	if (fstat(fd, &info) || !info.st_size) {
+		::close(fd);
+		return nullptr;
+	}
+
+	size = info.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	owner = std::shared_ptr<void>(mapping, [size](void* ptr) {
+		munmap(ptr, size);
+	});
+	return static_cast<const char*>(mapping);
+}
+#endif
+
+bool SnapshotReader::open(const char* path) {
+	close();
+
+	size_t size = 0;
+	const char* mapped = map_stream(path, size, owner);
+	if (!mapped) {
+		std::cout << "Failed to open snapshot stream " << path << std::endl;
+		return false;
+	}
+
+	const char* error = nullptr;
+	if (size < sizeof(SnapshotHeader))
+		error = "is truncated";
+	else
+		memcpy(&header, mapped, sizeof(header));
+
+	if (error) {
+	} else if (memcmp(header.magic, "WAVESNAP", 8)) {
+		error = "is not a snapshot stream";
+	} else if (header.byte_order != CHECKPOINT_BYTE_ORDER) {
+		error = "was written with another byte order";
+	} else if (header.version != SNAPSHOT_VERSION || header.header_size < sizeof(SnapshotHeader) || header.header_size % FIELD_ALIGNMENT) {
+		error = "has an unsupported version";
+	}
+
+	if (error) {
+		std::cout << "Snapshot stream " << path << " " << error << std::endl;
+		owner.reset();
+		return false;
+	}
+
+	//Frames up to the first one cut off, or whose size does not add up
+	size_t keyframe = 0;
+	for (uint64_t offset = header.header_size; offset + SNAPSHOT_FRAME_HEADER <= size;) {
+		Entry entry;
+		memcpy(&entry.frame, mapped + offset, sizeof(entry.frame));
+		entry.offset = offset;
+
+		const uint64_t frame_size = (SNAPSHOT_FRAME_HEADER + entry.frame.payload_size + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+		if (entry.frame.payload_size > size - offset - SNAPSHOT_FRAME_HEADER || entry.frame.raw_size != raw_size())
+			break;
+
+		if (entry.frame.flags & SNAPSHOT_KEYFRAME)
+			keyframe = frames.size();
+		else if (frames.empty())
+			break;
+		entry.keyframe = keyframe;
+
+		frames.push_back(entry);
+		offset += frame_size;
+	}
+
+	data = mapped;
+	return true;
+}
+
+void SnapshotReader::close() {
+	frames.clear();
+	owner.reset();
+	data = nullptr;
+}
+
+size_t SnapshotReader::frame_at(double time) const {
+	auto it = std::upper_bound(frames.begin(), frames.end(), time, [](double t, const Entry& entry) {
+		return t < entry.frame.time;
+	});
+	return it == frames.begin() ? 0 : it - frames.begin() - 1;
+}
+
+SnapshotPlayer::~SnapshotPlayer() {
+	close();
+}
+
+bool SnapshotPlayer::open(const char* path, size_t buffers, size_t decode_threads) {
+	close();
+
+	if (!reader.open(path))
+		return false;
+
+	if (!reader.frame_amount()) {
+		std::cout << "Snapshot stream " << path << " holds no frames" << std::endl;
+		reader.close();
+		return false;
+	}
+
+	const size_t n = reader.frame_amount();
+	time_scale = n > 1 ? (reader.frame(n - 1).time - reader.frame(0).time) / (n - 1) : 0;
+
+	decoder = new SnapshotDecoder(reader.header, decode_threads);
+	slots = std::vector<Slot>(std::max(buffers, size_t(2)));
+	playhead = start_time();
+	shown = SIZE_MAX;
+	target = next = 0;
+	restart = true;
+	closing = false;
+	thread = std::thread([this] { worker_loop(); });
+	return true;
+}
+
+void SnapshotPlayer::close() {
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			closing = true;
+		}
+		worker_cv.notify_one();
+		thread.join();
+	}
+
+	delete decoder;
+	decoder = nullptr;
+	slots.clear();
+	skipped.clear();
+	reader.close();
+}
+
+double SnapshotPlayer::start_time() const {
+	return reader.frame_amount() ? reader.frame(0).time : 0;
+}
+
+double SnapshotPlayer::end_time() const {
+	return reader.frame_amount() ? reader.frame(reader.frame_amount() - 1).time : 0;
+}
+
+void SnapshotPlayer::advance(double seconds) {
+	if (paused || !reader.frame_amount())
+		return;
+
+	playhead = std::min(playhead + seconds * speed * frames_per_second * time_scale, end_time());
+	request(reader.frame_at(playhead));
+}
+
+void SnapshotPlayer::seek(double time) {
+	if (!reader.frame_amount())
+		return;
+
+	playhead = std::clamp(time, start_time(), end_time());
+	request(reader.frame_at(playhead));
+}
+
+void SnapshotPlayer::seek_frame(size_t index) {
+	if (!reader.frame_amount())
+		return;
+
+	index = std::min(index, reader.frame_amount() - 1);
+	playhead = reader.frame(index).time;
+	request(index);
+}
+
+//Going back or past the next keyframe starts the worker over, everything decoded but the shown frame is dropped
+void SnapshotPlayer::request(size_t frame) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (frame == target)
+			return;
+
+		bool decoded = false;
+		for (const Slot& slot : slots)
+			decoded = decoded || (slot.used && slot.index <= frame);
+
+		if ((frame < target && !decoded) || reader.keyframe_of(frame) > next) {
+			next = reader.keyframe_of(frame);
+			restart = true;
+			for (size_t i = 0; i < slots.size(); ++i)
+				if (i != shown)
+					slots[i].used = false;
+		}
+		target = frame;
+	}
+	worker_cv.notify_one();
+}
+
+const char* SnapshotPlayer::current(size_t& index) {
+	const char* raw = nullptr;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		//Slots still decoding have index SIZE_MAX
+		size_t best = SIZE_MAX;
+		for (size_t i = 0; i < slots.size(); ++i)
+			if (slots[i].used && slots[i].index <= target && (best == SIZE_MAX || slots[i].index > slots[best].index))
+				best = i;
+
+		//After seeking back the frame shown stays until the worker catches up
+		if (best == SIZE_MAX && shown != SIZE_MAX && slots[shown].used)
+			best = shown;
+
+		//Frames before the one shown are not needed anymore
+		if (best != SIZE_MAX) {
+			for (size_t i = 0; i < slots.size(); ++i)
+				if (i != best && slots[i].used && slots[i].index < slots[best].index)
+					slots[i].used = false;
+			shown = best;
+			index = slots[best].index;
+			raw = slots[best].raw.data();
+		}
+	}
+
+	worker_cv.notify_one();
+	return raw;
+}
+
+//Takes frames in order from next into a free slot. Without one, frames behind the playhead are still decoded into
+//skipped for the deltas after them, so a worker falling behind shows what it has. A seek while decoding throws the frame away
+void SnapshotPlayer::worker_loop() {
+	const size_t amount = reader.frame_amount();
+
+	for (;;) {
+		std::unique_lock<std::mutex> guard(lock);
+
+		auto free_slot = [&] {
+			for (size_t i = 0; i < slots.size(); ++i)
+				if (!slots[i].used)
+					return i;
+			return SIZE_MAX;
+		};
+
+		worker_cv.wait(guard, [&] {
+			return closing || restart || (next < amount && (next < target || free_slot() != SIZE_MAX));
+		});
+		if (closing)
+			return;
+
+		//The playhead moved past the keyframe the deltas would start from
+		if (next < target && reader.keyframe_of(target) > next) {
+			next = reader.keyframe_of(target);
+			restart = true;
+		}
+		if (restart) {
+			decoder->reset();
+			restart = false;
+			if (next >= amount)
+				continue;
+		}
+
+		const size_t frame = next;
+		size_t slot = free_slot();
+		if (slot != SIZE_MAX) {
+			slots[slot].used = true;
+			slots[slot].index = SIZE_MAX; //Not shown before it is decoded
+		} else if (frame >= target) {
+			continue;
+		}
+		guard.unlock();
+
+		std::vector<char>& raw = slot == SIZE_MAX ? skipped : slots[slot].raw;
+		raw.resize(reader.raw_size());
+		bool decoded = decoder->decode(reader.frame(frame), reader.payload(frame), raw.data());
+
+		guard.lock();
+		if (restart || next != frame) {
+			//Seeked meanwhile, request() already freed the slot
+			continue;
+		}
+
+		if (!decoded) {
+			std::cout << "Failed to decode snapshot " << frame << " at step " << reader.frame(frame).step << std::endl;
+			decoder->reset();
+		}
+
+		if (slot != SIZE_MAX) {
+			slots[slot].index = frame;
+			slots[slot].used = decoded;
+		}
+		next = frame + 1;
+	}
+}
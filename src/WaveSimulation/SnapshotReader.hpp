@@ -0,0 +1,129 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "SnapshotCodec.hpp"
+
+namespace WaveSimulation {
+	// Snapshot stream mapped read only and indexed by frame. Frames are only touched when decoded
+	struct SnapshotReader {
+		//Maps path and indexes its frames up to the first truncated one
+		bool open(const char* path);
+		void close();
+
+		bool is_open() const { return data != nullptr; }
+		size_t frame_amount() const { return frames.size(); }
+		size_t raw_size() const { return header.planes * header.width * header.height * header.storage_size; }
+
+		const SnapshotFrame& frame(size_t i) const { return frames[i].frame; }
+		const char* payload(size_t i) const { return data + frames[i].offset + SNAPSHOT_FRAME_HEADER; }
+
+		//Last keyframe at or before frame i, decoding has to start there
+		size_t keyframe_of(size_t i) const { return frames[i].keyframe; }
+		//Last frame at or before time, 0 before the first
+		size_t frame_at(double time) const;
+
+		SnapshotHeader header{};
+
+	private:
+		struct Entry {
+			SnapshotFrame frame;
+			uint64_t offset;
+			size_t keyframe;
+		};
+
+		const char* data{ nullptr };
+		std::shared_ptr<void> owner;
+		std::vector<Entry> frames;
+	};
+
+	// Plays a snapshot stream back. A worker thread decodes the frames ahead of the playhead into a few buffers,
+	// current() hands out the latest decoded frame at or before it. The playhead moves in recorded time, speed 1
+	// plays frames_per_second frames of the recording per second. When the playhead runs ahead of the worker the
+	// frames in between are skipped, down to the keyframes lossless deltas need
+	struct SnapshotPlayer {
+		SnapshotPlayer() = default;
+		SnapshotPlayer(const SnapshotPlayer&) = delete;
+		SnapshotPlayer& operator=(const SnapshotPlayer&) = delete;
+		~SnapshotPlayer();
+
+		//buffers decoded frames are held in, decode_threads 0 uses all
+		bool open(const char* path, size_t buffers = 8, size_t decode_threads = 0);
+		void close();
+
+		//Moves the playhead by seconds of wall time times the speed unless paused, stops at the last frame
+		void advance(double seconds);
+		void seek(double time);
+		void seek_frame(size_t index);
+
+		//Latest decoded frame at or before the playhead and its index, nullptr while the worker has none yet.
+		//The frame stays valid until the next call
+		const char* current(size_t& index);
+
+		double start_time() const;
+		double end_time() const;
+
+		SnapshotReader reader;
+		double playhead{ 0 };
+		double speed{ 1 };
+		bool paused{ false };
+		double frames_per_second{ 30 };
+
+	private:
+		struct Slot {
+			std::vector<char> raw;
+			size_t index{ 0 };
+			bool used{ false };
+		};
+
+		void worker_loop();
+		void request(size_t target);
+
+		SnapshotDecoder* decoder{ nullptr };
+		double time_scale{ 1 }; //Recorded time per frame
+
+		std::vector<Slot> slots;
+		std::vector<char> skipped; //Frames decoded only for the deltas after them
+		size_t shown{ SIZE_MAX };  //Slot handed out by current()
+		size_t target{ 0 };        //Frame at the playhead
+		size_t next{ 0 };          //Frame the worker decodes next
+		bool restart{ false };     //Worker has to start over at the keyframe of target
+		bool closing{ false };
+
+		std::mutex lock;
+		std::condition_variable worker_cv;
+		std::thread thread;
+	};
+
+	//Copies a decoded snapshot into grid, resized to the snapshot when needed. The snapshot has to be of a grid
+	//of the same type, order and precision, decimation and region only change the size
+	template<typename Grid>
+	bool load_snapshot(Grid& grid, const SnapshotHeader& header, const char* raw) {
+		using S = typename Grid::S;
+
+		const CheckpointHeader expected = checkpoint_header(Grid{});
+		if (header.grid != expected.grid || header.order != expected.order || header.storage_size != expected.storage_size ||
+				strncmp(header.precision, expected.precision, sizeof(header.precision)) || header.planes != expected.planes)
+			return false;
+
+		if (grid.x_s != header.width || grid.y_s != header.height)
+			grid.resize(header.width, header.height);
+
+		const S* values = reinterpret_cast<const S*>(raw);
+		thread_pool().parallel_for(header.planes * header.height, [&](size_t i) {
+			const size_t n = i / header.height, y = i % header.height;
+			memcpy(grid.values.plane(n) + grid.values.index(0, y), values + i * header.width, header.width * sizeof(S));
+		});
+
+		//Tiles skipped by the last step no longer match nval
+		if constexpr (StagedGrid<Grid>)
+			grid.activity.synced = false;
+		grid.changes.mark(0, grid.y_s);
+		return true;
+	}
+}
@@ -0,0 +1,410 @@
+#include "SnapshotWriter.hpp"
+#include "SnapshotCodec.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef WAVESIM_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace WaveSimulation;
+
+//Largest single write, io_uring takes 32 bit lengths
+constexpr size_t MAX_WRITE = size_t(1) << 30;
+
+#ifdef WAVESIM_IO_URING
+// Submission and completion rings of an io_uring, set up with the raw system calls so there is no dependency
+// on liburing. Only writes are submitted and only the writer thread touches the rings
+struct SnapshotWriter::Ring {
+	int fd{ -1 };
+	unsigned *sq_head{ nullptr }, *sq_tail{ nullptr }, *sq_mask{ nullptr }, *sq_array{ nullptr };
+	unsigned *cq_head{ nullptr }, *cq_tail{ nullptr }, *cq_mask{ nullptr };
+	io_uring_sqe* sqes{ nullptr };
+	io_uring_cqe* cqes{ nullptr };
+	unsigned entries{ 0 };
+	unsigned pending{ 0 }; //Queued and not yet submitted
+
+	void* sq_ring{ MAP_FAILED };
+	void* cq_ring{ MAP_FAILED };
+	size_t sq_ring_size{ 0 }, cq_ring_size{ 0 }, sqes_size{ 0 };
+
+	bool setup(unsigned depth) {
+		io_uring_params params{};
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+		if (fd < 0)
+			return false;
+
+		sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+		const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single)
+			sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+		sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ring == MAP_FAILED)
+			return false;
+		cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED)
+			return false;
+		void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sqe_map == MAP_FAILED)
+			return false;
+		sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+		char* sq = static_cast<char*>(sq_ring);
+		char* cq = static_cast<char*>(cq_ring);
+		sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		entries = params.sq_entries;
+		return true;
+	}
+
+	~Ring() {
+		if (sqes)
+			munmap(sqes, sqes_size);
+		if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+			munmap(cq_ring, cq_ring_size);
+		if (sq_ring != MAP_FAILED)
+			munmap(sq_ring, sq_ring_size);
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	bool full() const {
+		return *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= entries;
+	}
+
+	void write(int file, const void* data, size_t size, uint64_t offset, void* user) {
+		const unsigned tail = *sq_tail;
+		const unsigned index = tail & *sq_mask;
+
+		io_uring_sqe& sqe = sqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_WRITE;
+		sqe.fd = file;
+		sqe.addr = reinterpret_cast<uint64_t>(data);
+		sqe.len = static_cast<uint32_t>(size);
+		sqe.off = offset;
+		sqe.user_data = reinterpret_cast<uint64_t>(user);
+
+		sq_array[index] = index;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		++pending;
+	}
+
+	//Submits the queued writes, with wait until at least one of them completed
+	bool enter(bool wait) {
+		for (;;) {
+			long res = syscall(__NR_io_uring_enter, fd, pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (res >= 0) {
+				pending -= std::min<unsigned>(pending, static_cast<unsigned>(res));
+				return true;
+			}
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				return false;
+		}
+	}
+
+	bool completion(void*& user, int& res) {
+		const unsigned head = *cq_head;
+		if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+			return false;
+
+		const io_uring_cqe& cqe = cqes[head & *cq_mask];
+		user = reinterpret_cast<void*>(cqe.user_data);
+		res = cqe.res;
+		__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+#else
+struct SnapshotWriter::Ring {};
+#endif
+
+//Writes size bytes at offset, retrying short writes
+static bool write_at(int fd, void* file, const char* data, size_t size, uint64_t offset) {
+#ifdef _WIN32
+	(void)fd;
+	(void)offset;
+	return std::fwrite(data, 1, size, static_cast<FILE*>(file)) == size;
+#else
+	(void)file;
+	while (size) {
+		ssize_t written = pwrite(fd, data, std::min(size, MAX_WRITE), offset);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= written;
+		offset += written;
+	}
+	return true;
+#endif
+}
+
+SnapshotWriter::~SnapshotWriter() {
+	close();
+}
+
+bool SnapshotWriter::start(const char* path, SnapshotHeader h) {
+	header = h;
+	frame_bytes = (SNAPSHOT_FRAME_HEADER + header.planes * header.width * header.height * header.storage_size + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+
+#ifdef _WIN32
+	file = std::fopen(path, "wb");
+	const bool opened = file != nullptr;
+#else
+	fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	const bool opened = fd >= 0;
+#endif
+	if (!opened) {
+		std::cout << "Failed to create snapshot stream " << path << std::endl;
+		return false;
+	}
+
+	std::vector<char> head(header.header_size, 0);
+	memcpy(head.data(), &header, sizeof(header));
+	if (!write_at(fd, file, head.data(), head.size(), 0)) {
+		std::cout << "Failed to write snapshot stream " << path << std::endl;
+		failed = true;
+		close();
+		return false;
+	}
+	offset = head.size();
+
+	//Zeroed once, the padding of the frames is never written to afterwards
+	buffers = std::vector<Buffer>(config.buffers);
+	free_buffers.clear();
+	for (Buffer& buffer : buffers) {
+		buffer.data.assign(frame_bytes, 0);
+		free_buffers.push_back(&buffer);
+	}
+
+	if (config.codec != SnapshotCodec::Raw) {
+		encoder = new SnapshotEncoder(header, config.codec, config.tolerance, config.keyframe_interval, config.encode_threads);
+		for (Buffer& buffer : buffers)
+			buffer.encoded.assign(SNAPSHOT_FRAME_HEADER + encoder->bound() + FIELD_ALIGNMENT, 0);
+	}
+
+#ifdef WAVESIM_IO_URING
+	if (config.io_uring) {
+		ring = new Ring;
+		if (!ring->setup(static_cast<unsigned>(std::min<size_t>(config.buffers, 64)))) {
+			delete ring;
+			ring = nullptr;
+		}
+	}
+#endif
+	io_uring_used = ring != nullptr;
+
+	frames_written = 0;
+	bytes_written = offset;
+	raw_bytes = 0;
+	encode_seconds = 0;
+	frames_dropped = 0;
+	capture_seconds = 0;
+	failed = false;
+	closing = false;
+	thread = std::thread([this] { writer_loop(); });
+	return true;
+}
+
+void SnapshotWriter::close() {
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			closing = true;
+		}
+		queued_cv.notify_one();
+		thread.join();
+	}
+
+	delete ring;
+	ring = nullptr;
+	delete encoder;
+	encoder = nullptr;
+
+#ifdef _WIN32
+	if (file)
+		std::fclose(static_cast<FILE*>(file));
+	file = nullptr;
+#else
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+
+	buffers.clear();
+	free_buffers.clear();
+	queue.clear();
+}
+
+SnapshotWriter::Buffer* SnapshotWriter::acquire() {
+	std::unique_lock<std::mutex> guard(lock);
+
+	if (free_buffers.empty()) {
+		if (config.drop_when_full || failed) {
+			++frames_dropped;
+			return nullptr;
+		}
+		free_cv.wait(guard, [this] { return !free_buffers.empty() || failed; });
+		if (free_buffers.empty()) {
+			++frames_dropped;
+			return nullptr;
+		}
+	}
+
+	Buffer* buffer = free_buffers.back();
+	free_buffers.pop_back();
+	return buffer;
+}
+
+void SnapshotWriter::submit(Buffer* buffer) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(buffer);
+	}
+	queued_cv.notify_one();
+}
+
+void SnapshotWriter::release(Buffer* buffer) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		free_buffers.push_back(buffer);
+	}
+	free_cv.notify_one();
+}
+
+void SnapshotWriter::written(const Buffer* buffer) {
+	++frames_written;
+	bytes_written += buffer->size;
+	raw_bytes += reinterpret_cast<const SnapshotFrame*>(buffer->data.data())->raw_size;
+}
+
+//Frames after a failed write are handed back unwritten, the stream ends with the last complete frame
+void SnapshotWriter::write_buffer(Buffer* buffer) {
+	if (failed) {
+		release(buffer);
+		return;
+	}
+
+	buffer->out = buffer->data.data();
+	if (encoder) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		SnapshotFrame frame;
+		memcpy(&frame, buffer->data.data(), sizeof(frame));
+		const size_t payload = encoder->encode(frame, buffer->data.data() + SNAPSHOT_FRAME_HEADER, buffer->encoded.data() + SNAPSHOT_FRAME_HEADER);
+		memcpy(buffer->encoded.data(), &frame, sizeof(frame));
+
+		//Encoded frames change in size, their padding is cleared every time
+		buffer->size = (SNAPSHOT_FRAME_HEADER + payload + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+		memset(buffer->encoded.data() + SNAPSHOT_FRAME_HEADER + payload, 0, buffer->size - SNAPSHOT_FRAME_HEADER - payload);
+		buffer->out = buffer->encoded.data();
+
+		encode_seconds = encode_seconds + std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	buffer->at = offset;
+	offset += buffer->size;
+
+#ifdef WAVESIM_IO_URING
+	if (ring && buffer->size <= MAX_WRITE) {
+		while (ring->full())
+			if (!reap(true))
+				return;
+		ring->write(fd, buffer->out, buffer->size, buffer->at, buffer);
+		++in_flight;
+		return;
+	}
+#endif
+
+	if (write_at(fd, file, buffer->out, buffer->size, buffer->at)) {
+		written(buffer);
+	} else {
+		std::cout << "Failed to write snapshot at step " << reinterpret_cast<const SnapshotFrame*>(buffer->data.data())->step << std::endl;
+		failed = true;
+	}
+	release(buffer);
+}
+
+//Submits what write_buffer queued and hands back the buffers whose writes completed, false when the ring failed
+bool SnapshotWriter::reap(bool wait) {
+#ifdef WAVESIM_IO_URING
+	if (!ring->enter(wait)) {
+		std::cout << "Failed to submit snapshot writes" << std::endl;
+		failed = true;
+		return false;
+	}
+
+	void* user;
+	int res;
+	while (ring->completion(user, res)) {
+		Buffer* buffer = static_cast<Buffer*>(user);
+
+		//A short write is finished synchronously, it only happens on a full disk or a signal
+		if (res >= 0 && static_cast<size_t>(res) < buffer->size && !write_at(fd, file, buffer->out + res, buffer->size - res, buffer->at + res))
+			res = -EIO;
+
+		if (res < 0 && !failed) {
+			std::cout << "Failed to write snapshot at step " << reinterpret_cast<const SnapshotFrame*>(buffer->data.data())->step << std::endl;
+			failed = true;
+		} else if (!failed) {
+			written(buffer);
+		}
+
+		--in_flight;
+		release(buffer);
+	}
+#else
+	(void)wait;
+#endif
+	return true;
+}
+
+//Takes every queued buffer at once, with io_uring they go out in one submission and the thread only waits
+//for completions when there is nothing new to submit
+void SnapshotWriter::writer_loop() {
+	std::deque<Buffer*> batch;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if (!in_flight)
+				queued_cv.wait(guard, [this] { return !queue.empty() || closing; });
+
+			if (queue.empty() && closing && !in_flight)
+				return;
+			batch.swap(queue);
+		}
+
+		const bool submitted = !batch.empty();
+		for (Buffer* buffer : batch)
+			write_buffer(buffer);
+		batch.clear();
+
+		//A broken ring leaves its writes unaccounted, the stream stops there and offer() drops from now on
+		if (ring && !reap(in_flight && !submitted)) {
+			free_cv.notify_all();
+			return;
+		}
+	}
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "Checkpoint.hpp"
+#include "ThreadPool.hpp"
+
+namespace WaveSimulation {
+	// Snapshot stream of the values of a grid:
+	//   SnapshotHeader, zero padded to header_size
+	//   frames of a SnapshotFrame and its payload, zero padded to a multiple of FIELD_ALIGNMENT. The payload starts
+	//   SNAPSHOT_FRAME_HEADER bytes into the frame, so a mapped stream keeps the alignment of the planes
+	// A raw payload holds every plane of the field over the region of interest, every decimation-th cell per axis,
+	// plane after plane in rows of width values of the storage type. The other codecs are in SnapshotCodec.hpp.
+	// The stream ends with the last complete frame, a reader stops at the first truncated one
+	constexpr uint32_t SNAPSHOT_VERSION = 1;
+	constexpr size_t SNAPSHOT_FRAME_HEADER = FIELD_ALIGNMENT;
+
+	enum class SnapshotCodec : uint32_t {
+		Raw,
+		Lossless, //Delta against the frame before, byte shuffle and rANS
+		Lossy,    //Error bounded 4x4 block transform
+	};
+
+	const char* snapshot_codec_name(SnapshotCodec codec);
+
+	//SnapshotFrame::flags
+	constexpr uint32_t SNAPSHOT_KEYFRAME = 1; //Decodes without the frame before
+
+	struct SnapshotHeader {
+		char magic[8];         //"WAVESNAP"
+		uint32_t version;
+		uint32_t byte_order;   //CHECKPOINT_BYTE_ORDER as written
+		uint32_t header_size;  //Bytes before the first frame
+		CheckpointGrid grid;
+		uint32_t order;        //Element order, 0 for the simple grid
+		uint32_t storage_size; //Bytes per value
+		char precision[8];     //Precision::name
+
+		uint64_t planes;
+		uint64_t x_size, y_size; //Grid
+		uint64_t x0, y0, x1, y1; //Region of interest
+		uint64_t decimation;
+		uint64_t width, height;  //Values per row and rows per plane of a frame
+	};
+
+	struct SnapshotFrame {
+		uint64_t step;
+		double time;
+		SnapshotCodec codec;
+		uint32_t flags;
+		uint64_t payload_size; //Bytes following this header
+		uint64_t raw_size;     //Bytes of the payload decoded
+		double tolerance;      //Largest error of a lossy payload
+	};
+	static_assert(sizeof(SnapshotFrame) <= SNAPSHOT_FRAME_HEADER);
+
+	struct SnapshotConfig {
+		size_t interval{ 1 };        //Steps between snapshots, offer() takes the steps divisible by it
+		size_t x0{ 0 }, y0{ 0 };
+		size_t x1{ 0 }, y1{ 0 };     //Region of interest [x0, x1) x [y0, y1), 0 extends it to the grid edge
+		size_t decimation{ 1 };      //Cells per axis between two written ones
+		size_t buffers{ 3 };         //Snapshots in memory: queued, being written or free, at least 2
+		bool drop_when_full{ true }; //Without free buffer offer() drops the snapshot instead of waiting for the disk
+		bool io_uring{ true };       //Write through io_uring where the kernel offers it, pwrite otherwise
+
+		SnapshotCodec codec{ SnapshotCodec::Raw };
+		double tolerance{ 0 };           //Largest absolute error of the lossy codec
+		size_t keyframe_interval{ 32 };  //Frames between lossless frames that decode on their own
+		size_t encode_threads{ 0 };      //Threads encoding a frame, 0 uses all
+	};
+
+	// Streams snapshots of a grid to a file on a thread of its own. offer() copies the region of interest into
+	// a free buffer and queues it, the writer thread writes the queued buffers in large sequential writes and
+	// hands them back. With io_uring all queued buffers are submitted at once and written while the thread
+	// waits for more. Compressed frames are encoded on the writer thread and a pool of its own, the stepping
+	// thread only waits when every buffer is in use and drop_when_full is off
+	struct SnapshotEncoder;
+
+	struct SnapshotWriter {
+		SnapshotWriter() = default;
+		SnapshotWriter(const SnapshotWriter&) = delete;
+		SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+		~SnapshotWriter();
+
+		//Creates path and writes the stream header for snapshots of grid
+		template<typename Grid>
+		bool open(const char* path, const Grid& grid, const SnapshotConfig& config = {});
+
+		//Snapshot of grid after step, at time. False when the step is skipped by the interval or dropped
+		template<typename Grid>
+		bool offer(const Grid& grid, uint64_t step, double time);
+
+		//Writes everything queued and closes the file
+		void close();
+
+		bool is_open() const { return thread.joinable(); }
+		bool uses_io_uring() const { return io_uring_used; } //Also after close()
+		size_t frame_size() const { return frame_bytes; }
+
+		//Totals of the stream, exact once closed
+		std::atomic<size_t> frames_written{ 0 };
+		std::atomic<uint64_t> bytes_written{ 0 };
+		std::atomic<uint64_t> raw_bytes{ 0 };  //Payload bytes of the written frames before encoding
+		std::atomic<double> encode_seconds{ 0 };
+		size_t frames_dropped{ 0 };
+		double capture_seconds{ 0 }; //Stepping thread time in offer(), copying and waiting for buffers
+		std::atomic<bool> failed{ false }; //A write failed, the stream ends before it
+
+	private:
+		struct Buffer {
+			std::vector<char, AlignedAllocator<char>> data;
+			std::vector<char, AlignedAllocator<char>> encoded; //Frame written in place of data unless raw
+			const char* out{ nullptr };
+			size_t size{ 0 }; //Bytes to write
+			uint64_t at{ 0 }; //Offset in the file
+		};
+
+		struct Ring;
+
+		bool start(const char* path, SnapshotHeader header);
+		//A free buffer, nullptr when the snapshot has to be dropped
+		Buffer* acquire();
+		void submit(Buffer* buffer);
+		void release(Buffer* buffer);
+		void writer_loop();
+		void write_buffer(Buffer* buffer);
+		void written(const Buffer* buffer);
+		bool reap(bool wait);
+
+		SnapshotConfig config;
+		SnapshotHeader header{};
+		size_t frame_bytes{ 0 };
+
+		std::vector<Buffer> buffers;
+		std::vector<Buffer*> free_buffers;
+		std::deque<Buffer*> queue;
+		std::mutex lock;
+		std::condition_variable queued_cv; //Buffer queued or closing
+		std::condition_variable free_cv;   //Buffer handed back
+		bool closing{ false };
+
+		std::thread thread;
+		int fd{ -1 };
+		void* file{ nullptr }; //FILE* where there is no pwrite
+		uint64_t offset{ 0 };
+		Ring* ring{ nullptr };
+		size_t in_flight{ 0 }; //Buffers submitted to the ring and not completed
+		SnapshotEncoder* encoder{ nullptr };
+		bool io_uring_used{ false };
+	};
+
+	//Header of the snapshots of grid under config, clamps the region of config to the grid
+	template<typename Grid>
+	SnapshotHeader snapshot_header(const Grid& grid, SnapshotConfig& config) {
+		config.interval = std::max(config.interval, size_t(1));
+		config.decimation = std::max(config.decimation, size_t(1));
+		config.buffers = std::max(config.buffers, size_t(2));
+		config.x1 = config.x1 ? std::min(config.x1, grid.x_s) : grid.x_s;
+		config.y1 = config.y1 ? std::min(config.y1, grid.y_s) : grid.y_s;
+		config.x0 = std::min(config.x0, config.x1);
+		config.y0 = std::min(config.y0, config.y1);
+
+		const CheckpointHeader grid_header = checkpoint_header(grid);
+
+		SnapshotHeader h{};
+		memcpy(h.magic, "WAVESNAP", 8);
+		h.version = SNAPSHOT_VERSION;
+		h.byte_order = CHECKPOINT_BYTE_ORDER;
+		h.header_size = (sizeof(SnapshotHeader) + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+		h.grid = grid_header.grid;
+		h.order = grid_header.order;
+		h.storage_size = grid_header.storage_size;
+		memcpy(h.precision, grid_header.precision, sizeof(h.precision));
+		h.planes = Grid::Field::plane_amount;
+		h.x_size = grid.x_s;
+		h.y_size = grid.y_s;
+		h.x0 = config.x0;
+		h.y0 = config.y0;
+		h.x1 = config.x1;
+		h.y1 = config.y1;
+		h.decimation = config.decimation;
+		h.width = (config.x1 - config.x0 + config.decimation - 1) / config.decimation;
+		h.height = (config.y1 - config.y0 + config.decimation - 1) / config.decimation;
+		return h;
+	}
+
+	//Copies the raw payload of a snapshot of grid into out. Rows are copied in parallel, undecimated ones with memcpy
+	template<typename Grid>
+	void capture_snapshot(const Grid& grid, const SnapshotHeader& header, char* out) {
+		using S = typename Grid::S;
+
+		const size_t width = header.width, height = header.height, d = header.decimation;
+		S* values = reinterpret_cast<S*>(out);
+
+		thread_pool().parallel_for(header.planes * height, [&](size_t i) {
+			const size_t n = i / height, y = i % height;
+			const S* row = grid.values.plane(n) + grid.values.index(header.x0, header.y0 + y * d);
+			S* dst = values + i * width;
+
+			if (d == 1) {
+				memcpy(dst, row, width * sizeof(S));
+			} else {
+				for (size_t x = 0; x < width; ++x)
+					dst[x] = row[x * d];
+			}
+		});
+	}
+
+	template<typename Grid>
+	bool SnapshotWriter::open(const char* path, const Grid& grid, const SnapshotConfig& conf) {
+		close();
+		config = conf;
+		const SnapshotHeader h = snapshot_header(grid, config);
+
+		if (config.codec == SnapshotCodec::Lossy && !(config.tolerance > 0)) {
+			std::cout << "The lossy snapshot codec needs a tolerance above 0" << std::endl;
+			return false;
+		}
+
+		if (!h.width || !h.height) {
+			std::cout << "Snapshot region " << conf.x0 << "," << conf.y0 << " to " << config.x1 << "," << config.y1 << " is empty" << std::endl;
+			return false;
+		}
+
+		return start(path, h);
+	}
+
+	template<typename Grid>
+	bool SnapshotWriter::offer(const Grid& grid, uint64_t step, double time) {
+		if (!is_open() || step % config.interval)
+			return false;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Buffer* buffer = acquire();
+		if (buffer) {
+			const uint64_t raw = header.planes * header.width * header.height * header.storage_size;
+			const SnapshotFrame frame{ step, time, SnapshotCodec::Raw, SNAPSHOT_KEYFRAME, raw, raw, 0 };
+			memcpy(buffer->data.data(), &frame, sizeof(frame));
+			capture_snapshot(grid, header, buffer->data.data() + SNAPSHOT_FRAME_HEADER);
+
+			buffer->size = frame_bytes;
+			submit(buffer);
+		}
+
+		capture_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return buffer != nullptr;
+	}
+}
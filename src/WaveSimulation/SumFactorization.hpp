@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+
+namespace WaveSimulation {
+	// Operators of a tensor product element with n nodes per axis, node i + n * j at (x_i, y_j).
+	// An operator that acts along one axis only is the Kronecker product of a 1D operator with the identity,
+	// applied line by line it costs n^3 per element instead of the n^4 of its dense n^2 x n^2 matrix.
+	// Face traces and lifts are n x 1 and 1 x n operators, n^2 per face.
+	// The y variants walk the nodes contiguously, the x variants stride by n
+	template<size_t n, typename T>
+	using NodeValues = std::array<T, n * n>;
+
+	template<size_t n, typename T>
+	using Operator1D = std::array<std::array<T, n>, n>;
+
+	//out[i + n j] = sum_q op[i][q] in[q + n j]
+	template<size_t n, typename T>
+	inline void apply_x(const Operator1D<n, T>& op, const NodeValues<n, T>& in, NodeValues<n, T>& out) {
+		for (size_t j = 0; j < n; ++j)
+			for (size_t i = 0; i < n; ++i) {
+				T sum(0);
+				for (size_t q = 0; q < n; ++q)
+					sum += op[i][q] * in[q + n * j];
+				out[i + n * j] = sum;
+			}
+	}
+
+	//out[i + n j] = sum_q op[j][q] in[i + n q]
+	template<size_t n, typename T>
+	inline void apply_y(const Operator1D<n, T>& op, const NodeValues<n, T>& in, NodeValues<n, T>& out) {
+		for (size_t j = 0; j < n; ++j) {
+			for (size_t i = 0; i < n; ++i)
+				out[i + n * j] = T(0);
+			for (size_t q = 0; q < n; ++q)
+				for (size_t i = 0; i < n; ++i)
+					out[i + n * j] += op[j][q] * in[i + n * q];
+		}
+	}
+
+	//Trace on a face across x, trace[j] = sum_i at[i] in[i + n j]
+	template<size_t n, typename T>
+	inline void trace_x(const std::array<T, n>& at, const NodeValues<n, T>& in, std::array<T, n>& trace) {
+		for (size_t j = 0; j < n; ++j) {
+			T sum(0);
+			for (size_t i = 0; i < n; ++i)
+				sum += at[i] * in[i + n * j];
+			trace[j] = sum;
+		}
+	}
+
+	//Trace on a face across y, trace[i] = sum_j at[j] in[i + n j]
+	template<size_t n, typename T>
+	inline void trace_y(const std::array<T, n>& at, const NodeValues<n, T>& in, std::array<T, n>& trace) {
+		trace.fill(T(0));
+		for (size_t j = 0; j < n; ++j)
+			for (size_t i = 0; i < n; ++i)
+				trace[i] += at[j] * in[i + n * j];
+	}
+
+	//out[i + n j] += lift[i] face[j], the transpose of trace_x
+	template<size_t n, typename T>
+	inline void lift_x(const std::array<T, n>& lift, const std::array<T, n>& face, NodeValues<n, T>& out) {
+		for (size_t j = 0; j < n; ++j)
+			for (size_t i = 0; i < n; ++i)
+				out[i + n * j] += lift[i] * face[j];
+	}
+
+	//out[i + n j] += lift[j] face[i], the transpose of trace_y
+	template<size_t n, typename T>
+	inline void lift_y(const std::array<T, n>& lift, const std::array<T, n>& face, NodeValues<n, T>& out) {
+		for (size_t j = 0; j < n; ++j)
+			for (size_t i = 0; i < n; ++i)
+				out[i + n * j] += lift[j] * face[i];
+	}
+}
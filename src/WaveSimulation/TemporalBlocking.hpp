@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include "Boundary.hpp"
+#include "Tiling.hpp"
+
+namespace WaveSimulation {
+	// Overlapped temporal blocking. Every tile is copied into a per thread scratch field together with a
+	// depth cells wide halo, advanced depth steps there while it stays in cache and written back to nval.
+	// The valid part of the halo shrinks by one cell per step, so after depth steps the tile is exactly what
+	// depth single steps produce. Halo cells are computed redundantly by the neighbouring tiles, in exchange
+	// values and nval are streamed once per depth steps instead of once per step.
+	//
+	// step( in, out, region ) advances the cells of region from in to out. ghost( field, x, y, src_x, src_y, axis )
+	// fills one ghost cell like update_ghosts() does. Both get coordinates of the scratch field.
+	// The ghosts of values have to be filled, depth has to be at most x_s and y_s
+	template<typename Field, typename StepFunc, typename GhostFunc>
+	void step_temporal_block( const Field& values, Field& nval, size_t x_s, size_t y_s, const TileConfig& conf,
+			BoundaryPolicy boundary, size_t depth, StepFunc&& step, GhostFunc&& ghost ){
+		using T = typename Field::value_type;
+		using coord = ptrdiff_t;
+
+		struct Scratch {
+			Field a, b;
+			size_t x_s{ 0 }, y_s{ 0 };
+		};
+
+		const bool periodic = boundary == BoundaryPolicy::Periodic;
+		const coord X = x_s, Y = y_s, d = depth;
+
+		//Every tile fits the scratch of the largest one
+		const size_t box_x = ( conf.x && conf.x < x_s ? conf.x : x_s ) + 2 * depth;
+		const size_t box_y = ( conf.y && conf.y < y_s ? conf.y : y_s ) + 2 * depth;
+
+		auto wrap = []( coord c, coord size ){
+			return c < 0 ? c + size : c >= size ? c - size : c;
+		};
+
+		auto copy = []( const Field& src, size_t src_index, Field& dst, size_t dst_index, size_t amount ){
+			for( size_t p = 0; p < Field::plane_amount; ++p )
+				memcpy( dst.plane( p ) + dst_index, src.plane( p ) + src_index, amount * sizeof( T ));
+		};
+
+		for_each_tile( x_s, y_s, conf, [&]( const Tile& tile ){
+			thread_local Scratch scratch;
+			if( scratch.x_s != box_x || scratch.y_s != box_y ){
+				scratch.a.resize( box_x, box_y );
+				scratch.b.resize( box_x, box_y );
+				scratch.x_s = box_x;
+				scratch.y_s = box_y;
+			}
+
+			//Box of global cells held in the scratch. Without periodic wrap it ends at the ghost layer
+			coord bx0 = coord( tile.x0 ) - d, bx1 = coord( tile.x1 ) + d;
+			coord by0 = coord( tile.y0 ) - d, by1 = coord( tile.y1 ) + d;
+			if( !periodic ){
+				bx0 = bx0 < -1 ? -1 : bx0;
+				by0 = by0 < -1 ? -1 : by0;
+				bx1 = bx1 > X + 1 ? X + 1 : bx1;
+				by1 = by1 > Y + 1 ? Y + 1 : by1;
+			}
+
+			for( coord ly = 0; ly < by1 - by0; ++ly ){
+				coord gy = periodic ? wrap( by0 + ly, Y ) : by0 + ly;
+
+				for( coord lx = 0; lx < bx1 - bx0; ){
+					coord gx = periodic ? wrap( bx0 + lx, X ) : bx0 + lx;
+					coord amount = periodic && X - gx < bx1 - bx0 - lx ? X - gx : bx1 - bx0 - lx;
+
+					copy( values, values.index( gx, gy ), scratch.a, scratch.a.index( lx, ly ), amount );
+					lx += amount;
+				}
+			}
+
+			Field* in = &scratch.a;
+			Field* out = &scratch.b;
+
+			for( coord s = 1; s <= d; ++s ){
+				coord rx0 = coord( tile.x0 ) - d + s, rx1 = coord( tile.x1 ) + d - s;
+				coord ry0 = coord( tile.y0 ) - d + s, ry1 = coord( tile.y1 ) + d - s;
+				if( !periodic ){
+					rx0 = rx0 < 0 ? 0 : rx0;
+					ry0 = ry0 < 0 ? 0 : ry0;
+					rx1 = rx1 > X ? X : rx1;
+					ry1 = ry1 > Y ? Y : ry1;
+				}
+
+				Tile region{
+					size_t( rx0 - bx0 ), size_t( rx1 - bx0 ),
+					size_t( ry0 - by0 ), size_t( ry1 - by0 ),
+					rx0 == 0, rx1 == X, ry0 == 0, ry1 == Y,
+				};
+
+				step( *in, *out, region );
+
+				//The ghost layer follows the cells next to it, like update_ghosts() between single steps
+				if( !periodic && s != d ){
+					size_t lw = bx1 - bx0, lh = by1 - by0;
+
+					for( size_t ly = region.y0; ly < region.y1; ++ly ){
+						if( bx0 == -1 )
+							ghost( *out, 0, ly, 1, ly, Axis::X );
+						if( bx1 == X + 1 )
+							ghost( *out, lw - 1, ly, lw - 2, ly, Axis::X );
+					}
+					for( size_t lx = region.x0; lx < region.x1; ++lx ){
+						if( by0 == -1 )
+							ghost( *out, lx, 0, lx, 1, Axis::Y );
+						if( by1 == Y + 1 )
+							ghost( *out, lx, lh - 1, lx, lh - 2, Axis::Y );
+					}
+				}
+
+				Field* tmp = in;
+				in = out;
+				out = tmp;
+			}
+
+			for( size_t y = tile.y0; y < tile.y1; ++y )
+				copy( *in, in->index( tile.x0 - bx0, y - by0 ), nval, nval.index( tile.x0, y ), tile.x1 - tile.x0 );
+		});
+	}
+}
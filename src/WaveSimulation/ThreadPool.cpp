@@ -0,0 +1,171 @@
+#include "ThreadPool.hpp"
+
+#include <cstdlib>
+
+using namespace WaveSimulation;
+
+//Index of the queue owned by the current thread, callers outside the pool use queue 0
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+static size_t resolve_thread_amount( size_t threads ){
+	if( threads )
+		return threads;
+
+	size_t hw = std::thread::hardware_concurrency();
+	return hw ? hw : 1;
+}
+
+ThreadPool::ThreadPool( size_t threads ){
+	start( resolve_thread_amount( threads ));
+}
+
+ThreadPool::~ThreadPool(){
+	stop();
+}
+
+void ThreadPool::resize( size_t threads ){
+	threads = resolve_thread_amount( threads );
+	if( threads == thread_amount() )
+		return;
+
+	stop();
+	start( threads );
+}
+
+void ThreadPool::start( size_t threads ){
+	stopping = false;
+
+	queues.clear();
+	for( size_t i = 0; i < threads; ++i )
+		queues.push_back( std::make_unique<Queue>() );
+
+	for( size_t i = 1; i < threads; ++i )
+		workers.emplace_back( &ThreadPool::worker_loop, this, i );
+}
+
+void ThreadPool::stop(){
+	{
+		std::lock_guard<std::mutex> guard( sleep_lock );
+		stopping = true;
+	}
+	sleep_cv.notify_all();
+
+	for( auto& worker: workers )
+		worker.join();
+	workers.clear();
+
+	//Tasks left behind run on the caller, nobody else would pick them up
+	while( run_one( 0 ));
+}
+
+void ThreadPool::submit( Task task ){
+	size_t index = current_pool == this ? current_index : next_queue++ % queues.size();
+
+	{
+		std::lock_guard<std::mutex> guard( queues[index]->lock );
+		queues[index]->tasks.push_back( std::move( task ));
+	}
+
+	{
+		std::lock_guard<std::mutex> guard( sleep_lock );
+		++queued;
+	}
+	sleep_cv.notify_one();
+}
+
+bool ThreadPool::run_one( size_t index ){
+	Task task;
+
+	for( size_t i = 0; i < queues.size() && !task; ++i ){
+		Queue& queue = *queues[( index + i ) % queues.size()];
+
+		std::lock_guard<std::mutex> guard( queue.lock );
+		if( queue.tasks.empty() )
+			continue;
+
+		//Own queue from the back (most recently pushed, still warm), others from the front
+		if( i == 0 ){
+			task = std::move( queue.tasks.back() );
+			queue.tasks.pop_back();
+		} else {
+			task = std::move( queue.tasks.front() );
+			queue.tasks.pop_front();
+		}
+	}
+
+	if( !task )
+		return false;
+
+	--queued;
+	task();
+	return true;
+}
+
+void ThreadPool::worker_loop( size_t index ){
+	current_pool = this;
+	current_index = index;
+
+	for( ;; ){
+		if( run_one( index ))
+			continue;
+
+		std::unique_lock<std::mutex> guard( sleep_lock );
+		sleep_cv.wait( guard, [this]{ return stopping || queued > 0; });
+		if( stopping )
+			return;
+	}
+}
+
+void ThreadPool::parallel_for( size_t amount, const std::function<void( size_t )>& func ){
+	if( queues.size() == 1 || amount <= 1 ){
+		for( size_t i = 0; i < amount; ++i )
+			func( i );
+		return;
+	}
+
+	//A few chunks per thread leaves room for stealing without paying a task per index
+	size_t chunks = queues.size() * 4 < amount ? queues.size() * 4 : amount;
+	size_t chunk_size = ( amount + chunks - 1 ) / chunks;
+
+	std::atomic<size_t> remaining{ amount };
+
+	//Chunks are spread over all queues so the workers start without stealing
+	for( size_t begin = 0, c = 0; begin < amount; begin += chunk_size, ++c ){
+		size_t end = begin + chunk_size < amount ? begin + chunk_size : amount;
+		Task task = [&func, &remaining, begin, end]{
+			for( size_t i = begin; i < end; ++i )
+				func( i );
+			remaining -= end - begin;
+		};
+
+		Queue& queue = *queues[c % queues.size()];
+		{
+			std::lock_guard<std::mutex> guard( queue.lock );
+			queue.tasks.push_back( std::move( task ));
+		}
+		{
+			std::lock_guard<std::mutex> guard( sleep_lock );
+			++queued;
+		}
+	}
+	sleep_cv.notify_all();
+
+	size_t index = current_pool == this ? current_index : 0;
+	while( remaining ){
+		if( !run_one( index ))
+			std::this_thread::yield();
+	}
+}
+
+ThreadPool& WaveSimulation::thread_pool(){
+	static ThreadPool pool([]{
+		const char* env = std::getenv( "WAVESIM_THREADS" );
+		return env ? std::strtoull( env, nullptr, 10 ) : 0ull;
+	}());
+	return pool;
+}
+
+void WaveSimulation::set_thread_amount( size_t threads ){
+	thread_pool().resize( threads );
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WaveSimulation {
+	// Work stealing pool. Every worker owns a deque, takes new work from its back and steals
+	// from the front of the others when it runs dry. The thread calling parallel_for works as
+	// worker 0 until its loop is done, so nested loops can not deadlock
+	struct ThreadPool {
+		using Task = std::function<void()>;
+
+		// threads includes the calling thread, 0 uses std::thread::hardware_concurrency()
+		explicit ThreadPool( size_t threads = 0 );
+		~ThreadPool();
+
+		ThreadPool( const ThreadPool& ) = delete;
+		ThreadPool& operator=( const ThreadPool& ) = delete;
+
+		void resize( size_t threads );
+		size_t thread_amount() const { return queues.size(); }
+
+		// Queues a task, from a worker it goes to the workers own deque
+		void submit( Task task );
+
+		// Calls func( i ) for every i in [0, amount) and returns once all calls are done.
+		// Indices are handed out in chunks, which thread runs which index is unspecified
+		void parallel_for( size_t amount, const std::function<void( size_t )>& func );
+
+	private:
+		struct Queue {
+			std::mutex lock;
+			std::deque<Task> tasks;
+		};
+
+		void start( size_t threads );
+		void stop();
+		void worker_loop( size_t index );
+
+		// Pops from the own queue or steals from another one, false if every queue was empty
+		bool run_one( size_t index );
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex sleep_lock;
+		std::condition_variable sleep_cv;
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<size_t> next_queue{ 0 };
+		bool stopping{ false };
+	};
+
+	// Pool the grid steppers run on. Sized by the WAVESIM_THREADS environment variable if set,
+	// all hardware threads otherwise
+	ThreadPool& thread_pool();
+
+	// Runtime thread count setting, 0 uses all hardware threads
+	void set_thread_amount( size_t threads );
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include "ThreadPool.hpp"
+
+namespace WaveSimulation {
+	// Tile extent in cells. Rows inside a tile are walked contiguously, so the three rows a
+	// stencil touches stay in cache for the whole tile instead of the whole grid width
+	struct TileConfig {
+		size_t x{ 1024 };
+		size_t y{ 64 };
+	};
+
+	// Cells [x0, x1) x [y0, y1). The flags mark edges lying on the grid boundary, those read the
+	// ghost cells of the field, every other edge reads the neighbouring tile as its halo
+	struct Tile {
+		size_t x0, x1;
+		size_t y0, y1;
+
+		bool boundary_xn, boundary_xp;
+		bool boundary_yn, boundary_yp;
+
+		inline bool interior() const {
+			return !( boundary_xn || boundary_xp || boundary_yn || boundary_yp );
+		}
+	};
+
+	inline size_t tile_amount( size_t x_s, size_t y_s, const TileConfig& conf ){
+		size_t tx = conf.x ? conf.x : x_s;
+		size_t ty = conf.y ? conf.y : y_s;
+		return (( x_s + tx - 1 ) / tx ) * (( y_s + ty - 1 ) / ty );
+	}
+
+	// Tile number i of the grid in row-major tile order. A size of 0 spans the whole axis
+	inline Tile get_tile( size_t x_s, size_t y_s, const TileConfig& conf, size_t i ){
+		size_t tx = conf.x ? conf.x : x_s;
+		size_t ty = conf.y ? conf.y : y_s;
+		size_t tiles_x = ( x_s + tx - 1 ) / tx;
+
+		Tile tile;
+		tile.x0 = i % tiles_x * tx;
+		tile.y0 = i / tiles_x * ty;
+		tile.x1 = tile.x0 + tx < x_s ? tile.x0 + tx : x_s;
+		tile.y1 = tile.y0 + ty < y_s ? tile.y0 + ty : y_s;
+
+		tile.boundary_xn = tile.x0 == 0;
+		tile.boundary_xp = tile.x1 == x_s;
+		tile.boundary_yn = tile.y0 == 0;
+		tile.boundary_yp = tile.y1 == y_s;
+
+		return tile;
+	}
+
+	// Runs func( tile ) for every tile on thread_pool(). Tiles may only write their own cells,
+	// then the result does not depend on the thread count or the order tiles are finished in
+	template<typename Func>
+	inline void for_each_tile( size_t x_s, size_t y_s, const TileConfig& conf, Func&& func ){
+		thread_pool().parallel_for( tile_amount( x_s, y_s, conf ), [&]( size_t i ){
+			func( get_tile( x_s, y_s, conf, i ));
+		});
+	}
+
+	// Tiles of conf laid over the cells of region only, the edges of region keep its boundary flags
+	template<typename Func>
+	inline void for_each_tile( const Tile& region, const TileConfig& conf, Func&& func ){
+		const size_t x_s = region.x1 - region.x0, y_s = region.y1 - region.y0;
+
+		thread_pool().parallel_for( tile_amount( x_s, y_s, conf ), [&]( size_t i ){
+			Tile tile = get_tile( x_s, y_s, conf, i );
+
+			tile.boundary_xn = tile.boundary_xn && region.boundary_xn;
+			tile.boundary_xp = tile.boundary_xp && region.boundary_xp;
+			tile.boundary_yn = tile.boundary_yn && region.boundary_yn;
+			tile.boundary_yp = tile.boundary_yp && region.boundary_yp;
+			tile.x0 += region.x0;
+			tile.x1 += region.x0;
+			tile.y0 += region.y0;
+			tile.y1 += region.y0;
+
+			func( tile );
+		});
+	}
+
+	// Walks the tile row by row and calls func( x, y ). Neighbours x - 1, x + 1, y - 1, y + 1 always
+	// exist as ghost cells, so stencils need no boundary checks
+	template<typename Func>
+	inline void for_each_cell( const Tile& tile, Func&& func ){
+		for( size_t y = tile.y0; y < tile.y1; ++y )
+			for( size_t x = tile.x0; x < tile.x1; ++x )
+				func( x, y );
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+namespace WaveSimulation {
+	// Strong stability preserving Runge-Kutta methods. SSPRK2 is in Shu-Osher form, every stage is
+	// u_s = a_s * u_0 + b_s * ( u_s-1 + dt * L( u_s-1 )), so it runs in the two fields of a forward Euler step.
+	// SSPRK3 is Williamson's 2N scheme, TVD up to a CFL of 0.32 (Gottlieb, Shu 1998), see LowStorageStage
+	enum class TimeIntegrator {
+		Euler,  //Forward Euler, one stage
+		SSPRK2, //Heun, two stages, second order
+		SSPRK3, //Williamson low storage, three stages, third order
+	};
+
+	inline const char* time_integrator_name( TimeIntegrator integrator ){
+		switch( integrator ){
+			case TimeIntegrator::Euler: return "euler";
+			case TimeIntegrator::SSPRK2: return "ssprk2";
+			case TimeIntegrator::SSPRK3: return "ssprk3";
+		}
+		return "unknown";
+	}
+
+	// Stage s of SSPRK3 as u_s = a * u_s-2 + b * ( u_s-1 + dt_scale * dt * L( u_s-1 )), without u_s-2 for s = 0.
+	// The 2N form du_s = A_s * du_s-1 + dt * L( u_s-1 ), u_s = u_s-1 + B_s * du_s keeps du_s-1 as
+	// ( u_s-1 - u_s-2 ) / B_s-1, so each stage reads the two before it and writes over u_s-2, which is
+	// the base of the stage: no field beyond the two of a forward Euler step
+	struct LowStorageStage {
+		double a, b, dt_scale;
+	};
+
+	constexpr LowStorageStage ssprk3_stage( size_t s ){
+		constexpr double A[] = { 0.0, -5.0 / 9.0, -153.0 / 128.0 };
+		constexpr double B[] = { 1.0 / 3.0, 15.0 / 16.0, 8.0 / 15.0 };
+
+		if( s == 0 )
+			return { 0.0, 1.0, B[0] };
+
+		const double a = -B[s] * A[s] / B[s - 1];
+		return { a, 1.0 - a, B[s] / ( 1.0 - a ) };
+	}
+}